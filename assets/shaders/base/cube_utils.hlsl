@@ -0,0 +1,44 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// direction through the center of a texel of a cube map face, where id.z is the face index.
+// faces follow the vulkan layout (+x, -x, +y, -y, +z, -z), so that sampling the result in a
+// direction returns the texel that was written for it
+float3 cube_direction(uint3 id, uint face_size) {
+    float2 st = ((float2(id.xy) + 0.5f) / float(face_size)) * 2.f - 1.f;
+    float3 direction;
+    switch (id.z) {
+    case 0:
+        direction = float3(1.f, -st.y, -st.x);
+        break;
+    case 1:
+        direction = float3(-1.f, -st.y, st.x);
+        break;
+    case 2:
+        direction = float3(st.x, 1.f, st.y);
+        break;
+    case 3:
+        direction = float3(st.x, -1.f, -st.y);
+        break;
+    case 4:
+        direction = float3(st.x, -st.y, 1.f);
+        break;
+    default:
+        direction = float3(-st.x, -st.y, -1.f);
+        break;
+    }
+    return normalize(direction);
+}
\ No newline at end of file
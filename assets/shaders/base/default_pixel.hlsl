@@ -56,7 +56,7 @@ struct light_data_t {
 // material data
 struct material_data_t {
     bool use_normal_map;
-    float shininess, opacity;
+    float shininess, opacity, roughness;
     float3 albedo_color, specular_color;
 };
 [[vk::binding(1, 1)]] ConstantBuffer<material_data_t> material_data;
@@ -73,6 +73,10 @@ struct material_data_t {
 [[vk::binding(4, 1)]] Texture2D normal_map;
 [[vk::binding(4, 1)]] SamplerState normal_sampler;
 
+// environment, prefiltered with increasing roughness down its mip chain
+[[vk::binding(5, 1)]] TextureCube prefiltered_cube;
+[[vk::binding(5, 1)]] SamplerState prefiltered_sampler;
+
 struct color_data_t {
     float3 albedo, specular;
 };
@@ -137,6 +141,25 @@ float3 calculate_directional_light(int index, color_data_t color_data, ps_input
     return float3(0.f);
 }
 
+float3 calculate_environment_specular(color_data_t color_data, ps_input stage_input, float3 normal) {
+    float3 view_direction = normalize(stage_input.camera_position - stage_input.fragment_position);
+    // cube maps are sampled upside down, the same way assets/shaders/skybox.hlsl does
+    float3 reflect_direction = reflect(-view_direction, normal) * float3(1.f, -1.f, 1.f);
+
+    // the last level was filtered for a roughness of 1
+    uint width, height, level_count;
+    prefiltered_cube.GetDimensions(0, width, height, level_count);
+    float level = material_data.roughness * float(level_count - 1);
+    float3 environment = prefiltered_cube.SampleLevel(prefiltered_sampler, reflect_direction, level).rgb;
+
+    // schlick's approximation, with the reflectance of a dielectric at normal incidence
+    float dot_nv = max(dot(normal, view_direction), 0.f);
+    float3 f0 = 0.04f * color_data.specular;
+    float3 fresnel = f0 + (max(float3(1.f - material_data.roughness), f0) - f0) * pow(1.f - dot_nv, 5.f);
+
+    return environment * fresnel;
+}
+
 float3 calculate_normal(ps_input input) {
     if (!material_data.use_normal_map) {
         return input.normal;
@@ -155,7 +178,7 @@ float3 calculate_normal(ps_input input) {
 float4 main(ps_input input) : SV_TARGET {
     color_data_t color_data = get_color_data(input.uv);
     float3 normal = calculate_normal(input);
-    float3 fragment_color = float3(0.f);
+    float3 fragment_color = calculate_environment_specular(color_data, input, normal);
     for (int i = 0; i < light_data.spotlight_count; i++) {
         fragment_color += calculate_spotlight(i, color_data, input, normal);
     }
@@ -20,6 +20,16 @@ struct vs_input {
     [[vk::location(1)]] float3 normal : NORMAL0;
     [[vk::location(2)]] float3 uv : TEXCOORD0;
     [[vk::location(3)]] float3 tangent : TANGENT0;
+
+    // per-instance transforms, passed as matrix columns
+    [[vk::location(4)]] float4 model_0 : MODEL0;
+    [[vk::location(5)]] float4 model_1 : MODEL1;
+    [[vk::location(6)]] float4 model_2 : MODEL2;
+    [[vk::location(7)]] float4 model_3 : MODEL3;
+    [[vk::location(8)]] float4 normal_0 : NORMALMATRIX0;
+    [[vk::location(9)]] float4 normal_1 : NORMALMATRIX1;
+    [[vk::location(10)]] float4 normal_2 : NORMALMATRIX2;
+    [[vk::location(11)]] float4 normal_3 : NORMALMATRIX3;
 };
 
 struct vs_output {
@@ -39,22 +49,23 @@ struct camera_data_t {
 };
 [[vk::binding(0, 0)]] ConstantBuffer<camera_data_t> camera_data;
 
-struct push_constants {
-    float4x4 model, normal;
-};
-[[vk::push_constant]] ConstantBuffer<push_constants> object_data;
-
 vs_output main(vs_input input) {
     vs_output output;
 
+    // float4x4 takes rows, so the columns need to be transposed back
+    float4x4 model =
+        transpose(float4x4(input.model_0, input.model_1, input.model_2, input.model_3));
+    float4x4 normal_matrix =
+        transpose(float4x4(input.normal_0, input.normal_1, input.normal_2, input.normal_3));
+
     // vertex world-space position
-    float4 world_position = mul(object_data.model, float4(input.position, 1.f));
+    float4 world_position = mul(model, float4(input.position, 1.f));
 
     // vertex screen-space position
     output.position = mul(camera_data.projection, mul(camera_data.view, world_position));
 
     // vertex normal and tangent
-    float3x3 normal = float3x3(object_data.normal);
+    float3x3 normal = float3x3(normal_matrix);
     output.normal = normalize(mul(normal, input.normal));
     output.tangent = normalize(mul(normal, input.tangent));
 
@@ -0,0 +1,92 @@
+#stage vertex
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// default_static, reading packed_vertex. positions are normalized within the model's bounds,
+// which the model matrix maps back into model space
+struct vs_input {
+    [[vk::location(0)]] float4 position : POSITION0;
+    [[vk::location(1)]] float2 normal : NORMAL0;
+    [[vk::location(2)]] float2 uv : TEXCOORD0;
+    [[vk::location(3)]] float2 tangent : TANGENT0;
+
+    // per-instance transforms, passed as matrix columns
+    [[vk::location(4)]] float4 model_0 : MODEL0;
+    [[vk::location(5)]] float4 model_1 : MODEL1;
+    [[vk::location(6)]] float4 model_2 : MODEL2;
+    [[vk::location(7)]] float4 model_3 : MODEL3;
+    [[vk::location(8)]] float4 normal_0 : NORMALMATRIX0;
+    [[vk::location(9)]] float4 normal_1 : NORMALMATRIX1;
+    [[vk::location(10)]] float4 normal_2 : NORMALMATRIX2;
+    [[vk::location(11)]] float4 normal_3 : NORMALMATRIX3;
+};
+
+struct vs_output {
+    float4 position : SV_POSITION;
+
+    [[vk::location(0)]] float3 normal : NORMAL0;
+    [[vk::location(1)]] float2 uv : TEXCOORD0;
+    [[vk::location(2)]] float3 tangent : TANGENT0;
+
+    [[vk::location(3)]] float3 fragment_position : NORMAL1;
+    [[vk::location(4)]] float3 camera_position : NORMAL2;
+};
+
+struct camera_data_t {
+    float4x4 projection, view;
+    float3 position;
+};
+[[vk::binding(0, 0)]] ConstantBuffer<camera_data_t> camera_data;
+
+// inverse of octahedral_encode in model.cpp
+float3 octahedral_decode(float2 encoded) {
+    float3 direction = float3(encoded, 1.f - abs(encoded.x) - abs(encoded.y));
+    float fold = saturate(-direction.z);
+    direction.x += direction.x >= 0.f ? -fold : fold;
+    direction.y += direction.y >= 0.f ? -fold : fold;
+    return normalize(direction);
+}
+
+vs_output main(vs_input input) {
+    vs_output output;
+
+    // float4x4 takes rows, so the columns need to be transposed back
+    float4x4 model =
+        transpose(float4x4(input.model_0, input.model_1, input.model_2, input.model_3));
+    float4x4 normal_matrix =
+        transpose(float4x4(input.normal_0, input.normal_1, input.normal_2, input.normal_3));
+
+    // vertex world-space position
+    float4 world_position = mul(model, float4(input.position.xyz, 1.f));
+
+    // vertex screen-space position
+    output.position = mul(camera_data.projection, mul(camera_data.view, world_position));
+
+    // vertex normal and tangent
+    float3x3 normal = float3x3(normal_matrix);
+    output.normal = normalize(mul(normal, octahedral_decode(input.normal)));
+    output.tangent = normalize(mul(normal, octahedral_decode(input.tangent)));
+
+    // copy other data
+    output.uv = input.uv;
+    output.fragment_position = world_position.xyz;
+    output.camera_position = camera_data.position;
+
+    return output;
+}
+
+#stage pixel
+#include "base/default_pixel.hlsl"
\ No newline at end of file
@@ -1,4 +1,4 @@
-#stage vertex
+#stage compute
 /*
    Copyright 2021 Nora Beda and contributors
 
@@ -15,22 +15,10 @@
    limitations under the License.
 */
 
-struct vs_output {
-    float4 position : SV_POSITION;
-    [[vk::location(0)]] float2 uv : TEXCOORD0;
-};
-
-vs_output main(uint vertex_index : SV_VERTEXID) {
-    vs_output output;
-
-    output.uv = float2((vertex_index << 2) & 2, vertex_index & 2);
-    output.position = float4(output.uv * 2.f - 1.f, 0.f, 1.f);
-
-    return output;
-}
-#stage pixel
 #define SAMPLE_COUNT 1024
 
+[[vk::binding(0, 0)]] [[vk::image_format("rg16f")]] RWTexture2D<float2> lookup_table;
+
 #include "base/shader_utils.hlsl"
 
 float geometric_shadow(float dotNL, float dotNV, float roughness) {
@@ -68,6 +56,13 @@ float2 BRDF(float NoV, float roughness) {
     return LUT / float(SAMPLE_COUNT);
 }
 
-float4 main([[vk::location(0)]] float2 uv : TEXCOORD0) : SV_TARGET {
-    return float4(BRDF(uv.x, 1.f - uv.y), 0.f, 1.f);
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DISPATCHTHREADID) {
+    uint2 size;
+    lookup_table.GetDimensions(size.x, size.y);
+    if (id.x >= size.x || id.y >= size.y) {
+        return;
+    }
+    float2 uv = (float2(id.xy) + 0.5f) / float2(size);
+    lookup_table[id.xy] = BRDF(uv.x, 1.f - uv.y);
 }
\ No newline at end of file
@@ -1,4 +1,4 @@
-#stage vertex
+#stage compute
 /*
    Copyright 2021 Nora Beda and contributors
 
@@ -15,22 +15,29 @@
    limitations under the License.
 */
 
-#include "base/filter_cube.hlsl"
-#stage pixel
 [[vk::binding(0, 0)]] TextureCube environment_texture;
 [[vk::binding(0, 0)]] SamplerState environment_sampler;
+[[vk::binding(1, 0)]] [[vk::image_format("rgba16f")]] RWTexture2DArray<float4> irradiance_map;
 
 struct sampling_deltas_t {
     float delta_phi, delta_theta;
 };
-[[vk::binding(1, 0)]] ConstantBuffer<sampling_deltas_t> sampling_deltas;
+[[vk::push_constant]] ConstantBuffer<sampling_deltas_t> sampling_deltas;
+
+#include "base/shader_utils.hlsl"
+#include "base/cube_utils.hlsl"
 
-#define PI 3.1415926535897932384626433832795
 #define TWO_PI PI * 2.f
 #define HALF_PI PI / 2.f
 
-float4 main([[vk::location(0)]] float3 uvw : TEXCOORD0) : SV_TARGET {
-    float3 normal = normalize(uvw);
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DISPATCHTHREADID) {
+    uint face_size, height, face_count;
+    irradiance_map.GetDimensions(face_size, height, face_count);
+    if (id.x >= face_size || id.y >= face_size) {
+        return;
+    }
+    float3 normal = cube_direction(id, face_size);
 
     float3 up = float3(0.f, 1.f, 0.f);
     float3 right = normalize(cross(up, normal));
@@ -44,11 +51,11 @@ float4 main([[vk::location(0)]] float3 uvw : TEXCOORD0) : SV_TARGET {
             float3 sample_vector = cos(theta) * normal + sin(theta) * temp_vector;
 
             color +=
-                environment_texture.Sample(environment_sampler, sample_vector).rgb *
+                environment_texture.SampleLevel(environment_sampler, sample_vector, 0.f).rgb *
                 cos(theta) * sin(theta);
             sample_count++;
         }
     }
 
-    return float4(PI * color / float(sample_count), 1.f);
+    irradiance_map[id] = float4(PI * color / float(sample_count), 1.f);
 }
\ No newline at end of file
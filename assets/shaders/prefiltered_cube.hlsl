@@ -1,4 +1,4 @@
-#stage vertex
+#stage compute
 /*
    Copyright 2021 Nora Beda and contributors
 
@@ -15,18 +15,18 @@
    limitations under the License.
 */
 
-#include "base/filter_cube.hlsl"
-#stage pixel
 [[vk::binding(0, 0)]] TextureCube environment_texture;
 [[vk::binding(0, 0)]] SamplerState environment_sampler;
+[[vk::binding(1, 0)]] [[vk::image_format("rgba16f")]] RWTexture2DArray<float4> prefiltered_cube;
 
 struct cube_settings_t {
     float roughness;
     uint sample_count;
 };
-[[vk::binding(1, 0)]] ConstantBuffer<cube_settings_t> cube_settings;
+[[vk::push_constant]] ConstantBuffer<cube_settings_t> cube_settings;
 
 #include "base/shader_utils.hlsl"
+#include "base/cube_utils.hlsl"
 
 float normal_distribution(float dot_nh) {
     float roughness_4 = pow(cube_settings.roughness, 4);
@@ -68,7 +68,13 @@ float3 prefilter_env_map(float3 normal) {
     return color / total_weight;
 }
 
-float4 main([[vk::location(0)]] float3 uvw : TEXCOORD0) : SV_TARGET {
-    float3 normal = normalize(uvw);
-    return float4(prefilter_env_map(normal), 1.f);
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DISPATCHTHREADID) {
+    uint face_size, height, face_count;
+    prefiltered_cube.GetDimensions(face_size, height, face_count);
+    if (id.x >= face_size || id.y >= face_size) {
+        return;
+    }
+    float3 normal = cube_direction(id, face_size);
+    prefiltered_cube[id] = float4(prefilter_env_map(normal), 1.f);
 }
\ No newline at end of file
@@ -117,4 +117,8 @@ namespace vkrollercoaster {
     void allocator::unmap(VmaAllocation allocation) const {
         vmaUnmapMemory(allocator_data.allocator, allocation);
     }
+
+    void allocator::invalidate(VmaAllocation allocation) const {
+        vmaInvalidateAllocation(allocator_data.allocator, allocation, 0, VK_WHOLE_SIZE);
+    }
 } // namespace vkrollercoaster
\ No newline at end of file
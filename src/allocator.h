@@ -42,6 +42,9 @@ namespace vkrollercoaster {
         // mapping memory
         void* map(VmaAllocation allocation) const;
         void unmap(VmaAllocation allocation) const;
+        // makes gpu writes visible to mapped memory that may not be host coherent. the memory
+        // must be mapped
+        void invalidate(VmaAllocation allocation) const;
 
     private:
         std::string m_source;
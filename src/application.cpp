@@ -24,6 +24,8 @@
 #include "light.h"
 #include "menus/menus.h"
 #include "input_manager.h"
+#include "worker_pool.h"
+#include "asset_manager.h"
 namespace vkrollercoaster {
     struct app_data_t {
         ref<window> app_window;
@@ -107,6 +109,8 @@ namespace vkrollercoaster {
     static void new_frame() {
         window::poll();
         renderer::new_frame();
+        shader_library::update();
+        asset_manager::update();
         light::reset_buffers();
         imgui_controller::new_frame();
     }
@@ -120,14 +124,19 @@ namespace vkrollercoaster {
     static void draw(ref<command_buffer> cmdbuffer) {
         cmdbuffer->begin();
 
-        // render to the viewport's framebuffer
+        // render to the viewport's framebuffer. the scene is recorded into secondary command
+        // buffers, so that batched draws can be recorded on every worker thread
         ref<framebuffer> render_framebuffer = viewport::get_instance()->get_framebuffer();
-        cmdbuffer->begin_render_pass(render_framebuffer, glm::vec4(glm::vec3(0.1f), 1.f));
+        cmdbuffer->begin_render_pass(render_framebuffer, glm::vec4(glm::vec3(0.1f), 1.f), true);
 
-        ref<skybox> _skybox = renderer::get_skybox();
-        _skybox->render(cmdbuffer);
+        {
+            auto skybox_cmdbuffer = renderer::create_secondary_command_buffer();
+            skybox_cmdbuffer->begin(render_framebuffer);
+            renderer::get_skybox()->render(skybox_cmdbuffer);
+            skybox_cmdbuffer->end();
+            cmdbuffer->execute({ skybox_cmdbuffer });
+        }
 
-        // probably should optimize and batch render
         for (entity ent : app_data->global_scene->view<transform_component, model_component>()) {
             renderer::render_entity(cmdbuffer, ent);
         }
@@ -139,6 +148,9 @@ namespace vkrollercoaster {
             }
         }
 
+        // entities sharing a model are drawn with one instanced draw per material
+        renderer::draw_batches(cmdbuffer);
+
         cmdbuffer->end_render_pass();
         cmdbuffer->begin_render_pass(app_data->swap_chain, glm::vec4(glm::vec3(0.f), 1.f));
 
@@ -149,23 +161,33 @@ namespace vkrollercoaster {
     }
 
     static void load_shaders() {
-        // standard rendering shaders
-        shader_library::add("default_static");
-
-        // skybox shaders
-        shader_library::add("skybox");
-        shader_library::add("irradiance_map");
-        shader_library::add("prefiltered_cube");
-        shader_library::add("gen_brdflut");
+        std::vector<std::string> names = {
+            // standard rendering shaders
+            "default_static",
+            "default_static_packed",
+
+            // skybox shaders
+            "skybox",
+            "irradiance_map",
+            "prefiltered_cube",
+            "gen_brdflut",
+        };
+
+        // compile every shader at once on the worker pool
+        shader_library::add(names);
     }
 
     void application::init() {
+        auto start_time = std::chrono::high_resolution_clock::now();
         app_data = std::make_unique<app_data_t>();
 
         // create window
         window::init();
         app_data->app_window = ref<window>::create(1600, 900, "vkrollercoaster");
 
+        // start worker threads
+        worker_pool::init();
+
         // set up vulkan
         renderer::init();
         app_data->swap_chain = ref<swapchain>::create(app_data->app_window);
@@ -190,16 +212,28 @@ namespace vkrollercoaster {
             auto& scripts = player.add_component<script_component>();
             scripts.bind<player_behavior>();
         }
+
+        // compare cold (no pipeline cache) and warm launches
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto startup_time =
+            std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        spdlog::info("startup took {0} ms ({1} launch)", startup_time.count(),
+                     renderer::is_pipeline_cache_loaded() ? "warm" : "cold");
     }
 
     void application::shutdown() {
+        // make sure the gpu is done with every frame in flight
+        vkDeviceWaitIdle(renderer::get_device());
+
         // shut down subsystems
+        asset_manager::shutdown();
         skybox::shutdown();
         light::shutdown();
         imgui_controller::shutdown();
         shader_library::clear();
         renderer::shutdown();
         window::shutdown();
+        worker_pool::shutdown();
 
         // delete app data
         app_data.reset();
@@ -230,9 +264,9 @@ namespace vkrollercoaster {
                 // add draw commands
                 draw(cmdbuffer);
 
-                // add commands onto the queue and wait
+                // add commands onto the queue - the renderer keeps the command buffer alive
+                // until the gpu is done with it
                 cmdbuffer->submit();
-                cmdbuffer->wait();
             }
 
             // present
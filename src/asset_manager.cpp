@@ -0,0 +1,197 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "pch.h"
+#include "asset_manager.h"
+namespace vkrollercoaster {
+    struct pending_model_load {
+        std::string key;
+        ref<model_source> source;
+        std::future<model_source::loaded_data> result;
+    };
+
+    static struct {
+        std::unordered_map<std::string, model_source*> model_sources;
+        std::unordered_map<std::string, std::string> errors;
+        std::vector<pending_model_load> pending_model_loads;
+    } asset_manager_data;
+
+    static fs::path get_canonical_path(const fs::path& path) {
+        std::error_code error;
+        fs::path canonical_path = fs::weakly_canonical(fs::absolute(path), error);
+        return error ? path : canonical_path;
+    }
+
+    // the same file imported with different options is a different asset
+    static std::string get_asset_key(const fs::path& path, const model_import_options& options) {
+        std::string key = get_canonical_path(path).string();
+        if (!options.generate_lods) {
+            key += " (no lods)";
+        }
+        return key;
+    }
+
+    static void record_error(const std::string& key, const std::string& error) {
+        spdlog::error("could not load model {0}: {1}", key, error);
+        asset_manager_data.errors[key] = error;
+    }
+
+    // blocks until the load has finished, and applies it. returns false if it failed
+    static bool finish_load(pending_model_load& load) {
+        try {
+            model_source::loaded_data data = load.result.get();
+            load.source->apply(data);
+            return true;
+        } catch (const std::exception& exc) {
+            record_error(load.key, exc.what());
+            return false;
+        }
+    }
+
+    static std::vector<pending_model_load>::iterator find_pending_load(const std::string& key) {
+        auto& loads = asset_manager_data.pending_model_loads;
+        return std::find_if(loads.begin(), loads.end(),
+                            [&](const pending_model_load& load) { return load.key == key; });
+    }
+
+    ref<model_source> asset_manager::load_model_source(const fs::path& path,
+                                                       const model_import_options& options) {
+        std::string key = get_asset_key(path, options);
+        auto it = asset_manager_data.model_sources.find(key);
+        if (it != asset_manager_data.model_sources.end()) {
+            ref<model_source> source = it->second;
+
+            // if it's still loading in the background, wait for it
+            auto pending = find_pending_load(key);
+            if (pending != asset_manager_data.pending_model_loads.end()) {
+                bool loaded = finish_load(*pending);
+                asset_manager_data.pending_model_loads.erase(pending);
+                if (!loaded) {
+                    unregister_model_source(source);
+                    return nullptr;
+                }
+            }
+            return source;
+        }
+        ref<model_source> source;
+        try {
+            source = ref<model_source>::create(get_canonical_path(path), true, options);
+        } catch (const std::exception& exc) {
+            record_error(key, exc.what());
+            return nullptr;
+        }
+        register_model_source(key, source);
+        return source;
+    }
+
+    ref<model_source> asset_manager::load_model_source_async(const fs::path& path,
+                                                             const model_import_options& options) {
+        std::string key = get_asset_key(path, options);
+        auto it = asset_manager_data.model_sources.find(key);
+        if (it != asset_manager_data.model_sources.end()) {
+            return it->second;
+        }
+        auto source = ref<model_source>::create(get_canonical_path(path), false, options);
+        register_model_source(key, source);
+
+        // the source is kept alive by the pending load, and loading only reads its path
+        const model_source* raw_source = source.raw();
+        pending_model_load load;
+        load.key = key;
+        load.source = source;
+        load.result = std::async(std::launch::async, [raw_source]() {
+            model_source::loaded_data data;
+            raw_source->load(data);
+            return data;
+        });
+        asset_manager_data.pending_model_loads.push_back(std::move(load));
+        return source;
+    }
+
+    void asset_manager::update() {
+        auto& loads = asset_manager_data.pending_model_loads;
+        for (size_t i = 0; i < loads.size();) {
+            auto& load = loads[i];
+            if (load.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                i++;
+                continue;
+            }
+            if (finish_load(load)) {
+                spdlog::info("loaded model {0}", load.key);
+            } else {
+                unregister_model_source(load.source);
+            }
+            loads.erase(loads.begin() + i);
+        }
+    }
+
+    void asset_manager::shutdown() {
+        // there's no point in uploading anything now, but the loads still have to finish before
+        // their model sources can be freed
+        for (auto& load : asset_manager_data.pending_model_loads) {
+            load.result.wait();
+        }
+        asset_manager_data.pending_model_loads.clear();
+    }
+
+    asset_state asset_manager::get_model_source_state(const fs::path& path,
+                                                      const model_import_options& options) {
+        std::string key = get_asset_key(path, options);
+        if (find_pending_load(key) != asset_manager_data.pending_model_loads.end()) {
+            return asset_state::loading;
+        }
+        if (asset_manager_data.model_sources.find(key) !=
+            asset_manager_data.model_sources.end()) {
+            return asset_state::loaded;
+        }
+        if (asset_manager_data.errors.find(key) != asset_manager_data.errors.end()) {
+            return asset_state::failed;
+        }
+        return asset_state::unloaded;
+    }
+
+    std::string asset_manager::get_error(const fs::path& path,
+                                         const model_import_options& options) {
+        auto it = asset_manager_data.errors.find(get_asset_key(path, options));
+        if (it == asset_manager_data.errors.end()) {
+            return std::string();
+        }
+        return it->second;
+    }
+
+    void asset_manager::get_model_sources(std::vector<ref<model_source>>& sources) {
+        for (const auto& [key, source] : asset_manager_data.model_sources) {
+            sources.push_back(source);
+        }
+    }
+
+    void asset_manager::register_model_source(const std::string& key,
+                                              ref<model_source> source) {
+        asset_manager_data.errors.erase(key);
+        source->m_asset_key = key;
+        asset_manager_data.model_sources[key] = source.raw();
+    }
+
+    void asset_manager::unregister_model_source(ref<model_source> source) {
+        // models created from it stay empty, and the next load of the file starts over
+        asset_manager_data.model_sources.erase(source->m_asset_key);
+        source->m_asset_key.clear();
+    }
+
+    void asset_manager::remove_model_source(const std::string& key) {
+        asset_manager_data.model_sources.erase(key);
+    }
+} // namespace vkrollercoaster
\ No newline at end of file
@@ -0,0 +1,54 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#pragma once
+#include "model.h"
+namespace vkrollercoaster {
+    enum class asset_state { unloaded, loading, loaded, failed };
+    // deduplicates assets loaded from disk by canonical path and import options. assets are only
+    // held weakly, so they are freed once nothing else references them
+    class asset_manager {
+    public:
+        asset_manager() = delete;
+
+        // returns the model source already loaded from the given file, or imports it. returns
+        // nullptr if the import fails, in which case the error can be retrieved with get_error
+        static ref<model_source> load_model_source(
+            const fs::path& path, const model_import_options& options = model_import_options());
+        // returns immediately with a model source that is loaded in the background. it has no
+        // meshes or materials until update applies the load, so models created from it are not
+        // drawn until then. if the load fails, it stays empty
+        static ref<model_source> load_model_source_async(
+            const fs::path& path, const model_import_options& options = model_import_options());
+        // applies finished background loads, creating their gpu resources. must be called at a
+        // frame boundary
+        static void update();
+        // waits for background loads, and discards them
+        static void shutdown();
+
+        static asset_state get_model_source_state(
+            const fs::path& path, const model_import_options& options = model_import_options());
+        static std::string get_error(const fs::path& path,
+                                     const model_import_options& options = model_import_options());
+        static void get_model_sources(std::vector<ref<model_source>>& sources);
+
+    private:
+        static void register_model_source(const std::string& key, ref<model_source> source);
+        static void unregister_model_source(ref<model_source> source);
+        static void remove_model_source(const std::string& key);
+        friend class model_source;
+    };
+} // namespace vkrollercoaster
\ No newline at end of file
@@ -17,8 +17,10 @@
 #include "pch.h"
 #define EXPOSE_BUFFER_UTILS
 #include "buffers.h"
+#define EXPOSE_RENDERER_INTERNALS
 #include "renderer.h"
 #include "util.h"
+#include "upload_queue.h"
 namespace vkrollercoaster {
     void create_buffer(const allocator& _allocator, size_t size, VkBufferUsageFlags usage,
                        VmaMemoryUsage memory_usage, VkBuffer& buffer, VmaAllocation& allocation) {
@@ -27,7 +29,17 @@ namespace vkrollercoaster {
         create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         create_info.size = size;
         create_info.usage = usage;
-        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        // buffers may be written on the transfer queue and read on the graphics queue
+        auto indices = renderer::find_queue_families(renderer::get_physical_device()).create_set();
+        std::vector<uint32_t> unique_indices(indices.begin(), indices.end());
+        if (unique_indices.size() > 1) {
+            create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            create_info.pQueueFamilyIndices = unique_indices.data();
+            create_info.queueFamilyIndexCount = unique_indices.size();
+        } else {
+            create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        }
         _allocator.alloc(create_info, memory_usage, buffer, allocation);
     }
 
@@ -47,22 +59,10 @@ namespace vkrollercoaster {
 
     vertex_buffer::vertex_buffer(const void* data, size_t size) {
         this->m_allocator.set_source("vertex buffer");
-
-        VkBuffer staging_buffer;
-        VmaAllocation staging_allocation;
-        create_buffer(this->m_allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU, staging_buffer, staging_allocation);
-
-        void* gpu_data = this->m_allocator.map(staging_allocation);
-        memcpy(gpu_data, data, size);
-        this->m_allocator.unmap(staging_allocation);
-
         create_buffer(this->m_allocator, size,
                       VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                       VMA_MEMORY_USAGE_GPU_ONLY, this->m_buffer, this->m_allocation);
-        copy_buffer(staging_buffer, this->m_buffer, size);
-
-        this->m_allocator.free(staging_buffer, staging_allocation);
+        upload_queue::upload_buffer(this->m_buffer, data, size);
     }
 
     vertex_buffer::~vertex_buffer() { this->m_allocator.free(this->m_buffer, this->m_allocation); }
@@ -74,18 +74,10 @@ namespace vkrollercoaster {
     index_buffer::index_buffer(const uint32_t* data, size_t index_count) {
         this->m_index_count = index_count;
         size_t size = index_count * sizeof(uint32_t);
-        VkBuffer staging_buffer;
-        VmaAllocation staging_allocation;
-        create_buffer(this->m_allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU, staging_buffer, staging_allocation);
-        void* gpu_data = this->m_allocator.map(staging_allocation);
-        memcpy(gpu_data, data, size);
-        this->m_allocator.unmap(staging_allocation);
         create_buffer(this->m_allocator, size,
                       VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                       VMA_MEMORY_USAGE_GPU_ONLY, this->m_buffer, this->m_allocation);
-        copy_buffer(staging_buffer, this->m_buffer, size);
-        this->m_allocator.free(staging_buffer, staging_allocation);
+        upload_queue::upload_buffer(this->m_buffer, data, size);
     }
 
     index_buffer::~index_buffer() { this->m_allocator.free(this->m_buffer, this->m_allocation); }
@@ -116,8 +108,23 @@ namespace vkrollercoaster {
         this->m_set = set;
         this->m_binding = binding;
         this->m_size = size;
-        create_buffer(this->m_allocator, size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+
+        // every frame in flight reads its own copy of the data, so that writing data for the
+        // current frame never races the gpu reading a previous one
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(renderer::get_physical_device(), &properties);
+        size_t alignment = properties.limits.minUniformBufferOffsetAlignment;
+        this->m_aligned_size = ((size + alignment - 1) / alignment) * alignment;
+        this->m_copy_frames.resize(renderer::max_frame_count, renderer::get_frame_number());
+        this->m_latest_copy = renderer::get_current_frame();
+
+        size_t buffer_size = this->m_aligned_size * renderer::max_frame_count;
+        create_buffer(this->m_allocator, buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                       VMA_MEMORY_USAGE_CPU_ONLY, this->m_buffer, this->m_allocation);
+
+        // the buffer stays mapped for its whole lifetime, so reads and writes are plain memcpys
+        this->m_mapped = (uint8_t*)this->m_allocator.map(this->m_allocation);
+        memset(this->m_mapped, 0, buffer_size);
     }
 
     uniform_buffer::~uniform_buffer() {
@@ -130,6 +137,7 @@ namespace vkrollercoaster {
                 set_data.erase(this->m_binding);
             }
         }
+        this->m_allocator.unmap(this->m_allocation);
         this->m_allocator.free(this->m_buffer, this->m_allocation);
     }
 
@@ -152,10 +160,11 @@ namespace vkrollercoaster {
             descriptor_write.dstBinding = this->m_binding;
             descriptor_write.dstArrayElement = 0;
             descriptor_write.pBufferInfo = &buffer_info;
-            descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             descriptor_write.descriptorCount = 1;
             descriptor_writes.push_back(descriptor_write);
         }
+        _pipeline->wait_for_descriptor_sets();
         VkDevice device = renderer::get_device();
         vkUpdateDescriptorSets(device, descriptor_writes.size(), descriptor_writes.data(), 0,
                                nullptr);
@@ -174,25 +183,41 @@ namespace vkrollercoaster {
         if (offset + size > this->m_size) {
             throw std::runtime_error("attempted to map memory outside the buffer's limits!");
         }
-        void* gpu_data = this->m_allocator.map(this->m_allocation);
-        void* dst = (void*)((size_t)gpu_data + offset);
-        memcpy(dst, data, size);
-        this->m_allocator.unmap(this->m_allocation);
+        size_t copy_offset = this->acquire_current_copy(true);
+        memcpy(this->m_mapped + copy_offset + offset, data, size);
     }
 
     void uniform_buffer::get_data(void* data, size_t size, size_t offset) {
         if (offset + size > this->m_size) {
             throw std::runtime_error("attempted to map memory outside the buffer's limits!");
         }
-        void* gpu_data = this->m_allocator.map(this->m_allocation);
-        void* src = (void*)((size_t)gpu_data + offset);
-        memcpy(data, src, size);
-        this->m_allocator.unmap(this->m_allocation);
+        size_t copy_offset = this->m_latest_copy * this->m_aligned_size;
+        memcpy(data, this->m_mapped + copy_offset + offset, size);
     }
 
     void uniform_buffer::zero() {
-        void* gpu_data = this->m_allocator.map(this->m_allocation);
-        memset(gpu_data, 0, this->m_size);
-        this->m_allocator.unmap(this->m_allocation);
+        size_t copy_offset = this->acquire_current_copy(false);
+        memset(this->m_mapped + copy_offset, 0, this->m_size);
+    }
+
+    size_t uniform_buffer::acquire_current_copy(bool preserve_contents) {
+        // the current frame's copy is only written to after its fence has been waited on (see
+        // renderer::new_frame), so it is safe to bring it up to date with the latest data here
+        size_t current_frame = renderer::get_current_frame();
+        uint64_t frame_number = renderer::get_frame_number();
+        if (this->m_copy_frames[current_frame] != frame_number) {
+            if (preserve_contents && this->m_latest_copy != current_frame) {
+                uint8_t* dst = this->m_mapped + current_frame * this->m_aligned_size;
+                uint8_t* src = this->m_mapped + this->m_latest_copy * this->m_aligned_size;
+                memcpy(dst, src, this->m_size);
+            }
+            this->m_copy_frames[current_frame] = frame_number;
+            this->m_latest_copy = current_frame;
+        }
+        return current_frame * this->m_aligned_size;
+    }
+
+    uint32_t uniform_buffer::get_dynamic_offset() {
+        return (uint32_t)this->acquire_current_copy(true);
     }
 } // namespace vkrollercoaster
\ No newline at end of file
@@ -90,10 +90,16 @@ namespace vkrollercoaster {
         uint32_t get_binding() { return this->m_binding; }
 
     private:
+        size_t acquire_current_copy(bool preserve_contents);
+        uint32_t get_dynamic_offset();
+
         VkBuffer m_buffer;
         VmaAllocation m_allocation;
+        uint8_t* m_mapped;
         uint32_t m_set, m_binding;
-        size_t m_size;
+        size_t m_size, m_aligned_size;
+        std::vector<uint64_t> m_copy_frames;
+        size_t m_latest_copy;
         std::set<pipeline*> m_bound_pipelines;
         allocator m_allocator;
         friend class pipeline;
@@ -20,6 +20,7 @@
 #include "renderer.h"
 #include "util.h"
 #include "pipeline.h"
+#include "upload_queue.h"
 namespace vkrollercoaster {
     command_buffer::~command_buffer() {
         this->wait();
@@ -32,6 +33,30 @@ namespace vkrollercoaster {
     }
 
     void command_buffer::begin() {
+        if (this->m_secondary) {
+            throw std::runtime_error("secondary command buffers must inherit a render target!");
+        }
+        this->begin_recording(nullptr);
+    }
+
+    void command_buffer::begin(ref<render_target> inherited_target) {
+        if (!this->m_secondary) {
+            throw std::runtime_error("only secondary command buffers can inherit a render target!");
+        }
+
+        VkCommandBufferInheritanceInfo inheritance_info;
+        util::zero(inheritance_info);
+        inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance_info.renderPass = inherited_target->get_render_pass();
+        inheritance_info.subpass = 0;
+        inheritance_info.framebuffer = inherited_target->get_framebuffer();
+        this->begin_recording(&inheritance_info);
+
+        // draw calls check for a render target, so treat the inherited pass as our own
+        this->m_current_render_target = inherited_target;
+    }
+
+    void command_buffer::begin_recording(const VkCommandBufferInheritanceInfo* inheritance_info) {
         if (this->m_recording) {
             throw std::runtime_error(
                 "cannot begin recording a command buffer that is already recording!");
@@ -43,6 +68,10 @@ namespace vkrollercoaster {
         if (this->m_single_time) {
             begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
         }
+        if (inheritance_info) {
+            begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            begin_info.pInheritanceInfo = inheritance_info;
+        }
 
         if (vkBeginCommandBuffer(this->m_buffer, &begin_info) != VK_SUCCESS) {
             throw std::runtime_error("could not begin recording of command buffer!");
@@ -56,6 +85,10 @@ namespace vkrollercoaster {
                 "cannot end recording of a command buffer that is not recording!");
         }
 
+        if (this->m_secondary) {
+            this->m_current_render_target.reset();
+        }
+
         if (this->m_current_render_target) {
             throw std::runtime_error(
                 "cannot end recording of a command buffer during a render pass!");
@@ -78,6 +111,14 @@ namespace vkrollercoaster {
             throw std::runtime_error("cannot submit a command buffer that is currently recording!");
         }
 
+        if (this->m_secondary) {
+            throw std::runtime_error(
+                "secondary command buffers can only be executed from a primary command buffer!");
+        }
+
+        // anything this command buffer reads may have been queued for upload
+        upload_queue::flush();
+
         VkDevice device = renderer::get_device();
 
         VkSubmitInfo submit_info;
@@ -112,13 +153,32 @@ namespace vkrollercoaster {
 
         vkQueueSubmit(this->m_queue, 1, &submit_info, fence);
 
-        if (!this->m_render) {
+        if (this->m_render) {
+            this->m_fence = fence;
+        } else {
             vkWaitForFences(device, 1, &fence, true, std::numeric_limits<uint64_t>::max());
             vkDestroyFence(device, fence, nullptr);
         }
     }
 
-    void command_buffer::wait() { vkQueueWaitIdle(this->m_queue); }
+    void command_buffer::wait() {
+        if (this->m_secondary) {
+            // secondary command buffers are never submitted on their own
+            return;
+        }
+
+        if (this->m_render) {
+            // render command buffers only need to wait on the fence of their frame
+            if (this->m_fence) {
+                VkDevice device = renderer::get_device();
+                vkWaitForFences(device, 1, &this->m_fence, true,
+                                std::numeric_limits<uint64_t>::max());
+                this->m_fence = nullptr;
+            }
+        } else {
+            vkQueueWaitIdle(this->m_queue);
+        }
+    }
 
     void command_buffer::reset() {
         if (!this->m_recorded) {
@@ -130,14 +190,34 @@ namespace vkrollercoaster {
         vkResetCommandBuffer(this->m_buffer, 0);
         this->m_recorded = false;
         this->m_internal_data->submitted_calls.clear();
+        this->m_internal_data->batches.clear();
+        this->m_internal_data->batch_indices.clear();
+        this->m_internal_data->executed_buffers.clear();
     }
 
-    void command_buffer::begin_render_pass(ref<render_target> target,
-                                           const glm::vec4& clear_color) {
+    // called by the renderer after this command buffer's pool has been reset
+    void command_buffer::recycle() {
+        this->m_recorded = false;
+        this->m_recording = false;
+        this->m_fence = nullptr;
+        this->m_current_render_target.reset();
+        this->m_secondary_contents = false;
+        this->m_internal_data->submitted_calls.clear();
+        this->m_internal_data->batches.clear();
+        this->m_internal_data->batch_indices.clear();
+        this->m_internal_data->executed_buffers.clear();
+    }
+
+    void command_buffer::begin_render_pass(ref<render_target> target, const glm::vec4& clear_color,
+                                           bool secondary_contents) {
         if (!this->m_recording) {
             throw std::runtime_error("cannot begin a render pass while not recording!");
         }
 
+        if (this->m_secondary) {
+            throw std::runtime_error("secondary command buffers cannot begin render passes!");
+        }
+
         if (this->m_current_render_target) {
             throw std::runtime_error("a render pass is already being recorded!");
         }
@@ -171,8 +251,12 @@ namespace vkrollercoaster {
         begin_info.clearValueCount = clear_values.size();
         begin_info.pClearValues = clear_values.data();
 
-        vkCmdBeginRenderPass(this->m_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        VkSubpassContents contents = secondary_contents
+                                         ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                         : VK_SUBPASS_CONTENTS_INLINE;
+        vkCmdBeginRenderPass(this->m_buffer, &begin_info, contents);
         this->m_current_render_target = target;
+        this->m_secondary_contents = secondary_contents;
     }
 
     void command_buffer::end_render_pass() {
@@ -184,15 +268,46 @@ namespace vkrollercoaster {
             throw std::runtime_error("no render pass is being recorded!");
         }
 
+        if (!this->m_internal_data->batches.empty()) {
+            throw std::runtime_error(
+                "batched instances must be drawn before ending a render pass!");
+        }
+
         vkCmdEndRenderPass(this->m_buffer);
 
         this->m_current_render_target.reset();
+        this->m_secondary_contents = false;
+    }
+
+    void command_buffer::execute(const std::vector<ref<command_buffer>>& secondary_buffers) {
+        if (!this->m_current_render_target || !this->m_secondary_contents) {
+            throw std::runtime_error(
+                "secondary command buffers can only be executed in a render pass begun for them!");
+        }
+
+        std::vector<VkCommandBuffer> buffers;
+        for (auto secondary_buffer : secondary_buffers) {
+            if (!secondary_buffer->m_secondary || !secondary_buffer->m_recorded) {
+                throw std::runtime_error(
+                    "only recorded secondary command buffers can be executed!");
+            }
+            buffers.push_back(secondary_buffer->m_buffer);
+
+            // the secondary buffers' submitted calls need to live as long as this buffer's
+            this->m_internal_data->executed_buffers.push_back(secondary_buffer);
+        }
+        if (!buffers.empty()) {
+            vkCmdExecuteCommands(this->m_buffer, buffers.size(), buffers.data());
+        }
     }
 
     command_buffer::command_buffer(VkCommandPool command_pool, VkQueue queue, bool single_time,
-                                   bool render) {
+                                   bool render, bool secondary) {
         this->m_recorded = false;
         this->m_recording = false;
+        this->m_secondary = secondary;
+        this->m_secondary_contents = false;
+        this->m_fence = nullptr;
         this->m_internal_data = new internal_cmdbuffer_data;
         this->m_single_time = single_time;
         this->m_render = render;
@@ -206,7 +321,8 @@ namespace vkrollercoaster {
         alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         alloc_info.commandBufferCount = 1;
         alloc_info.commandPool = this->m_pool;
-        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.level =
+            secondary ? VK_COMMAND_BUFFER_LEVEL_SECONDARY : VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
         VkDevice device = renderer::get_device();
         if (vkAllocateCommandBuffers(device, &alloc_info, &this->m_buffer) != VK_SUCCESS) {
@@ -26,27 +26,40 @@ namespace vkrollercoaster {
         command_buffer(const command_buffer&) = delete;
         command_buffer& operator=(const command_buffer&) = delete;
         void begin();
+        // begins a secondary command buffer, continuing the render pass of the given target
+        void begin(ref<render_target> inherited_target);
         void end();
         void submit();
         void wait();
         void reset();
-        void begin_render_pass(ref<render_target> target, const glm::vec4& clear_color);
+        // if secondary_contents is set, the render pass can only be recorded into through
+        // secondary command buffers passed to execute
+        void begin_render_pass(ref<render_target> target, const glm::vec4& clear_color,
+                               bool secondary_contents = false);
         void end_render_pass();
+        void execute(const std::vector<ref<command_buffer>>& secondary_buffers);
         VkCommandBuffer get() { return this->m_buffer; }
         ref<render_target> get_current_render_target() { return this->m_current_render_target; }
         bool recording() { return this->m_recording; }
+        bool is_secondary() { return this->m_secondary; }
+        bool has_secondary_contents() { return this->m_secondary_contents; }
 
     private:
-        command_buffer(VkCommandPool command_pool, VkQueue queue, bool single_time, bool render);
-        
+        command_buffer(VkCommandPool command_pool, VkQueue queue, bool single_time, bool render,
+                       bool secondary = false);
+        void begin_recording(const VkCommandBufferInheritanceInfo* inheritance_info);
+        void recycle();
+
         ref<render_target> m_current_render_target;
         internal_cmdbuffer_data* m_internal_data;
 
         VkCommandPool m_pool;
         VkQueue m_queue;
         VkCommandBuffer m_buffer;
+        VkFence m_fence;
 
-        bool m_single_time, m_render, m_recorded, m_recording;
+        bool m_single_time, m_render, m_secondary, m_recorded, m_recording;
+        bool m_secondary_contents;
         friend class renderer;
     };
 } // namespace vkrollercoaster
\ No newline at end of file
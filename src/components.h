@@ -33,6 +33,9 @@ namespace vkrollercoaster {
     struct model_component {
         model_component() = default;
         ref<model> data;
+        // the level of detail drawn last, which the renderer keeps until the model's size on
+        // screen has clearly changed
+        size_t lod = 0;
         // todo: animation data (when skinning)
     };
     struct camera_component {
@@ -69,7 +72,12 @@ namespace vkrollercoaster {
         track_segment_component() = default;
 
         entity next;
-        // todo: bezier curve data
+
+        // if set, the curve to the next node is derived from the neighboring nodes. otherwise,
+        // control_points are used - the first relative to this node, the second relative to the
+        // next node
+        bool automatic_curve = true;
+        std::array<glm::vec3, 2> control_points = { glm::vec3(0.f), glm::vec3(0.f) };
     };
 
     //==== scene::on_component_added/scene::on_component_removed overloads ====
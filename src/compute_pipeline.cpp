@@ -0,0 +1,220 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "pch.h"
+#include "compute_pipeline.h"
+#include "renderer.h"
+#include "texture.h"
+#include "util.h"
+namespace vkrollercoaster {
+    compute_pipeline::compute_pipeline(ref<shader> _shader, uint32_t set_copies) {
+        this->m_shader = _shader;
+        this->m_set_copies = set_copies;
+        if (!this->m_shader) {
+            throw std::runtime_error("passed nullptr!");
+        }
+        renderer::add_ref();
+        this->create_descriptor_sets();
+        this->create_pipeline();
+    }
+    compute_pipeline::~compute_pipeline() {
+        VkDevice device = renderer::get_device();
+        VkDescriptorPool descriptor_pool = renderer::get_descriptor_pool();
+        for (const auto& sets : this->m_descriptor_sets) {
+            for (const auto& [_, set] : sets) {
+                vkFreeDescriptorSets(device, descriptor_pool, 1, &set);
+            }
+        }
+        for (const auto& [_, layout] : this->m_set_layouts) {
+            vkDestroyDescriptorSetLayout(device, layout, nullptr);
+        }
+        vkDestroyPipeline(device, this->m_pipeline, nullptr);
+        vkDestroyPipelineLayout(device, this->m_layout, nullptr);
+        renderer::remove_ref();
+    }
+    void compute_pipeline::bind(ref<command_buffer> cmdbuffer, uint32_t copy) {
+        VkCommandBuffer vk_cmdbuffer = cmdbuffer->get();
+        vkCmdBindPipeline(vk_cmdbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->m_pipeline);
+        for (const auto& [set, descriptor_set] : this->m_descriptor_sets[copy]) {
+            vkCmdBindDescriptorSets(vk_cmdbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->m_layout,
+                                    set, 1, &descriptor_set, 0, nullptr);
+        }
+    }
+    void compute_pipeline::push_constants(ref<command_buffer> cmdbuffer, const void* data,
+                                          size_t size) {
+        vkCmdPushConstants(cmdbuffer->get(), this->m_layout, this->m_push_constant_stages, 0,
+                           (uint32_t)size, data);
+    }
+    void compute_pipeline::dispatch(ref<command_buffer> cmdbuffer, glm::uvec3 invocations,
+                                    glm::uvec3 group_size) {
+        glm::uvec3 group_count = (invocations + group_size - 1u) / group_size;
+        vkCmdDispatch(cmdbuffer->get(), group_count.x, group_count.y, group_count.z);
+    }
+    void compute_pipeline::bind_texture(ref<texture> tex, const std::string& name, uint32_t copy) {
+        uint32_t set, binding;
+        this->find_resource(name, shader_resource_type::sampledimage, set, binding);
+        VkDescriptorImageInfo image_info;
+        util::zero(image_info);
+        image_info.imageLayout = tex->m_image->get_layout();
+        image_info.imageView = tex->m_image->get_view();
+        image_info.sampler = tex->m_sampler;
+        this->write_image(set, binding, copy, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                          image_info);
+        this->m_bound_textures.push_back(tex);
+    }
+    void compute_pipeline::bind_storage_image(VkImageView view, const std::string& name,
+                                              uint32_t copy) {
+        uint32_t set, binding;
+        this->find_resource(name, shader_resource_type::storageimage, set, binding);
+        VkDescriptorImageInfo image_info;
+        util::zero(image_info);
+        image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        image_info.imageView = view;
+        this->write_image(set, binding, copy, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, image_info);
+    }
+    void compute_pipeline::find_resource(const std::string& name, shader_resource_type type,
+                                         uint32_t& set, uint32_t& binding) {
+        auto& reflection_data = this->m_shader->get_reflection_data();
+        if (!reflection_data.find_resource(name, set, binding)) {
+            throw std::runtime_error("the specified resource was not found!");
+        }
+        if (reflection_data.resources[set][binding].resource_type != type) {
+            throw std::runtime_error("the specified resource is not of the requested type!");
+        }
+    }
+    void compute_pipeline::write_image(uint32_t set, uint32_t binding, uint32_t copy,
+                                       VkDescriptorType type,
+                                       const VkDescriptorImageInfo& image_info) {
+        if (copy >= this->m_set_copies) {
+            throw std::runtime_error("descriptor set copy " + std::to_string(copy) +
+                                     " is out of range!");
+        }
+        VkWriteDescriptorSet write;
+        util::zero(write);
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = this->m_descriptor_sets[copy][set];
+        write.dstBinding = binding;
+        write.dstArrayElement = 0;
+        write.descriptorType = type;
+        write.descriptorCount = 1;
+        write.pImageInfo = &image_info;
+        vkUpdateDescriptorSets(renderer::get_device(), 1, &write, 0, nullptr);
+    }
+    void compute_pipeline::create_descriptor_sets() {
+        const auto& reflection_data = this->m_shader->get_reflection_data();
+        std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> bindings;
+        for (const auto& [set, resources] : reflection_data.resources) {
+            for (const auto& [binding, data] : resources) {
+                VkDescriptorSetLayoutBinding set_binding;
+                util::zero(set_binding);
+                set_binding.binding = binding;
+                set_binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+                set_binding.descriptorCount = reflection_data.types[data.type].array_size;
+                switch (data.resource_type) {
+                case shader_resource_type::sampledimage:
+                    set_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                    break;
+                case shader_resource_type::storageimage:
+                    set_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                    break;
+                default:
+                    // buffers are passed through push constants
+                    throw std::runtime_error("unsupported compute resource type!");
+                }
+                bindings[set].push_back(set_binding);
+            }
+        }
+        VkDevice device = renderer::get_device();
+        VkDescriptorPool descriptor_pool = renderer::get_descriptor_pool();
+        this->m_descriptor_sets.resize(this->m_set_copies);
+        for (const auto& [set, set_bindings] : bindings) {
+            VkDescriptorSetLayoutCreateInfo create_info;
+            util::zero(create_info);
+            create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            create_info.bindingCount = set_bindings.size();
+            create_info.pBindings = set_bindings.data();
+            VkDescriptorSetLayout layout;
+            if (vkCreateDescriptorSetLayout(device, &create_info, nullptr, &layout) != VK_SUCCESS) {
+                throw std::runtime_error("could not create descriptor set layout!");
+            }
+            this->m_set_layouts[set] = layout;
+            std::vector<VkDescriptorSetLayout> layouts(this->m_set_copies, layout);
+            std::vector<VkDescriptorSet> sets(this->m_set_copies);
+            VkDescriptorSetAllocateInfo alloc_info;
+            util::zero(alloc_info);
+            alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            alloc_info.descriptorPool = descriptor_pool;
+            alloc_info.descriptorSetCount = layouts.size();
+            alloc_info.pSetLayouts = layouts.data();
+            if (vkAllocateDescriptorSets(device, &alloc_info, sets.data()) != VK_SUCCESS) {
+                throw std::runtime_error("could not allocate descriptor sets!");
+            }
+            for (uint32_t copy = 0; copy < this->m_set_copies; copy++) {
+                this->m_descriptor_sets[copy][set] = sets[copy];
+            }
+        }
+    }
+    void compute_pipeline::create_pipeline() {
+        const auto& reflection_data = this->m_shader->get_reflection_data();
+        const auto& stages = this->m_shader->get_pipeline_info();
+        if (stages.size() != 1 || stages[0].stage != VK_SHADER_STAGE_COMPUTE_BIT) {
+            throw std::runtime_error("the passed shader is not a compute shader!");
+        }
+        std::vector<VkPushConstantRange> push_constant_ranges;
+        this->m_push_constant_stages = 0;
+        for (const auto& push_constant : reflection_data.push_constant_buffers) {
+            VkPushConstantRange range;
+            util::zero(range);
+            range.stageFlags = shader::get_stage_flags(push_constant.stage);
+            range.offset = 0;
+            range.size = reflection_data.types[push_constant.type].size;
+            push_constant_ranges.push_back(range);
+            this->m_push_constant_stages |= range.stageFlags;
+        }
+        VkPipelineLayoutCreateInfo layout_create_info;
+        util::zero(layout_create_info);
+        layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        std::vector<VkDescriptorSetLayout> set_layouts;
+        for (const auto& [_, layout] : this->m_set_layouts) {
+            set_layouts.push_back(layout);
+        }
+        if (!set_layouts.empty()) {
+            layout_create_info.setLayoutCount = set_layouts.size();
+            layout_create_info.pSetLayouts = set_layouts.data();
+        }
+        if (!push_constant_ranges.empty()) {
+            layout_create_info.pushConstantRangeCount = push_constant_ranges.size();
+            layout_create_info.pPushConstantRanges = push_constant_ranges.data();
+        }
+        VkDevice device = renderer::get_device();
+        if (vkCreatePipelineLayout(device, &layout_create_info, nullptr, &this->m_layout) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("could not create pipeline layout!");
+        }
+        VkComputePipelineCreateInfo create_info;
+        util::zero(create_info);
+        create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        create_info.stage = stages[0];
+        create_info.layout = this->m_layout;
+        create_info.basePipelineHandle = nullptr;
+        create_info.basePipelineIndex = -1;
+        if (vkCreateComputePipelines(device, renderer::get_pipeline_cache(), 1, &create_info,
+                                     nullptr, &this->m_pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("could not create compute pipeline!");
+        }
+    }
+} // namespace vkrollercoaster
\ No newline at end of file
@@ -0,0 +1,65 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#pragma once
+#include "shader.h"
+#include "command_buffer.h"
+namespace vkrollercoaster {
+    class texture;
+    // a pipeline for a single compute shader. it is not tied to a render target, and objects are
+    // written straight into its descriptor sets. several copies of each set can be allocated, so
+    // that a chain of dispatches recorded into one command buffer can each bind different images
+    class compute_pipeline : public ref_counted {
+    public:
+        compute_pipeline(ref<shader> _shader, uint32_t set_copies = 1);
+        ~compute_pipeline();
+        compute_pipeline(const compute_pipeline&) = delete;
+        compute_pipeline& operator=(const compute_pipeline&) = delete;
+        void bind(ref<command_buffer> cmdbuffer, uint32_t copy = 0);
+        void push_constants(ref<command_buffer> cmdbuffer, const void* data, size_t size);
+        template <typename T> void push_constants(ref<command_buffer> cmdbuffer, const T& data) {
+            this->push_constants(cmdbuffer, &data, sizeof(T));
+        }
+        // dispatches enough groups to cover the given number of invocations, given the group
+        // size the shader was written with
+        void dispatch(ref<command_buffer> cmdbuffer, glm::uvec3 invocations,
+                      glm::uvec3 group_size);
+        void bind_texture(ref<texture> tex, const std::string& name, uint32_t copy = 0);
+        // the view is not owned by the pipeline, and its image must be in the general layout
+        // when dispatched
+        void bind_storage_image(VkImageView view, const std::string& name, uint32_t copy = 0);
+        ref<shader> get_shader() { return this->m_shader; }
+        VkPipeline get() { return this->m_pipeline; }
+        VkPipelineLayout get_layout() { return this->m_layout; }
+
+    private:
+        void find_resource(const std::string& name, shader_resource_type type, uint32_t& set,
+                           uint32_t& binding);
+        void write_image(uint32_t set, uint32_t binding, uint32_t copy, VkDescriptorType type,
+                         const VkDescriptorImageInfo& image_info);
+        void create_descriptor_sets();
+        void create_pipeline();
+        ref<shader> m_shader;
+        uint32_t m_set_copies;
+        VkPipelineLayout m_layout;
+        VkPipeline m_pipeline;
+        std::map<uint32_t, VkDescriptorSetLayout> m_set_layouts;
+        std::vector<std::map<uint32_t, VkDescriptorSet>> m_descriptor_sets;
+        VkShaderStageFlags m_push_constant_stages;
+        std::vector<ref<texture>> m_bound_textures;
+    };
+} // namespace vkrollercoaster
\ No newline at end of file
@@ -0,0 +1,110 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "pch.h"
+#include "file_watcher.h"
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+namespace vkrollercoaster {
+    std::string file_watcher::normalize(const fs::path& path) {
+        return fs::weakly_canonical(fs::absolute(path)).string();
+    }
+
+#ifdef __linux__
+    file_watcher::file_watcher() {
+        this->m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (this->m_inotify_fd < 0) {
+            throw std::runtime_error("could not initialize inotify!");
+        }
+    }
+
+    file_watcher::~file_watcher() { close(this->m_inotify_fd); }
+
+    void file_watcher::watch(const fs::path& path) {
+        std::string normalized = normalize(path);
+        if (!this->m_files.insert(normalized).second) {
+            return;
+        }
+        fs::path directory = fs::path(normalized).parent_path();
+        if (this->m_watched_directories.find(directory.string()) !=
+            this->m_watched_directories.end()) {
+            return;
+        }
+        uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+        int descriptor = inotify_add_watch(this->m_inotify_fd, directory.c_str(), mask);
+        if (descriptor < 0) {
+            spdlog::warn("could not watch directory {0}", directory.string());
+            return;
+        }
+        this->m_directories[descriptor] = directory;
+        this->m_watched_directories.insert(directory.string());
+    }
+
+    void file_watcher::poll(std::set<std::string>& changed) {
+        alignas(inotify_event) char buffer[4096];
+        while (true) {
+            ssize_t length = read(this->m_inotify_fd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                break;
+            }
+            for (ssize_t offset = 0; offset < length;) {
+                auto event = (const inotify_event*)(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                auto it = this->m_directories.find(event->wd);
+                if (it == this->m_directories.end() || event->len == 0) {
+                    continue;
+                }
+                std::string path = (it->second / event->name).string();
+                if (this->m_files.find(path) != this->m_files.end()) {
+                    changed.insert(path);
+                }
+            }
+        }
+    }
+#else
+    file_watcher::file_watcher() { this->m_last_poll = std::chrono::steady_clock::now(); }
+
+    file_watcher::~file_watcher() = default;
+
+    void file_watcher::watch(const fs::path& path) {
+        std::string normalized = normalize(path);
+        if (!this->m_files.insert(normalized).second) {
+            return;
+        }
+        std::error_code error;
+        this->m_write_times[normalized] = fs::last_write_time(normalized, error);
+    }
+
+    void file_watcher::poll(std::set<std::string>& changed) {
+        // stat-ing every file every frame would be wasteful
+        auto now = std::chrono::steady_clock::now();
+        if (now - this->m_last_poll < std::chrono::milliseconds(500)) {
+            return;
+        }
+        this->m_last_poll = now;
+        for (auto& [path, write_time] : this->m_write_times) {
+            std::error_code error;
+            auto current_write_time = fs::last_write_time(path, error);
+            if (!error && current_write_time != write_time) {
+                write_time = current_write_time;
+                changed.insert(path);
+            }
+        }
+    }
+#endif
+} // namespace vkrollercoaster
\ No newline at end of file
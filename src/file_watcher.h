@@ -0,0 +1,46 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#pragma once
+namespace vkrollercoaster {
+    // reports changes to a set of files. on linux this is backed by inotify, which watches the
+    // directories containing the files, so that editors that save by renaming a temporary file
+    // are still picked up. elsewhere, modification times are polled
+    class file_watcher : public ref_counted {
+    public:
+        file_watcher();
+        ~file_watcher();
+        file_watcher(const file_watcher&) = delete;
+        file_watcher& operator=(const file_watcher&) = delete;
+
+        void watch(const fs::path& path);
+        // adds the normalized paths of watched files that changed since the last poll
+        void poll(std::set<std::string>& changed);
+
+        static std::string normalize(const fs::path& path);
+
+    private:
+        std::set<std::string> m_files;
+#ifdef __linux__
+        int m_inotify_fd;
+        std::unordered_map<int, fs::path> m_directories;
+        std::set<std::string> m_watched_directories;
+#else
+        std::map<std::string, fs::file_time_type> m_write_times;
+        std::chrono::steady_clock::time_point m_last_poll;
+#endif
+    };
+} // namespace vkrollercoaster
\ No newline at end of file
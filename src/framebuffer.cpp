@@ -219,12 +219,14 @@ namespace vkrollercoaster {
     }
 
     void framebuffer::destroy_framebuffer(bool invoke_callbacks) {
+        VkDevice device = renderer::get_device();
         if (invoke_callbacks) {
+            // frames in flight may still be using objects that are about to be destroyed
+            vkDeviceWaitIdle(device);
             for (const auto& [id, callbacks] : this->m_dependents) {
                 callbacks.destroy();
             }
         }
-        VkDevice device = renderer::get_device();
         vkDestroyFramebuffer(device, this->m_framebuffer, nullptr);
     }
 } // namespace vkrollercoaster
\ No newline at end of file
@@ -0,0 +1,284 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "pch.h"
+#define EXPOSE_IMAGE_UTILS
+#include "ibl_cache.h"
+#define EXPOSE_BUFFER_UTILS
+#include "buffers.h"
+#include "renderer.h"
+#include "upload_queue.h"
+#include "util.h"
+namespace vkrollercoaster {
+    static fs::path get_entry_path(const std::string& name, uint64_t key) {
+        fs::path directory = util::get_cache_directory() / "ibl";
+        if (!fs::exists(directory)) {
+            fs::create_directories(directory);
+        }
+        std::stringstream filename;
+        filename << name << "_" << std::hex << key << ".ktx";
+        return directory / filename.str();
+    }
+
+    // ktx 1 files describe their format with opengl enums
+    struct ktx_format_desc {
+        uint32_t gl_type, gl_type_size, gl_format, gl_internal_format;
+        size_t texel_size;
+    };
+    static bool get_ktx_format(VkFormat format, ktx_format_desc& desc) {
+        static constexpr uint32_t gl_float = 0x1406;
+        static constexpr uint32_t gl_half_float = 0x140B;
+        static constexpr uint32_t gl_rg = 0x8227;
+        static constexpr uint32_t gl_rgba = 0x1908;
+        static constexpr uint32_t gl_rg16f = 0x822F;
+        static constexpr uint32_t gl_rgba32f = 0x8814;
+        static constexpr uint32_t gl_rgba16f = 0x881A;
+        switch (format) {
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            desc = { gl_float, 4, gl_rgba, gl_rgba32f, 16 };
+            return true;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            desc = { gl_half_float, 2, gl_rgba, gl_rgba16f, 8 };
+            return true;
+        case VK_FORMAT_R16G16_SFLOAT:
+            desc = { gl_half_float, 2, gl_rg, gl_rg16f, 4 };
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // data holds every level one after the other, with the faces of each level packed together
+    static bool write_ktx(const fs::path& path, const ktx_format_desc& desc, uint32_t width,
+                          uint32_t height, uint32_t mip_levels, uint32_t face_count,
+                          const uint8_t* data) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        static constexpr uint8_t identifier[] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31,
+                                                  0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+        file.write((const char*)identifier, sizeof(identifier));
+        uint32_t header[] = {
+            0x04030201, // endianness
+            desc.gl_type,
+            desc.gl_type_size,
+            desc.gl_format,
+            desc.gl_internal_format,
+            desc.gl_format, // base internal format
+            width,
+            height,
+            0, // depth
+            0, // array elements
+            face_count,
+            mip_levels,
+            0, // key/value data size
+        };
+        file.write((const char*)header, sizeof(header));
+
+        // texel sizes are multiples of 4, so neither faces nor levels need padding
+        size_t offset = 0;
+        for (uint32_t level = 0; level < mip_levels; level++) {
+            size_t level_width = std::max(width >> level, 1u);
+            size_t level_height = std::max(height >> level, 1u);
+            uint32_t face_size = (uint32_t)(level_width * level_height * desc.texel_size);
+            file.write((const char*)&face_size, sizeof(uint32_t));
+            file.write((const char*)data + offset, (std::streamsize)face_size * face_count);
+            offset += (size_t)face_size * face_count;
+        }
+        return file.good();
+    }
+
+    // only reads the header, so that an entry can be rejected before any gpu objects exist
+    static bool validate_entry(const fs::path& path, uint32_t face_count) {
+        if (!fs::exists(path)) {
+            return false;
+        }
+        ktxTexture* ktx_data;
+        std::string string_path = path.string();
+        if (ktxTexture_CreateFromNamedFile(string_path.c_str(), KTX_TEXTURE_CREATE_NO_FLAGS,
+                                           &ktx_data) != KTX_SUCCESS) {
+            spdlog::warn("ibl cache entry {0} is corrupt - discarding", string_path);
+            return false;
+        }
+        bool valid = ktx_data->numFaces == face_count &&
+                     ktxTexture_GetVkFormat(ktx_data) != VK_FORMAT_UNDEFINED;
+        ktxTexture_Destroy(ktx_data);
+        if (!valid) {
+            spdlog::warn("ibl cache entry {0} has an unexpected layout - discarding", string_path);
+        }
+        return valid;
+    }
+
+    ref<image_cube> ibl_cache::read_cube(const std::string& name, uint64_t key) {
+        fs::path path = get_entry_path(name, key);
+        if (!validate_entry(path, image_cube::cube_face_count)) {
+            return nullptr;
+        }
+        return ref<image_cube>::create(path);
+    }
+
+    ref<image2d> ibl_cache::read_image(const std::string& name, uint64_t key) {
+        fs::path path = get_entry_path(name, key);
+        if (!validate_entry(path, 1)) {
+            return nullptr;
+        }
+        ktxTexture* ktx_data;
+        std::string string_path = path.string();
+        if (ktxTexture_CreateFromNamedFile(string_path.c_str(),
+                                           KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT,
+                                           &ktx_data) != KTX_SUCCESS) {
+            return nullptr;
+        }
+
+        // image2d only takes raw 8-bit data, so the image is created empty and filled here. it
+        // is left undefined, as the upload queue transitions it on its own queue
+        auto result = ref<image2d>::create(ktxTexture_GetVkFormat(ktx_data), ktx_data->baseWidth,
+                                           ktx_data->baseHeight,
+                                           VK_IMAGE_USAGE_SAMPLED_BIT |
+                                               VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                           VK_IMAGE_ASPECT_COLOR_BIT, false);
+
+        VkBufferImageCopy region;
+        util::zero(region);
+        region.imageSubresource.aspectMask = result->get_image_aspect();
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { ktx_data->baseWidth, ktx_data->baseHeight, 1 };
+
+        static constexpr VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        upload_queue::upload_image(result->get_image(), result->get_image_aspect(), 1, 1,
+                                   ktxTexture_GetData(ktx_data), ktxTexture_GetDataSize(ktx_data),
+                                   ktxTexture_GetElementSize(ktx_data), { region }, final_layout);
+        result->set_layout(final_layout);
+
+        ktxTexture_Destroy(ktx_data);
+        return result;
+    }
+
+    void ibl_cache::write(const std::string& name, uint64_t key, ref<image> _image) {
+        uint32_t width, height, mip_levels, face_count;
+        switch (_image->get_type()) {
+        case image_type::image2d: {
+            auto _image2d = _image.as<image2d>();
+            width = _image2d->get_width();
+            height = _image2d->get_height();
+            mip_levels = _image2d->get_mip_levels();
+            face_count = 1;
+        } break;
+        case image_type::image_cube: {
+            auto cube = _image.as<image_cube>();
+            width = cube->get_width();
+            height = cube->get_height();
+            mip_levels = cube->get_mip_levels();
+            face_count = image_cube::cube_face_count;
+        } break;
+        default:
+            return;
+        }
+        ktx_format_desc format_desc;
+        if (!get_ktx_format(_image->get_format(), format_desc)) {
+            spdlog::warn("{0} cannot be cached, as its format is not supported", name);
+            return;
+        }
+
+        // copy every level into one buffer, laid out the way write_ktx expects
+        std::vector<VkBufferImageCopy> regions;
+        size_t buffer_size = 0;
+        for (uint32_t level = 0; level < mip_levels; level++) {
+            uint32_t level_width = std::max(width >> level, 1u);
+            uint32_t level_height = std::max(height >> level, 1u);
+
+            VkBufferImageCopy region;
+            util::zero(region);
+            region.bufferOffset = buffer_size;
+            region.imageSubresource.aspectMask = _image->get_image_aspect();
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = face_count;
+            region.imageExtent = { level_width, level_height, 1 };
+            regions.push_back(region);
+
+            buffer_size += (size_t)level_width * level_height * format_desc.texel_size * face_count;
+        }
+
+        allocator _allocator;
+        _allocator.set_source("ibl_cache");
+        VkBuffer buffer;
+        VmaAllocation allocation;
+        create_buffer(_allocator, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VMA_MEMORY_USAGE_GPU_TO_CPU, buffer, allocation);
+
+        {
+            static constexpr VkImageLayout transfer_layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            VkImage vk_image = _image->get_image();
+            VkImageLayout layout = _image->get_layout();
+            VkImageAspectFlags aspect = _image->get_image_aspect();
+
+            auto cmdbuffer = renderer::create_single_time_command_buffer();
+            cmdbuffer->begin();
+
+            transition_image_layout(vk_image, layout, transfer_layout, aspect, face_count,
+                                    cmdbuffer);
+            vkCmdCopyImageToBuffer(cmdbuffer->get(), vk_image, transfer_layout, buffer,
+                                   regions.size(), regions.data());
+
+            // make the copy visible to the host before it is read back
+            VkBufferMemoryBarrier barrier;
+            util::zero(barrier);
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            vkCmdPipelineBarrier(cmdbuffer->get(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0,
+                                 nullptr);
+            transition_image_layout(vk_image, transfer_layout, layout, aspect, face_count,
+                                    cmdbuffer);
+
+            cmdbuffer->end();
+            cmdbuffer->submit();
+            cmdbuffer->wait();
+        }
+
+        // write to a temporary file first, so that an interrupted write is never read back
+        fs::path path = get_entry_path(name, key);
+        fs::path temporary_path = path;
+        temporary_path += ".tmp";
+        // readback memory is usually cached, and not necessarily coherent
+        auto data = (const uint8_t*)_allocator.map(allocation);
+        _allocator.invalidate(allocation);
+        bool written = write_ktx(temporary_path, format_desc, width, height, mip_levels,
+                                 face_count, data);
+        _allocator.unmap(allocation);
+        _allocator.free(buffer, allocation);
+
+        std::error_code error;
+        if (written) {
+            fs::rename(temporary_path, path, error);
+        }
+        if (!written || error) {
+            spdlog::warn("could not write ibl cache entry {0}", path.string());
+            fs::remove(temporary_path, error);
+        }
+    }
+} // namespace vkrollercoaster
\ No newline at end of file
@@ -0,0 +1,34 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#pragma once
+#include "image.h"
+namespace vkrollercoaster {
+    // on-disk cache of generated image-based lighting textures, stored as ktx files. entries are
+    // keyed by everything that determines their contents, such as the source image and the
+    // parameters they were generated with
+    class ibl_cache {
+    public:
+        ibl_cache() = delete;
+
+        static ref<image_cube> read_cube(const std::string& name, uint64_t key);
+        static ref<image2d> read_image(const std::string& name, uint64_t key);
+        // reads the image back from the gpu. it must be in the shader read-only layout, and must
+        // have been created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+        static void write(const std::string& name, uint64_t key, ref<image> _image);
+    };
+} // namespace vkrollercoaster
\ No newline at end of file
@@ -23,6 +23,7 @@
 #include "renderer.h"
 #include "util.h"
 #include "texture.h"
+#include "upload_queue.h"
 #define STBI_NO_SIMD
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -44,7 +45,8 @@ namespace vkrollercoaster {
 
     void create_image(const allocator& _allocator, uint32_t width, uint32_t height, uint32_t depth,
                       VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-                      VmaMemoryUsage memory_usage, VkImage& image, VmaAllocation& allocation) {
+                      VmaMemoryUsage memory_usage, VkImage& image, VmaAllocation& allocation,
+                      uint32_t mip_levels) {
         VkDevice device = renderer::get_device();
         VkImageCreateInfo create_info;
         util::zero(create_info);
@@ -53,7 +55,7 @@ namespace vkrollercoaster {
         create_info.extent.width = width;
         create_info.extent.height = height;
         create_info.extent.depth = depth;
-        create_info.mipLevels = 1;
+        create_info.mipLevels = mip_levels;
         create_info.arrayLayers = 1;
         create_info.format = format;
         create_info.tiling = tiling;
@@ -119,7 +121,7 @@ namespace vkrollercoaster {
 
         barrier.subresourceRange.aspectMask = image_aspect;
         barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
         barrier.subresourceRange.baseArrayLayer = 0;
         barrier.subresourceRange.layerCount = layer_count;
 
@@ -144,28 +146,6 @@ namespace vkrollercoaster {
         }
     }
 
-    static void copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width,
-                                     uint32_t height, uint32_t depth,
-                                     ref<command_buffer> cmdbuffer) {
-        VkBufferImageCopy region;
-        util::zero(region);
-
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-
-        region.imageOffset = { 0, 0, 0 };
-        region.imageExtent = { width, height, depth };
-
-        vkCmdCopyBufferToImage(cmdbuffer->get(), buffer, image,
-                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-    }
-
     bool image::load_image(const fs::path& path, image_data& data, bool flip) {
         if (!fs::exists(path)) {
             return false;
@@ -180,26 +160,32 @@ namespace vkrollercoaster {
                 return false;
             }
 
-            size_t offset;
-            if (ktxTexture_GetImageOffset(ktx_data, 0, 0, 0, &offset) != KTX_SUCCESS) {
-                return false;
-            }
-
             data.width = (int32_t)ktx_data->baseWidth;
             data.height = (int32_t)ktx_data->baseHeight;
             data.channels = 4; // we'll just have to assume
 
-            size_t data_size = (size_t)data.width * data.height * data.channels;
-            data.data.resize(data_size);
-
-            uint8_t* raw_data = ktxTexture_GetData(ktx_data) + offset;
-            if (raw_data != nullptr) {
-                memcpy(data.data.data(), raw_data, data_size);
+            // keep every mip level the file was baked with
+            for (uint32_t level = 0; level < ktx_data->numLevels; level++) {
+                size_t offset;
+                if (ktxTexture_GetImageOffset(ktx_data, level, 0, 0, &offset) != KTX_SUCCESS) {
+                    ktxTexture_Destroy(ktx_data);
+                    return false;
+                }
+                size_t level_width = std::max((size_t)data.width >> level, (size_t)1);
+                size_t level_height = std::max((size_t)data.height >> level, (size_t)1);
+                size_t level_size = level_width * level_height * data.channels;
+
+                size_t data_offset = data.data.size();
+                data.data.resize(data_offset + level_size);
+                memcpy(data.data.data() + data_offset, ktxTexture_GetData(ktx_data) + offset,
+                       level_size);
+                if (ktx_data->numLevels > 1) {
+                    data.mip_offsets.push_back(data_offset);
+                }
             }
 
             ktxTexture_Destroy(ktx_data);
         } else {
-            stbi_set_flip_vertically_on_load(flip);
             uint8_t* raw_data =
                 stbi_load(string_path.c_str(), &data.width, &data.height, &data.channels, 0);
             if (!raw_data) {
@@ -207,8 +193,17 @@ namespace vkrollercoaster {
             }
             size_t byte_count = (size_t)data.width * data.height * data.channels;
             data.data.resize(byte_count);
-            // probably shouldnt use memcpy
-            memcpy(data.data.data(), raw_data, byte_count * sizeof(uint8_t));
+            if (flip) {
+                // flipped here rather than by stb_image, as its flip setting is global, and
+                // images are decoded on several threads at once
+                size_t row_size = (size_t)data.width * data.channels;
+                for (int32_t y = 0; y < data.height; y++) {
+                    memcpy(data.data.data() + (data.height - 1 - y) * row_size,
+                           raw_data + y * row_size, row_size);
+                }
+            } else {
+                memcpy(data.data.data(), raw_data, byte_count * sizeof(uint8_t));
+            }
             stbi_image_free(raw_data);
         }
         return true;
@@ -240,7 +235,7 @@ namespace vkrollercoaster {
     }
 
     image2d::image2d(VkFormat format, uint32_t width, uint32_t height, VkImageUsageFlags usage,
-                     VkImageAspectFlags aspect) {
+                     VkImageAspectFlags aspect, bool transition_layout) {
         // only use this constructor for internal things such as depth buffering
         renderer::add_ref();
         this->init_basic();
@@ -248,10 +243,13 @@ namespace vkrollercoaster {
         this->m_aspect = aspect;
         this->m_width = width;
         this->m_height = height;
+        this->m_mip_levels = 1;
         create_image(this->m_allocator, this->m_width, this->m_height, 1, this->m_format,
                      VK_IMAGE_TILING_OPTIMAL, usage, VMA_MEMORY_USAGE_GPU_ONLY, this->m_image,
                      this->m_allocation);
-        this->transition(VK_IMAGE_LAYOUT_GENERAL);
+        if (transition_layout) {
+            this->transition(VK_IMAGE_LAYOUT_GENERAL);
+        }
         this->create_view();
     }
 
@@ -273,6 +271,17 @@ namespace vkrollercoaster {
         this->m_allocator.set_source("image2d");
     }
 
+    // whether the gpu can generate a mip chain for the given format by linearly blitting each
+    // level from the one before it
+    static bool supports_mip_generation(VkFormat format) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(renderer::get_physical_device(), format, &properties);
+        VkFormatFeatureFlags required_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                                 VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                                 VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        return (properties.optimalTilingFeatures & required_features) == required_features;
+    }
+
     void image2d::create_image_from_data(const image_data& data) {
         switch (data.channels) {
         case 4:
@@ -285,40 +294,47 @@ namespace vkrollercoaster {
             throw std::runtime_error("invalid image format!");
         }
 
-        VkBuffer staging_buffer;
-        VmaAllocation staging_allocation;
-        size_t total_size = (size_t)this->m_width * this->m_height * data.channels;
-        create_buffer(this->m_allocator, total_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU, staging_buffer, staging_allocation);
+        // use the file's own mip chain if it has one. otherwise, generate a full chain on the
+        // gpu if the format allows it
+        bool generate_mips = false;
+        if (!data.mip_offsets.empty()) {
+            this->m_mip_levels = (uint32_t)data.mip_offsets.size();
+        } else if (supports_mip_generation(this->m_format)) {
+            uint32_t largest_dimension = std::max(this->m_width, this->m_height);
+            this->m_mip_levels = (uint32_t)std::floor(std::log2(largest_dimension)) + 1;
+            generate_mips = true;
+        } else {
+            this->m_mip_levels = 1;
+        }
 
-        void* gpu_data = this->m_allocator.map(staging_allocation);
-        memcpy(gpu_data, data.data.data(), total_size);
-        this->m_allocator.unmap(staging_allocation);
         create_image(this->m_allocator, this->m_width, this->m_height, 1, this->m_format,
                      VK_IMAGE_TILING_OPTIMAL,
                      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
                          VK_IMAGE_USAGE_SAMPLED_BIT,
-                     VMA_MEMORY_USAGE_GPU_ONLY, this->m_image, this->m_allocation);
-
-        static constexpr VkImageLayout intermediate_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        static constexpr VkImageLayout final_layout = VK_IMAGE_LAYOUT_GENERAL;
+                     VMA_MEMORY_USAGE_GPU_ONLY, this->m_image, this->m_allocation,
+                     this->m_mip_levels);
 
-        auto cmdbuffer = renderer::create_single_time_command_buffer();
-        cmdbuffer->begin();
-
-        transition_image_layout(this->m_image, this->m_layout, intermediate_layout, this->m_aspect,
-                                1, cmdbuffer);
-        copy_buffer_to_image(staging_buffer, this->m_image, this->m_width, this->m_height, 1,
-                             cmdbuffer);
-        transition_image_layout(this->m_image, intermediate_layout, final_layout, this->m_aspect, 1,
-                                cmdbuffer);
+        std::vector<VkBufferImageCopy> regions;
+        uint32_t copied_levels = generate_mips ? 1 : this->m_mip_levels;
+        for (uint32_t level = 0; level < copied_levels; level++) {
+            VkBufferImageCopy region;
+            util::zero(region);
+            region.bufferOffset = data.mip_offsets.empty() ? 0 : data.mip_offsets[level];
+            region.imageSubresource.aspectMask = this->m_aspect;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = { std::max(this->m_width >> level, 1u),
+                                   std::max(this->m_height >> level, 1u), 1 };
+            regions.push_back(region);
+        }
 
-        cmdbuffer->end();
-        cmdbuffer->submit();
-        cmdbuffer->wait();
+        // images created from data are almost always sampled, so skip the general layout
+        static constexpr VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        upload_queue::upload_image(this->m_image, this->m_aspect, this->m_mip_levels, 1,
+                                   data.data.data(), data.data.size(), data.channels, regions,
+                                   final_layout, generate_mips);
         this->m_layout = final_layout;
-
-        this->m_allocator.free(staging_buffer, staging_allocation);
     }
 
     void image2d::create_view() {
@@ -332,7 +348,7 @@ namespace vkrollercoaster {
 
         create_info.subresourceRange.aspectMask = this->m_aspect;
         create_info.subresourceRange.baseMipLevel = 0;
-        create_info.subresourceRange.levelCount = 1;
+        create_info.subresourceRange.levelCount = this->m_mip_levels;
         create_info.subresourceRange.baseArrayLayer = 0;
         create_info.subresourceRange.layerCount = 1;
 
@@ -350,6 +366,7 @@ namespace vkrollercoaster {
         if (!fs::exists(path)) {
             throw std::runtime_error("the requested image does not exist!");
         }
+        this->m_path = path;
         if (path.extension() == ".ktx") {
             this->from_ktx(path);
         } else {
@@ -360,11 +377,15 @@ namespace vkrollercoaster {
     }
 
     image_cube::image_cube(VkFormat format, uint32_t width, uint32_t height,
-                           VkImageUsageFlags usage, VkImageAspectFlags image_aspect) {
+                           VkImageUsageFlags usage, VkImageAspectFlags image_aspect,
+                           uint32_t mip_levels) {
         renderer::add_ref();
         this->init_basic();
         this->m_format = format;
         this->m_aspect = image_aspect;
+        this->m_width = width;
+        this->m_height = height;
+        this->m_mip_levels = mip_levels;
 
         {
             VkImageCreateInfo image_create_info;
@@ -373,13 +394,13 @@ namespace vkrollercoaster {
             image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
             image_create_info.imageType = VK_IMAGE_TYPE_2D;
             image_create_info.format = this->m_format;
-            image_create_info.mipLevels = 1;
+            image_create_info.mipLevels = this->m_mip_levels;
             image_create_info.arrayLayers = cube_face_count;
             image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
             image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
             image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
             image_create_info.extent = { width, height, 1 };
-            image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            image_create_info.usage = usage;
             image_create_info.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
             get_sharing_mode(image_create_info);
 
@@ -408,6 +429,7 @@ namespace vkrollercoaster {
 
     void image_cube::init_basic() {
         this->m_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        this->m_mip_levels = 1;
         this->m_allocator.set_source("image_cube");
     }
 
@@ -447,6 +469,18 @@ namespace vkrollercoaster {
         image_extent.width = width / 4;
         image_extent.height = height / 3;
         image_extent.depth = 1;
+        this->m_width = image_extent.width;
+        this->m_height = image_extent.height;
+
+        // the faces are blitted down into a full mip chain, so that filtering can read the
+        // environment at a lower resolution instead of taking more samples
+        bool generate_mips = supports_mip_generation(this->m_format);
+        if (generate_mips) {
+            uint32_t largest_dimension = std::max(this->m_width, this->m_height);
+            this->m_mip_levels = (uint32_t)std::floor(std::log2(largest_dimension)) + 1;
+        } else {
+            this->m_mip_levels = 1;
+        }
 
         // set up image copy info
         std::vector<VkImageCopy> copy_regions;
@@ -481,13 +515,14 @@ namespace vkrollercoaster {
 
         image_create_info.imageType = VK_IMAGE_TYPE_2D;
         image_create_info.format = this->m_format;
-        image_create_info.mipLevels = 1;
+        image_create_info.mipLevels = this->m_mip_levels;
         image_create_info.arrayLayers = cube_face_count;
         image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
         image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
         image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         image_create_info.extent = image_extent;
-        image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                  VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
         image_create_info.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
         get_sharing_mode(image_create_info);
 
@@ -512,8 +547,12 @@ namespace vkrollercoaster {
                                 cube_face_count, cmdbuffer);
         vkCmdCopyImage(cmdbuffer->get(), source_image, intermediate_source_layout, this->m_image,
                        intermediate_layout, copy_regions.size(), copy_regions.data());
-        transition_image_layout(this->m_image, intermediate_layout, final_layout, this->m_aspect,
-                                cube_face_count, cmdbuffer);
+        if (generate_mips) {
+            this->generate_mip_chain(cmdbuffer, intermediate_layout, final_layout);
+        } else {
+            transition_image_layout(this->m_image, intermediate_layout, final_layout,
+                                    this->m_aspect, cube_face_count, cmdbuffer);
+        }
         transition_image_layout(source_image, intermediate_source_layout, original_source_layout,
                                 source->get_image_aspect(), 1, cmdbuffer);
 
@@ -524,6 +563,73 @@ namespace vkrollercoaster {
         this->m_layout = final_layout;
     }
 
+    void image_cube::generate_mip_chain(ref<command_buffer> cmdbuffer,
+                                        VkImageLayout current_layout, VkImageLayout final_layout) {
+        VkImageMemoryBarrier barrier;
+        util::zero(barrier);
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.image = this->m_image;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = this->m_aspect;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = cube_face_count;
+
+        // each level is blitted from the one before it, which is made a transfer source first
+        int32_t width = (int32_t)this->m_width;
+        int32_t height = (int32_t)this->m_height;
+        for (uint32_t level = 1; level < this->m_mip_levels; level++) {
+            barrier.oldLayout = current_layout;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.subresourceRange.baseMipLevel = level - 1;
+            vkCmdPipelineBarrier(cmdbuffer->get(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                                 &barrier);
+
+            int32_t next_width = std::max(width / 2, 1);
+            int32_t next_height = std::max(height / 2, 1);
+
+            VkImageBlit blit;
+            util::zero(blit);
+            blit.srcOffsets[1] = { width, height, 1 };
+            blit.srcSubresource.aspectMask = this->m_aspect;
+            blit.srcSubresource.mipLevel = level - 1;
+            blit.srcSubresource.layerCount = cube_face_count;
+            blit.dstOffsets[1] = { next_width, next_height, 1 };
+            blit.dstSubresource.aspectMask = this->m_aspect;
+            blit.dstSubresource.mipLevel = level;
+            blit.dstSubresource.layerCount = cube_face_count;
+            vkCmdBlitImage(cmdbuffer->get(), this->m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           this->m_image, current_layout, 1, &blit, VK_FILTER_LINEAR);
+
+            width = next_width;
+            height = next_height;
+        }
+
+        // every level but the last one was read from, and is now a transfer source
+        std::vector<VkImageMemoryBarrier> barriers;
+        if (this->m_mip_levels > 1) {
+            auto& source_barrier = barriers.emplace_back(barrier);
+            source_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            source_barrier.newLayout = final_layout;
+            source_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            source_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            source_barrier.subresourceRange.baseMipLevel = 0;
+            source_barrier.subresourceRange.levelCount = this->m_mip_levels - 1;
+        }
+        auto& last_barrier = barriers.emplace_back(barrier);
+        last_barrier.oldLayout = current_layout;
+        last_barrier.newLayout = final_layout;
+        last_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        last_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        last_barrier.subresourceRange.baseMipLevel = this->m_mip_levels - 1;
+        vkCmdPipelineBarrier(cmdbuffer->get(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+                             barriers.size(), barriers.data());
+    }
+
     void image_cube::from_ktx(const fs::path& path) {
         ktxTexture* ktx_data;
         std::string string_path = path.string();
@@ -534,49 +640,41 @@ namespace vkrollercoaster {
         }
 
         this->m_format = ktxTexture_GetVkFormat(ktx_data);
-        uint32_t width = ktx_data->baseWidth;
-        uint32_t height = ktx_data->baseHeight;
+        this->m_width = ktx_data->baseWidth;
+        this->m_height = ktx_data->baseHeight;
+        this->m_mip_levels = ktx_data->numLevels;
 
         uint8_t* image_data = ktxTexture_GetData(ktx_data);
         size_t data_size = ktxTexture_GetDataSize(ktx_data);
 
-        // allocate buffer for copying data
-        VkBuffer staging_buffer;
-        VmaAllocation staging_allocation;
-        create_buffer(this->m_allocator, data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VMA_MEMORY_USAGE_CPU_TO_GPU, staging_buffer, staging_allocation);
-
-        void* gpu_data = this->m_allocator.map(staging_allocation);
-        memcpy(gpu_data, image_data, data_size);
-        this->m_allocator.unmap(staging_allocation);
-
-        // setup buffer copy info
+        // setup buffer copy info for every face of every level the file came with
         std::vector<VkBufferImageCopy> copy_regions;
-        for (uint32_t face = 0; face < cube_face_count; face++) {
-            size_t offset;
-            if (ktxTexture_GetImageOffset(ktx_data, 0, 0, face, &offset) != KTX_SUCCESS) {
-                throw std::runtime_error("could not get a memory offset for face " +
-                                         std::to_string(face));
+        for (uint32_t level = 0; level < this->m_mip_levels; level++) {
+            for (uint32_t face = 0; face < cube_face_count; face++) {
+                size_t offset;
+                if (ktxTexture_GetImageOffset(ktx_data, level, 0, face, &offset) != KTX_SUCCESS) {
+                    throw std::runtime_error("could not get a memory offset for face " +
+                                             std::to_string(face) + " of level " +
+                                             std::to_string(level));
+                }
+
+                VkBufferImageCopy region;
+                util::zero(region);
+
+                region.imageSubresource.aspectMask = this->m_aspect;
+                region.imageSubresource.mipLevel = level;
+                region.imageSubresource.baseArrayLayer = face;
+                region.imageSubresource.layerCount = 1;
+
+                region.imageExtent.width = std::max(this->m_width >> level, 1u);
+                region.imageExtent.height = std::max(this->m_height >> level, 1u);
+                region.imageExtent.depth = 1;
+
+                region.bufferOffset = offset;
+                copy_regions.push_back(region);
             }
-
-            VkBufferImageCopy region;
-            util::zero(region);
-
-            region.imageSubresource.aspectMask = this->m_aspect;
-            region.imageSubresource.mipLevel = 0;
-            region.imageSubresource.baseArrayLayer = face;
-            region.imageSubresource.layerCount = 1;
-
-            region.imageExtent.width = width;
-            region.imageExtent.height = height;
-            region.imageExtent.depth = 1;
-
-            region.bufferOffset = offset;
-            copy_regions.push_back(region);
         }
 
-        ktxTexture_Destroy(ktx_data);
-
         // create an image
         VkImageCreateInfo image_create_info;
         util::zero(image_create_info);
@@ -584,12 +682,12 @@ namespace vkrollercoaster {
 
         image_create_info.imageType = VK_IMAGE_TYPE_2D;
         image_create_info.format = this->m_format;
-        image_create_info.mipLevels = 1;
+        image_create_info.mipLevels = this->m_mip_levels;
         image_create_info.arrayLayers = cube_face_count;
         image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
         image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
         image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        image_create_info.extent = { width, height, 1 };
+        image_create_info.extent = { this->m_width, this->m_height, 1 };
         image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
         image_create_info.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
         get_sharing_mode(image_create_info);
@@ -597,28 +695,14 @@ namespace vkrollercoaster {
         this->m_allocator.alloc(image_create_info, VMA_MEMORY_USAGE_GPU_ONLY, this->m_image,
                                 this->m_allocation);
 
-        static constexpr VkImageLayout intermediate_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        static constexpr VkImageLayout final_layout = VK_IMAGE_LAYOUT_GENERAL;
-
-        // begin a command buffer
-        auto cmdbuffer = renderer::create_single_time_command_buffer();
-        cmdbuffer->begin();
-
-        // copy data and transition layout
-        transition_image_layout(this->m_image, this->m_layout, intermediate_layout, this->m_aspect,
-                                cube_face_count, cmdbuffer);
-        vkCmdCopyBufferToImage(cmdbuffer->get(), staging_buffer, this->m_image, intermediate_layout,
-                               copy_regions.size(), copy_regions.data());
-        transition_image_layout(this->m_image, intermediate_layout, final_layout, this->m_aspect,
-                                cube_face_count, cmdbuffer);
-
-        // flush the command buffer
-        cmdbuffer->end();
-        cmdbuffer->submit();
-        cmdbuffer->wait();
+        // queue the face data for upload
+        static constexpr VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        upload_queue::upload_image(this->m_image, this->m_aspect, this->m_mip_levels,
+                                   cube_face_count, image_data, data_size,
+                                   ktxTexture_GetElementSize(ktx_data), copy_regions, final_layout);
         this->m_layout = final_layout;
 
-        this->m_allocator.free(staging_buffer, staging_allocation);
+        ktxTexture_Destroy(ktx_data);
     }
 
     void image_cube::create_view() {
@@ -630,7 +714,7 @@ namespace vkrollercoaster {
         create_info.image = this->m_image;
         create_info.format = this->m_format;
         create_info.subresourceRange.aspectMask = this->m_aspect;
-        create_info.subresourceRange.levelCount = 1;
+        create_info.subresourceRange.levelCount = this->m_mip_levels;
         create_info.subresourceRange.layerCount = cube_face_count;
 
         VkDevice device = renderer::get_device();
@@ -638,4 +722,4 @@ namespace vkrollercoaster {
             throw std::runtime_error("could not create cube image view!");
         }
     }
-} // namespace vkrollercoaster
+} // namespace vkrollercoaster
\ No newline at end of file
@@ -21,7 +21,8 @@ namespace vkrollercoaster {
 #ifdef EXPOSE_IMAGE_UTILS
     void create_image(const allocator& _allocator, uint32_t width, uint32_t height, uint32_t depth,
                       VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-                      VmaMemoryUsage memory_usage, VkImage& image, VmaAllocation& allocation);
+                      VmaMemoryUsage memory_usage, VkImage& image, VmaAllocation& allocation,
+                      uint32_t mip_levels = 1);
     void transition_image_layout(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout,
                                  VkImageAspectFlags image_aspect, uint32_t layer_count,
                                  ref<command_buffer> cmdbuffer = nullptr);
@@ -35,6 +36,8 @@ namespace vkrollercoaster {
     struct image_data {
         std::vector<uint8_t> data;
         int32_t width, height, channels;
+        // offsets of each mip level within data, if the file came with its own mip chain
+        std::vector<size_t> mip_offsets;
     };
 
     class texture;
@@ -72,8 +75,10 @@ namespace vkrollercoaster {
         static ref<image2d> from_file(const fs::path& path, bool flip = false);
 
         image2d(const image_data& data);
+        // the image is moved into the general layout, unless transition_layout is false, in which
+        // case it is left undefined for the caller to fill, for example through the upload queue
         image2d(VkFormat format, uint32_t width, uint32_t height, VkImageUsageFlags usage,
-                VkImageAspectFlags image_aspect);
+                VkImageAspectFlags image_aspect, bool transition_layout = true);
         virtual ~image2d() override;
 
         virtual void transition(VkImageLayout new_layout) override;
@@ -86,6 +91,7 @@ namespace vkrollercoaster {
 
         uint32_t get_width() { return this->m_width; }
         uint32_t get_height() { return this->m_height; }
+        uint32_t get_mip_levels() { return this->m_mip_levels; }
 
 #ifndef EXPOSE_IMAGE_UTILS
     protected:
@@ -99,7 +105,7 @@ namespace vkrollercoaster {
         void create_image_from_data(const image_data& data);
         void create_view();
 
-        uint32_t m_width, m_height;
+        uint32_t m_width, m_height, m_mip_levels;
         VkImage m_image;
         VkImageView m_view;
         VmaAllocation m_allocation;
@@ -115,7 +121,7 @@ namespace vkrollercoaster {
 
         image_cube(const fs::path& path);
         image_cube(VkFormat format, uint32_t width, uint32_t height, VkImageUsageFlags usage,
-                   VkImageAspectFlags image_aspect);
+                   VkImageAspectFlags image_aspect, uint32_t mip_levels = 1);
         virtual ~image_cube() override;
 
         virtual void transition(VkImageLayout new_layout) override;
@@ -126,6 +132,13 @@ namespace vkrollercoaster {
         virtual VkImageAspectFlags get_image_aspect() override { return this->m_aspect; }
         virtual image_type get_type() override { return image_type::image_cube; }
 
+        // the size of each face
+        uint32_t get_width() { return this->m_width; }
+        uint32_t get_height() { return this->m_height; }
+        uint32_t get_mip_levels() { return this->m_mip_levels; }
+        // the file this cube was loaded from, if any
+        const fs::path& get_path() { return this->m_path; }
+
 #ifndef EXPOSE_IMAGE_UTILS
     protected:
 #endif
@@ -136,9 +149,14 @@ namespace vkrollercoaster {
     private:
         void init_basic();
         void from_image(const fs::path& path);
+        // blits level 0 down into every other level, leaving the whole image in final_layout
+        void generate_mip_chain(ref<command_buffer> cmdbuffer, VkImageLayout current_layout,
+                                VkImageLayout final_layout);
         void from_ktx(const fs::path& path);
         void create_view();
 
+        uint32_t m_width, m_height, m_mip_levels;
+        fs::path m_path;
         VkImage m_image;
         VkImageView m_view;
         VmaAllocation m_allocation;
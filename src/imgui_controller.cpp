@@ -37,7 +37,6 @@ namespace vkrollercoaster {
         bool show_demo_window = false;
 
         VkDescriptorPool descriptor_pool = nullptr;
-        VkPipelineCache pipeline_cache = nullptr;
     } imgui_data;
     static void set_style() {
         ImGuiStyle& style = ImGui::GetStyle();
@@ -121,18 +120,6 @@ namespace vkrollercoaster {
                 throw std::runtime_error("could not create imgui descriptor pool");
             }
         }
-
-        // pipeline cache
-        {
-            VkPipelineCacheCreateInfo create_info;
-            util::zero(create_info);
-            create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-
-            if (vkCreatePipelineCache(device, &create_info, nullptr, &imgui_data.pipeline_cache) !=
-                VK_SUCCESS) {
-                throw std::runtime_error("could not create imgui pipeline cache");
-            }
-        }
     }
     void imgui_controller::init(ref<swapchain> _swapchain) {
         imgui_data.swap_chain = _swapchain;
@@ -172,7 +159,7 @@ namespace vkrollercoaster {
         init_info.Device = renderer::get_device();
         init_info.QueueFamily = *renderer::find_queue_families(physical_device).graphics_family;
         init_info.Queue = renderer::get_graphics_queue();
-        init_info.PipelineCache = imgui_data.pipeline_cache;
+        init_info.PipelineCache = renderer::get_pipeline_cache();
         init_info.DescriptorPool = imgui_data.descriptor_pool;
         init_info.ImageCount = imgui_data.swap_chain->get_swapchain_images().size();
 
@@ -210,7 +197,6 @@ namespace vkrollercoaster {
 
         // clean up imgui vulkan objects
         VkDevice device = renderer::get_device();
-        vkDestroyPipelineCache(device, imgui_data.pipeline_cache, nullptr);
         vkDestroyDescriptorPool(device, imgui_data.descriptor_pool, nullptr);
 
         // allow renderer to be shut down
@@ -19,9 +19,16 @@
 #include "shader.h"
 #include "components.h"
 namespace vkrollercoaster {
+    struct light_type_fields {
+        shader_field_handle count, array;
+        // fields of a single array element, relative to its start. fields that the shader does
+        // not declare are cached as empty optionals
+        std::unordered_map<std::string, std::optional<shader_field_handle>> members;
+    };
     struct light_buffer_data {
         ref<uniform_buffer> buffer;
         uint32_t set, binding;
+        std::map<light_type, light_type_fields> fields;
     };
     static struct {
         std::unordered_map<std::string, light_buffer_data> buffers;
@@ -69,6 +76,27 @@ namespace vkrollercoaster {
             buffer.buffer->zero();
         }
     }
+    static void resolve_light_fields(const std::string& shader_name,
+                                     const shader_reflection_data& reflection_data,
+                                     const light_buffer_data& buffer,
+                                     const std::string& light_type_name,
+                                     light_type_fields& fields) {
+        size_t type = reflection_data.resources.at(buffer.set).at(buffer.binding).type;
+        std::string count_field_name = light_type_name + "_count";
+        std::string array_field_name = light_type_name + "s";
+        if (!reflection_data.resolve_field(type, count_field_name, fields.count)) {
+            throw std::runtime_error("shader " + shader_name + " does not have a " +
+                                     count_field_name + " field!");
+        }
+        if (!reflection_data.resolve_field(type, array_field_name, fields.array)) {
+            throw std::runtime_error("shader " + shader_name + " does not have a " +
+                                     array_field_name + " field!");
+        }
+        if (fields.array.array_stride == 0) {
+            throw std::runtime_error(array_field_name + " is not an array!");
+        }
+        fields.members.clear();
+    }
     void light::update_buffers(const std::vector<entity>& entities) {
         std::string light_type_name;
         switch (this->get_type()) {
@@ -84,45 +112,41 @@ namespace vkrollercoaster {
         default:
             throw std::runtime_error("invalid light type!");
         }
-        std::string count_field_name = light_type_name + "_count";
-        std::string array_field_name = light_type_name + "s";
-        for (const auto& [shader_name, buffer] : light_data.buffers) {
+        for (auto& [shader_name, buffer] : light_data.buffers) {
             auto _shader = shader_library::get(shader_name);
-            auto& reflection_data = _shader->get_reflection_data();
-            const auto& resource = reflection_data.resources[buffer.set][buffer.binding];
-            auto& type = reflection_data.types[resource.type];
-            if (type.fields.find(count_field_name) == type.fields.end()) {
-                throw std::runtime_error("shader " + shader_name + " does not have a " +
-                                         count_field_name + " field!");
-            }
-            if (type.fields.find(array_field_name) == type.fields.end()) {
-                throw std::runtime_error("shader " + shader_name + " does not have a " +
-                                         array_field_name + " field!");
-            }
-            auto& array_type = reflection_data.types[type.fields[array_field_name].type];
-            if (array_type.array_stride == 0) {
-                throw std::runtime_error(array_field_name + " is not an array!");
+            const auto& reflection_data = _shader->get_reflection_data();
+            auto& fields = buffer.fields[this->get_type()];
+            if (!reflection_data.is_valid(fields.count)) {
+                resolve_light_fields(shader_name, reflection_data, buffer, light_type_name,
+                                     fields);
             }
-            size_t count_offset = type.find_offset(count_field_name);
+
+            int32_t count;
+            buffer.buffer->get_data(count, fields.count.offset);
             for (entity ent : entities) {
                 // get light index
-                int32_t count;
-                buffer.buffer->get_data(count, count_offset);
                 size_t light_index = count++;
-                if (light_index >= array_type.array_size) {
+                if (light_index >= fields.array.array_size) {
                     throw std::runtime_error("cannot have more than " +
-                                             std::to_string(array_type.array_size) +
+                                             std::to_string(fields.array.array_size) +
                                              " of this light type!");
                 }
-                buffer.buffer->set_data(count, count_offset);
 
                 // set up "set" lambda
-                std::string entry_prefix =
-                    array_field_name + "[" + std::to_string(light_index) + "].";
+                size_t element_offset = fields.array.element_offset(light_index);
                 auto buffer_instance = buffer.buffer;
                 set_callback_t set = [&](const std::string& field_name, const void* data,
                                          size_t size, bool optional) {
-                    if (!array_type.path_exists(field_name)) {
+                    auto it = fields.members.find(field_name);
+                    if (it == fields.members.end()) {
+                        std::optional<shader_field_handle> member;
+                        shader_field_handle handle;
+                        if (reflection_data.resolve_field(fields.array.type, field_name, handle)) {
+                            member = handle;
+                        }
+                        it = fields.members.insert(std::make_pair(field_name, member)).first;
+                    }
+                    if (!it->second) {
                         if (optional) {
                             return;
                         } else {
@@ -130,8 +154,7 @@ namespace vkrollercoaster {
                                                      "\" does not exist!");
                         }
                     }
-                    size_t offset = type.find_offset(entry_prefix + field_name);
-                    buffer_instance->set_data(data, size, offset);
+                    buffer_instance->set_data(data, size, element_offset + it->second->offset);
                 };
 
                 // copy data
@@ -145,13 +168,13 @@ namespace vkrollercoaster {
                 // and directional lights
                 this->update_typed_light_data(set);
             }
+            buffer.buffer->set_data(count, fields.count.offset);
         }
     }
     void attenuation_settings::update(light::set_callback_t set) {
-        const std::string prefix = "attenuation.";
-        set(prefix + "_constant", &this->constant.value, sizeof(float), false);
-        set(prefix + "_linear", &this->linear.value, sizeof(float), false);
-        set(prefix + "_quadratic", &this->quadratic.value, sizeof(float), false);
+        set("attenuation._constant", &this->constant.value, sizeof(float), false);
+        set("attenuation._linear", &this->linear.value, sizeof(float), false);
+        set("attenuation._quadratic", &this->quadratic.value, sizeof(float), false);
     }
     point_light::point_light(const attenuation_settings& attenuation) {
         this->m_attenuation = attenuation;
@@ -18,7 +18,16 @@
 #include "material.h"
 #include "renderer.h"
 #include "light.h"
+#include "util.h"
 namespace vkrollercoaster {
+    size_t material::pipeline_cache_key::hash::operator()(const pipeline_cache_key& key) const {
+        size_t seed = pipeline_spec::hash()(key.spec);
+        util::hash_combine(seed, key.target);
+        util::hash_combine(seed, key.variant);
+        return seed;
+    }
+    static const std::string environment_texture_name = "prefiltered_cube";
+    static std::unordered_set<material*> material_registry;
     material::material(ref<shader> _shader) {
         this->m_shader = _shader;
         if (!this->m_shader) {
@@ -35,15 +44,14 @@ namespace vkrollercoaster {
         this->m_buffer =
             uniform_buffer::from_shader_data(this->m_shader, this->m_set, this->m_binding);
 
-        std::string shader_name;
         std::vector<std::string> shader_names;
         shader_library::get_names(shader_names);
         for (const auto& name : shader_names) {
             if (shader_library::get(name) == this->m_shader) {
-                shader_name = name;
+                this->m_shader_name = name;
             }
         }
-        if (shader_name.empty()) {
+        if (this->m_shader_name.empty()) {
             // the passed shader was not in the library - vkrollercoaster::light has not created a
             // buffer for it
             uint32_t set, binding;
@@ -52,7 +60,7 @@ namespace vkrollercoaster {
             }
             this->m_light_buffer = uniform_buffer::from_shader_data(this->m_shader, set, binding);
         } else {
-            this->m_light_buffer = light::get_buffer(shader_name);
+            this->m_light_buffer = light::get_buffer(this->m_shader_name);
             if (!this->m_light_buffer) {
                 throw std::runtime_error("the passed shader does not have a light buffer!");
             }
@@ -60,7 +68,8 @@ namespace vkrollercoaster {
 
         for (const auto& [set, resources] : reflection_data.resources) {
             for (const auto& [binding, resource] : resources) {
-                if (resource.resource_type == shader_resource_type::sampledimage) {
+                if (resource.resource_type == shader_resource_type::sampledimage &&
+                    resource.name != environment_texture_name) {
                     auto white_texture = renderer::get_white_texture();
                     const auto& type = reflection_data.types[resource.type];
                     this->m_textures[resource.name].resize(type.array_size);
@@ -70,26 +79,126 @@ namespace vkrollercoaster {
                 }
             }
         }
+        material_registry.insert(this);
     }
     material::~material() {
+        material_registry.erase(this);
+        for (const auto& target : this->m_cache_targets) {
+            target->remove_reload_callbacks(this);
+        }
+        this->m_pipeline_cache.clear();
+        this->m_invalidated_pipelines.clear();
         for (pipeline* _pipeline : this->m_created_pipelines) {
             _pipeline->m_material = nullptr;
         }
     }
-    ref<pipeline> material::create_pipeline(ref<render_target> target, const pipeline_spec& spec) {
-        auto _pipeline = ref<pipeline>::create(target, this->m_shader, spec);
+    ref<pipeline> material::create_pipeline(ref<render_target> target, const pipeline_spec& spec,
+                                            const std::string& variant) {
+        ref<shader> _shader = this->m_shader;
+        ref<uniform_buffer> light_buffer = this->m_light_buffer;
+        if (!variant.empty()) {
+            std::string variant_name = this->m_shader_name + "_" + variant;
+            _shader = shader_library::get(variant_name);
+            light_buffer = light::get_buffer(variant_name);
+            if (this->m_shader_name.empty() || !_shader || !light_buffer) {
+                throw std::runtime_error("shader variant " + variant_name + " does not exist!");
+            }
+        }
+        auto _pipeline = ref<pipeline>::create(target, _shader, spec);
         renderer::get_camera_buffer()->bind(_pipeline);
-        this->m_light_buffer->bind(_pipeline);
+        light_buffer->bind(_pipeline);
         this->m_buffer->bind(_pipeline);
         for (const auto& [resource_name, textures] : this->m_textures) {
             for (size_t slot = 0; slot < textures.size(); slot++) {
                 textures[slot]->bind(_pipeline, resource_name, slot);
             }
         }
+        this->bind_environment(_pipeline);
         _pipeline->m_material = this;
         this->m_created_pipelines.insert(_pipeline.raw());
         return _pipeline;
     }
+    ref<pipeline> material::get_pipeline(ref<render_target> target, const pipeline_spec& spec,
+                                         const std::string& variant) {
+        // pipelines invalidated by a render target reload may still have been referenced by the
+        // frame that triggered it, so they are only released on the next lookup
+        this->m_invalidated_pipelines.clear();
+
+        pipeline_cache_key key;
+        key.target = target.raw();
+        key.spec = spec;
+        key.variant = variant;
+        auto it = this->m_pipeline_cache.find(key);
+        if (it != this->m_pipeline_cache.end()) {
+            return it->second;
+        }
+        if (this->m_cache_targets.find(target) == this->m_cache_targets.end()) {
+            render_target* target_ptr = target.raw();
+            auto destroy = [this, target_ptr]() mutable { this->invalidate_pipelines(target_ptr); };
+            target->add_reload_callbacks(this, destroy, []() {});
+            this->m_cache_targets.insert(target);
+        }
+        auto _pipeline = this->create_pipeline(target, spec, variant);
+        this->m_pipeline_cache.insert({ key, _pipeline });
+        return _pipeline;
+    }
+    void material::invalidate_pipelines(render_target* target) {
+        // shader reloads rebuild dependent pipelines in place, but a render target reload can
+        // change state that pipelines size themselves by (e.g. the swapchain image count), so
+        // cached pipelines for the target are dropped and recreated on demand
+        for (auto it = this->m_pipeline_cache.begin(); it != this->m_pipeline_cache.end();) {
+            if (it->first.target == target) {
+                this->m_invalidated_pipelines.push_back(it->second);
+                it = this->m_pipeline_cache.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+    void material::bind_environment(ref<pipeline> _pipeline) {
+        auto& reflection_data = this->m_shader->get_reflection_data();
+        uint32_t set, binding;
+        if (!reflection_data.find_resource(environment_texture_name, set, binding)) {
+            return;
+        }
+        if (auto _skybox = renderer::get_skybox()) {
+            _skybox->get_prefiltered_cube()->bind(_pipeline, set, binding);
+        } else {
+            renderer::get_black_cube()->bind(_pipeline, set, binding);
+        }
+    }
+    void material::update_environment() {
+        // a reference to the last bound texture is held, so that a new skybox can't be mistaken
+        // for the old one
+        ref<texture> environment = renderer::get_black_cube();
+        if (auto _skybox = renderer::get_skybox()) {
+            environment = _skybox->get_prefiltered_cube();
+        }
+        if (environment == this->m_environment) {
+            return;
+        }
+        for (pipeline* _pipeline : this->m_created_pipelines) {
+            this->bind_environment(_pipeline);
+        }
+        this->m_environment = environment;
+    }
+    void material::update_environments() {
+        for (material* _material : material_registry) {
+            _material->update_environment();
+        }
+    }
+    const shader_field_handle& material::get_field(const std::string& name) {
+        auto& reflection_data = this->m_shader->get_reflection_data();
+        auto& field = this->m_fields[name];
+        if (!reflection_data.is_valid(field)) {
+            size_t type = reflection_data.resources[this->m_set][this->m_binding].type;
+            if (!reflection_data.resolve_field(type, name, field)) {
+                this->m_fields.erase(name);
+                throw std::runtime_error("could not find the specified field!");
+            }
+        }
+        return field;
+    }
     void material::set_texture(const std::string& name, ref<texture> tex, uint32_t slot) {
         if (this->m_textures.find(name) == this->m_textures.end()) {
             throw std::runtime_error("the specified texture resource does not exist!");
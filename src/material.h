@@ -26,41 +26,71 @@ namespace vkrollercoaster {
         material(ref<shader> _shader);
         material(const std::string& shader_name) : material(shader_library::get(shader_name)) {}
         ~material();
-        ref<pipeline> create_pipeline(ref<render_target> target, const pipeline_spec& spec);
+        // if a variant is passed, the pipeline uses the library shader named
+        // "<shader name>_<variant>" instead, e.g. to decode a different vertex format. variants
+        // must declare the same resources as the material's own shader
+        ref<pipeline> create_pipeline(ref<render_target> target, const pipeline_spec& spec,
+                                      const std::string& variant = std::string());
+        // returns a cached pipeline for the given render target and spec, creating one on a miss
+        ref<pipeline> get_pipeline(ref<render_target> target, const pipeline_spec& spec,
+                                   const std::string& variant = std::string());
         void set_name(const std::string& name) { this->m_name = name; }
         const std::string& get_name() { return this->m_name; }
+        // resolves a field of the material buffer once, and reuses it until the shader reloads
+        const shader_field_handle& get_field(const std::string& name);
         template <typename T> void set_data(const std::string& name, const T& data) {
-            auto& reflection_data = this->m_shader->get_reflection_data();
-            auto& resource = reflection_data.resources[this->m_set][this->m_binding];
-            const auto& resource_type = reflection_data.types[resource.type];
-            if (!resource_type.path_exists(name)) {
-                throw std::runtime_error("could not find the specified field!");
-            }
-            size_t offset = resource_type.find_offset(name);
-            this->m_buffer->set_data(data, offset);
+            this->set_data(this->get_field(name), data);
         }
         template <typename T> T get_data(const std::string& name) {
-            auto& reflection_data = this->m_shader->get_reflection_data();
-            const auto& resource = reflection_data.resources[this->m_set][this->m_binding];
-            const auto& resource_type = reflection_data.types[resource.type];
-            if (!resource_type.path_exists(name)) {
-                throw std::runtime_error("could not find the specified field!");
-            }
-            size_t offset = resource_type.find_offset(name);
+            return this->get_data<T>(this->get_field(name));
+        }
+        template <typename T> void set_data(const shader_field_handle& field, const T& data) {
+            this->m_buffer->set_data(data, field.offset);
+        }
+        template <typename T> T get_data(const shader_field_handle& field) {
             T data;
-            this->m_buffer->get_data(data, offset);
+            this->m_buffer->get_data(data, field.offset);
             return data;
         }
         void set_texture(const std::string& name, ref<texture> tex, uint32_t slot = 0);
         ref<texture> get_texture(const std::string& name, uint32_t slot = 0);
 
+        // rebinds the current skybox's textures to the pipelines of every material. this
+        // rewrites descriptor sets, so it must not be called while a frame is being recorded
+        static void update_environments();
+
     private:
+        struct pipeline_cache_key {
+            render_target* target;
+            pipeline_spec spec;
+            std::string variant;
+            bool operator==(const pipeline_cache_key& other) const {
+                return (this->target == other.target) && (this->spec == other.spec) &&
+                       (this->variant == other.variant);
+            }
+            struct hash {
+                size_t operator()(const pipeline_cache_key& key) const;
+            };
+        };
+        void invalidate_pipelines(render_target* target);
+        // binds the current skybox's image-based lighting textures, which are shared by every
+        // material rather than being set per material
+        void bind_environment(ref<pipeline> _pipeline);
+        void update_environment();
         ref<uniform_buffer> m_buffer, m_light_buffer;
         ref<shader> m_shader;
+        // empty if the shader is not in the library
+        std::string m_shader_name;
         std::string m_name;
         std::map<std::string, std::vector<ref<texture>>> m_textures;
+        std::unordered_map<std::string, shader_field_handle> m_fields;
         uint32_t m_set, m_binding;
         std::set<pipeline*> m_created_pipelines;
+        std::unordered_map<pipeline_cache_key, ref<pipeline>, pipeline_cache_key::hash>
+            m_pipeline_cache;
+        std::unordered_set<ref<render_target>> m_cache_targets;
+        std::vector<ref<pipeline>> m_invalidated_pipelines;
+        ref<texture> m_environment;
         friend class pipeline;
     };
 } // namespace vkrollercoaster
\ No newline at end of file
@@ -18,6 +18,7 @@
 #include "menus.h"
 #include "../application.h"
 #include "../components.h"
+#include "../asset_manager.h"
 #include "scene_serializer.h"
 #include "../imgui_extensions.h"
 namespace vkrollercoaster {
@@ -160,17 +161,39 @@ namespace vkrollercoaster {
 
             ref<model_source> source = _model->get_source();
             if (source) {
-                if (ImGui::Button("Reload")) {
-                    source->reload();
+                const auto& options = source->get_import_options();
+                switch (asset_manager::get_model_source_state(source->get_path(), options)) {
+                case asset_state::loading:
+                    ImGui::Text("Loading...");
+                    break;
+                case asset_state::failed:
+                    ImGui::TextColored(
+                        ImVec4(1.f, 0.f, 0.f, 1.f), "Could not import the model: %s",
+                        asset_manager::get_error(source->get_path(), options).c_str());
+                    break;
+                default:
+                    if (ImGui::Button("Reload")) {
+                        source->reload();
+                    }
+                    break;
                 }
             }
 
+            bool packed = _model->get_vertex_format() == vertex_format::packed;
+            if (ImGui::Checkbox("Packed vertices", &packed)) {
+                _model->set_vertex_format(packed ? vertex_format::packed : vertex_format::standard);
+            }
+
             if (ImGui::Button("Remove")) {
                 ent.remove_component<model_component>();
             }
             ImGui::Separator();
 
+            // there's nothing to edit until the model has loaded
             const auto& materials = _model->get_materials();
+            if (materials.empty()) {
+                return;
+            }
             static int32_t current_material = 0;
             if (current_material >= materials.size()) {
                 current_material = 0;
@@ -218,6 +241,11 @@ namespace vkrollercoaster {
             if (ImGui::SliderFloat("Shininess", &shininess, 0.f, 360.f)) {
                 model_material->set_data("shininess", shininess);
             }
+
+            float roughness = model_material->get_data<float>("roughness");
+            if (ImGui::SliderFloat("Roughness", &roughness, 0.f, 1.f)) {
+                model_material->set_data("roughness", roughness);
+            }
         } else {
             static fs::path model_path;
             ImGui::InputPath("Model path", &model_path);
@@ -239,8 +267,11 @@ namespace vkrollercoaster {
                 } else if (!fs::exists(model_path)) {
                     model_error = model_loading_error::file_does_not_exist;
                 } else {
-                    auto _model = ref<model>::create(ref<model_source>::create(model_path));
+                    // the model is drawn once it has loaded in the background
+                    auto source = asset_manager::load_model_source_async(model_path);
+                    auto _model = ref<model>::create(source);
                     ent.add_component<model_component>().data = _model;
+                    model_error = model_loading_error::none;
                     model_path.clear();
                 }
             }
@@ -336,6 +367,14 @@ namespace vkrollercoaster {
                 }
             }
 
+            // curve to the next track
+            ImGui::Checkbox("Automatic curve", &track_data.automatic_curve);
+            if (!track_data.automatic_curve) {
+                constexpr float speed = 0.05f;
+                ImGui::DragFloat3("Start control point", &track_data.control_points[0].x, speed);
+                ImGui::DragFloat3("End control point", &track_data.control_points[1].x, speed);
+            }
+
             if (ImGui::Button("Remove")) {
                 ent.remove_component<track_segment_component>();
             }
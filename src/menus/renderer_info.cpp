@@ -23,12 +23,13 @@ namespace vkrollercoaster {
         ImGui::Begin("Renderer info", &this->m_open);
         ImGuiIO& io = ImGui::GetIO();
         ImGui::Text("FPS: %f", io.Framerate);
+        const auto& stats = renderer::get_render_stats();
+        ImGui::Text("Instances submitted: %u", stats.submitted_instances);
+        ImGui::Text("Instances culled: %u", stats.culled_instances);
+        ImGui::Text("Draw calls: %u", stats.draw_calls);
+        ImGui::Text("Triangles: %u", stats.triangles);
         if (ImGui::Button("Reload shaders")) {
-            std::vector<std::string> names;
-            shader_library::get_names(names);
-            for (const auto& name : names) {
-                shader_library::get(name)->reload();
-            }
+            shader_library::reload_all();
         }
         if (ImGui::CollapsingHeader("Device info")) {
             VkPhysicalDevice physical_device = renderer::get_physical_device();
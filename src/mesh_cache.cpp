@@ -0,0 +1,352 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "pch.h"
+#include "mesh_cache.h"
+#include "util.h"
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+namespace vkrollercoaster {
+    struct mesh_cache_header {
+        uint32_t magic, version;
+        uint64_t key;
+        uint64_t vertex_size;
+    };
+    static constexpr uint32_t mesh_cache_magic = 0x434d4b56; // "VKMC"
+    // bump whenever the layout of an entry changes
+    static constexpr uint32_t mesh_cache_version = 2;
+
+    // a mesh as it is stored in an entry. the assimp pointers are not stored
+    struct cached_mesh {
+        uint64_t vertex_offset, vertex_count, index_offset, index_count, material_index;
+        bounding_volume bounds;
+    };
+    // a simplified level of detail of the mesh at mesh_index
+    struct cached_lod {
+        uint64_t mesh_index, index_offset, index_count;
+    };
+
+    // a read-only view of a whole file. on linux the file is mapped, so that only the pages that
+    // are actually read are loaded. elsewhere, it is read into memory
+    class mapped_file {
+    public:
+        mapped_file(const fs::path& path) {
+#ifdef __linux__
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            struct stat file_stat;
+            if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+                void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED) {
+                    this->m_data = (const uint8_t*)data;
+                    this->m_size = file_stat.st_size;
+                }
+            }
+            close(fd);
+#else
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open()) {
+                return;
+            }
+            this->m_contents.assign(std::istreambuf_iterator<char>(file),
+                                    std::istreambuf_iterator<char>());
+            this->m_data = (const uint8_t*)this->m_contents.data();
+            this->m_size = this->m_contents.size();
+#endif
+        }
+        ~mapped_file() {
+#ifdef __linux__
+            if (this->m_data) {
+                munmap((void*)this->m_data, this->m_size);
+            }
+#endif
+        }
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        const uint8_t* data() const { return this->m_data; }
+        size_t size() const { return this->m_size; }
+
+    private:
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+#ifndef __linux__
+        std::vector<char> m_contents;
+#endif
+    };
+
+    // reads values out of a mapped entry. reading past the end marks the reader as bad, rather
+    // than reading out of bounds
+    class entry_reader {
+    public:
+        entry_reader(const mapped_file& file) : m_file(file) {}
+        template <typename T> T read() {
+            static_assert(std::is_trivially_copyable_v<T>, "must pass a trivially copyable type!");
+            T value;
+            this->read_array(&value, 1);
+            return value;
+        }
+        template <typename T> void read_array(T* values, size_t count) {
+            static_assert(std::is_trivially_copyable_v<T>, "must pass a trivially copyable type!");
+            size_t size = count * sizeof(T);
+            if (!this->m_good || this->m_file.size() - this->m_offset < size) {
+                this->m_good = false;
+                return;
+            }
+            memcpy(values, this->m_file.data() + this->m_offset, size);
+            this->m_offset += size;
+        }
+        template <typename T> void read_vector(std::vector<T>& values) {
+            auto count = this->read<uint64_t>();
+            if (!this->m_good || count > this->m_file.size() / sizeof(T)) {
+                this->m_good = false;
+                return;
+            }
+            values.resize(count);
+            this->read_array(values.data(), count);
+        }
+        std::string read_string() {
+            std::vector<char> characters;
+            this->read_vector(characters);
+            return std::string(characters.begin(), characters.end());
+        }
+        bool good() { return this->m_good; }
+
+    private:
+        const mapped_file& m_file;
+        size_t m_offset = 0;
+        bool m_good = true;
+    };
+
+    class entry_writer {
+    public:
+        entry_writer(std::ofstream& stream) : m_stream(stream) {}
+        template <typename T> void write(const T& value) { this->write_array(&value, 1); }
+        template <typename T> void write_array(const T* values, size_t count) {
+            static_assert(std::is_trivially_copyable_v<T>, "must pass a trivially copyable type!");
+            this->m_stream.write((const char*)values, count * sizeof(T));
+        }
+        template <typename T> void write_vector(const std::vector<T>& values) {
+            this->write<uint64_t>(values.size());
+            this->write_array(values.data(), values.size());
+        }
+        void write(const std::string& value) {
+            this->write<uint64_t>(value.length());
+            this->write_array(value.data(), value.length());
+        }
+
+    private:
+        std::ofstream& m_stream;
+    };
+
+    static fs::path get_entry_path(const std::string& name, uint64_t key) {
+        fs::path directory = util::get_cache_directory() / "meshes";
+        if (!fs::exists(directory)) {
+            fs::create_directories(directory);
+        }
+        std::stringstream filename;
+        filename << name << "_" << std::hex << key << ".bin";
+        return directory / filename.str();
+    }
+
+    bool mesh_cache::read(const std::string& name, uint64_t key, std::vector<vertex>& vertices,
+                          std::vector<uint32_t>& indices,
+                          std::vector<model_source::mesh>& meshes,
+                          std::vector<material_description>& materials,
+                          bounding_volume& bounds) {
+        fs::path path = get_entry_path(name, key);
+        if (!fs::exists(path)) {
+            return false;
+        }
+        mapped_file file(path);
+        entry_reader reader(file);
+        auto header = reader.read<mesh_cache_header>();
+        if (!reader.good() || header.magic != mesh_cache_magic ||
+            header.version != mesh_cache_version || header.key != key ||
+            header.vertex_size != sizeof(vertex)) {
+            spdlog::warn("mesh cache entry {0} is stale or corrupt - discarding", path.string());
+            return false;
+        }
+
+        // make sure none of the files read while importing have changed
+        auto dependency_count = reader.read<uint64_t>();
+        for (uint64_t i = 0; i < dependency_count && reader.good(); i++) {
+            std::string dependency_path = reader.read_string();
+            auto hash = reader.read<uint64_t>();
+            if (!reader.good()) {
+                break;
+            }
+            if (!fs::exists(dependency_path) || util::hash_file(dependency_path) != hash) {
+                return false;
+            }
+        }
+
+        // vertex and index data are copied out of the mapping in one go
+        reader.read_vector(vertices);
+        reader.read_vector(indices);
+
+        std::vector<cached_mesh> cached_meshes;
+        reader.read_vector(cached_meshes);
+        for (const auto& cached : cached_meshes) {
+            model_source::mesh& _mesh = meshes.emplace_back();
+            _mesh.vertex_offset = cached.vertex_offset;
+            _mesh.vertex_count = cached.vertex_count;
+            _mesh.index_offset = cached.index_offset;
+            _mesh.index_count = cached.index_count;
+            _mesh.material_index = cached.material_index;
+            _mesh.bounds = cached.bounds;
+            _mesh.node = nullptr;
+            _mesh.assimp_mesh = nullptr;
+        }
+        std::vector<cached_lod> cached_lods;
+        reader.read_vector(cached_lods);
+        for (const auto& cached : cached_lods) {
+            if (cached.mesh_index >= meshes.size() ||
+                cached.index_offset + cached.index_count > indices.size()) {
+                spdlog::warn("mesh cache entry {0} is corrupt - discarding", path.string());
+                return false;
+            }
+            meshes[cached.mesh_index].lods.push_back({ cached.index_offset, cached.index_count });
+        }
+
+        auto material_count = reader.read<uint64_t>();
+        for (uint64_t i = 0; i < material_count && reader.good(); i++) {
+            material_description& desc = materials.emplace_back();
+            desc.name = reader.read_string();
+            desc.albedo_texture = reader.read_string();
+            desc.specular_texture = reader.read_string();
+            desc.normal_map = reader.read_string();
+            desc.albedo_color = reader.read<glm::vec3>();
+            desc.specular_color = reader.read<glm::vec3>();
+            desc.opacity = reader.read<float>();
+            desc.shininess = reader.read<float>();
+            desc.roughness = reader.read<float>();
+        }
+        bounds = reader.read<bounding_volume>();
+
+        if (!reader.good()) {
+            spdlog::warn("mesh cache entry {0} is truncated - discarding", path.string());
+            return false;
+        }
+
+        // an entry that references data outside of itself would crash the renderer
+        for (const auto& _mesh : meshes) {
+            if (_mesh.index_offset + _mesh.index_count > indices.size() ||
+                _mesh.material_index >= materials.size()) {
+                spdlog::warn("mesh cache entry {0} is corrupt - discarding", path.string());
+                return false;
+            }
+        }
+        for (uint32_t index : indices) {
+            if (index >= vertices.size()) {
+                spdlog::warn("mesh cache entry {0} is corrupt - discarding", path.string());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void mesh_cache::write(const std::string& name, uint64_t key,
+                           const std::set<std::string>& dependencies,
+                           const std::vector<vertex>& vertices,
+                           const std::vector<uint32_t>& indices,
+                           const std::vector<model_source::mesh>& meshes,
+                           const std::vector<material_description>& materials,
+                           const bounding_volume& bounds) {
+        fs::path path = get_entry_path(name, key);
+        fs::path temporary_path = path;
+        temporary_path += ".tmp";
+        {
+            std::ofstream file(temporary_path, std::ios::binary);
+            if (!file.is_open()) {
+                spdlog::warn("could not write mesh cache entry {0}", path.string());
+                return;
+            }
+            entry_writer writer(file);
+
+            mesh_cache_header header;
+            header.magic = mesh_cache_magic;
+            header.version = mesh_cache_version;
+            header.key = key;
+            header.vertex_size = sizeof(vertex);
+            writer.write(header);
+
+            writer.write<uint64_t>(dependencies.size());
+            for (const auto& dependency_path : dependencies) {
+                writer.write(dependency_path);
+                writer.write(util::hash_file(dependency_path));
+            }
+
+            writer.write_vector(vertices);
+            writer.write_vector(indices);
+
+            std::vector<cached_mesh> cached_meshes;
+            for (const auto& _mesh : meshes) {
+                cached_mesh& cached = cached_meshes.emplace_back();
+                cached.vertex_offset = _mesh.vertex_offset;
+                cached.vertex_count = _mesh.vertex_count;
+                cached.index_offset = _mesh.index_offset;
+                cached.index_count = _mesh.index_count;
+                cached.material_index = _mesh.material_index;
+                cached.bounds = _mesh.bounds;
+            }
+            writer.write_vector(cached_meshes);
+
+            std::vector<cached_lod> cached_lods;
+            for (size_t i = 0; i < meshes.size(); i++) {
+                for (const auto& lod : meshes[i].lods) {
+                    cached_lods.push_back({ i, lod.offset, lod.count });
+                }
+            }
+            writer.write_vector(cached_lods);
+
+            writer.write<uint64_t>(materials.size());
+            for (const auto& desc : materials) {
+                writer.write(desc.name);
+                writer.write(desc.albedo_texture.string());
+                writer.write(desc.specular_texture.string());
+                writer.write(desc.normal_map.string());
+                writer.write(desc.albedo_color);
+                writer.write(desc.specular_color);
+                writer.write(desc.opacity);
+                writer.write(desc.shininess);
+                writer.write(desc.roughness);
+            }
+            writer.write(bounds);
+
+            file.flush();
+            if (!file) {
+                spdlog::warn("could not write mesh cache entry {0}", path.string());
+                return;
+            }
+        }
+
+        // entries are written to a temporary file first, so that a reader never sees a
+        // partially written entry
+        std::error_code error;
+        fs::rename(temporary_path, path, error);
+        if (error) {
+            spdlog::warn("could not write mesh cache entry {0}", path.string());
+            fs::remove(temporary_path, error);
+        }
+    }
+} // namespace vkrollercoaster
\ No newline at end of file
@@ -0,0 +1,38 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#pragma once
+#include "model.h"
+namespace vkrollercoaster {
+    // on-disk cache of imported models, stored in a flat binary format that is memory-mapped
+    // when read, so that unchanged models never go through assimp. entries record every file
+    // that was read while importing, and are only used while each of them is unchanged
+    class mesh_cache {
+    public:
+        mesh_cache() = delete;
+
+        static bool read(const std::string& name, uint64_t key, std::vector<vertex>& vertices,
+                         std::vector<uint32_t>& indices, std::vector<model_source::mesh>& meshes,
+                         std::vector<material_description>& materials, bounding_volume& bounds);
+        static void write(const std::string& name, uint64_t key,
+                          const std::set<std::string>& dependencies,
+                          const std::vector<vertex>& vertices,
+                          const std::vector<uint32_t>& indices,
+                          const std::vector<model_source::mesh>& meshes,
+                          const std::vector<material_description>& materials,
+                          const bounding_volume& bounds);
+    };
+} // namespace vkrollercoaster
\ No newline at end of file
@@ -0,0 +1,571 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "pch.h"
+#include "mesh_optimizer.h"
+namespace vkrollercoaster {
+    vertex_cache_statistics mesh_optimizer::analyze_vertex_cache(
+        const std::vector<uint32_t>& indices, size_t vertex_count, size_t cache_size) {
+        vertex_cache_statistics statistics;
+        statistics.triangle_count = indices.size() / 3;
+
+        // a vertex is in the cache if it was added within the last cache_size insertions
+        std::vector<size_t> insertion_times(vertex_count, 0);
+        std::vector<bool> referenced(vertex_count, false);
+        size_t time = cache_size + 1;
+        for (uint32_t index : indices) {
+            if (time - insertion_times[index] > cache_size) {
+                insertion_times[index] = time++;
+                statistics.misses++;
+            }
+            if (!referenced[index]) {
+                referenced[index] = true;
+                statistics.vertex_count++;
+            }
+        }
+
+        if (statistics.triangle_count > 0) {
+            statistics.acmr = (float)statistics.misses / statistics.triangle_count;
+        }
+        if (statistics.vertex_count > 0) {
+            statistics.atvr = (float)statistics.misses / statistics.vertex_count;
+        }
+        return statistics;
+    }
+
+    // https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+    static constexpr size_t forsyth_cache_size = 32;
+    static float get_vertex_score(int32_t cache_position, uint32_t remaining_triangles) {
+        if (remaining_triangles == 0) {
+            return -1.f;
+        }
+        float score = 0.f;
+        if (cache_position >= 0) {
+            if (cache_position < 3) {
+                // the last triangle's vertices get a fixed score, so that strips aren't favored
+                score = 0.75f;
+            } else {
+                float scale = 1.f / (forsyth_cache_size - 3);
+                score = glm::pow(1.f - (cache_position - 3) * scale, 1.5f);
+            }
+        }
+
+        // favor vertices with few triangles left, so that no lone triangles are left behind
+        score += 2.f * glm::pow((float)remaining_triangles, -0.5f);
+        return score;
+    }
+
+    void mesh_optimizer::optimize_vertex_cache(std::vector<uint32_t>& indices,
+                                               size_t vertex_count) {
+        size_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0) {
+            return;
+        }
+
+        // triangles adjacent to each vertex, packed into one array
+        std::vector<uint32_t> remaining(vertex_count, 0);
+        for (uint32_t index : indices) {
+            remaining[index]++;
+        }
+        std::vector<size_t> adjacency_offsets(vertex_count + 1, 0);
+        for (size_t i = 0; i < vertex_count; i++) {
+            adjacency_offsets[i + 1] = adjacency_offsets[i] + remaining[i];
+        }
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<size_t> adjacency_counts(vertex_count, 0);
+        for (size_t i = 0; i < indices.size(); i++) {
+            uint32_t index = indices[i];
+            adjacency[adjacency_offsets[index] + adjacency_counts[index]++] = (uint32_t)(i / 3);
+        }
+
+        std::vector<int32_t> cache_positions(vertex_count, -1);
+        std::vector<float> vertex_scores(vertex_count);
+        for (size_t i = 0; i < vertex_count; i++) {
+            vertex_scores[i] = get_vertex_score(-1, remaining[i]);
+        }
+        std::vector<float> triangle_scores(triangle_count);
+        std::vector<bool> emitted(triangle_count, false);
+        for (size_t i = 0; i < triangle_count; i++) {
+            triangle_scores[i] = vertex_scores[indices[i * 3]] +
+                                 vertex_scores[indices[i * 3 + 1]] +
+                                 vertex_scores[indices[i * 3 + 2]];
+        }
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        std::vector<uint32_t> cache, next_cache;
+        size_t best_triangle = 0;
+        for (size_t i = 1; i < triangle_count; i++) {
+            if (triangle_scores[i] > triangle_scores[best_triangle]) {
+                best_triangle = i;
+            }
+        }
+        size_t scan_start = 0;
+        while (true) {
+            emitted[best_triangle] = true;
+            const uint32_t* triangle = &indices[best_triangle * 3];
+            result.insert(result.end(), triangle, triangle + 3);
+
+            // the emitted triangle's vertices move to the front of the cache
+            next_cache.assign(triangle, triangle + 3);
+            for (uint32_t index : cache) {
+                if (index != triangle[0] && index != triangle[1] && index != triangle[2]) {
+                    next_cache.push_back(index);
+                }
+            }
+            for (size_t i = 0; i < 3; i++) {
+                uint32_t index = triangle[i];
+                remaining[index]--;
+
+                // move the triangle to the end of the vertex's live adjacency
+                size_t begin = adjacency_offsets[index];
+                size_t end = begin + remaining[index] + 1;
+                auto it = std::find(adjacency.begin() + begin, adjacency.begin() + end,
+                                    (uint32_t)best_triangle);
+                std::iter_swap(it, adjacency.begin() + end - 1);
+            }
+
+            // rescore every vertex whose cache position changed, and their triangles
+            for (size_t i = 0; i < next_cache.size(); i++) {
+                uint32_t index = next_cache[i];
+                cache_positions[index] = i < forsyth_cache_size ? (int32_t)i : -1;
+                float score = get_vertex_score(cache_positions[index], remaining[index]);
+                float delta = score - vertex_scores[index];
+                vertex_scores[index] = score;
+                size_t begin = adjacency_offsets[index];
+                for (size_t j = begin; j < begin + remaining[index]; j++) {
+                    triangle_scores[adjacency[j]] += delta;
+                }
+            }
+            if (next_cache.size() > forsyth_cache_size) {
+                next_cache.resize(forsyth_cache_size);
+            }
+            std::swap(cache, next_cache);
+
+            // the next triangle is the best one touching the cache
+            float best_score = -std::numeric_limits<float>::max();
+            bool found = false;
+            for (uint32_t index : cache) {
+                size_t begin = adjacency_offsets[index];
+                for (size_t j = begin; j < begin + remaining[index]; j++) {
+                    uint32_t candidate = adjacency[j];
+                    if (triangle_scores[candidate] > best_score) {
+                        best_score = triangle_scores[candidate];
+                        best_triangle = candidate;
+                        found = true;
+                    }
+                }
+            }
+            if (!found) {
+                // dead end - continue with the first triangle that hasn't been emitted
+                while (scan_start < triangle_count && emitted[scan_start]) {
+                    scan_start++;
+                }
+                if (scan_start == triangle_count) {
+                    break;
+                }
+                best_triangle = scan_start;
+            }
+        }
+        indices = std::move(result);
+    }
+
+    void mesh_optimizer::optimize_overdraw(std::vector<uint32_t>& indices,
+                                           const std::vector<vertex>& vertices) {
+        size_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0) {
+            return;
+        }
+
+        // a cluster starts wherever a triangle misses the cache on every vertex, as reordering
+        // at those points costs nothing
+        static constexpr size_t cache_size = 16;
+        std::vector<size_t> insertion_times(vertices.size(), 0);
+        size_t time = cache_size + 1;
+        std::vector<size_t> cluster_starts;
+        for (size_t i = 0; i < triangle_count; i++) {
+            size_t misses = 0;
+            for (size_t j = 0; j < 3; j++) {
+                uint32_t index = indices[i * 3 + j];
+                if (time - insertion_times[index] > cache_size) {
+                    insertion_times[index] = time++;
+                    misses++;
+                }
+            }
+            if (i == 0 || misses == 3) {
+                cluster_starts.push_back(i);
+            }
+        }
+        if (cluster_starts.size() < 2) {
+            return;
+        }
+
+        // area-weighted centroid of the whole mesh
+        glm::vec3 mesh_centroid = glm::vec3(0.f);
+        float mesh_area = 0.f;
+        std::vector<glm::vec3> centroids(triangle_count), normals(triangle_count);
+        std::vector<float> areas(triangle_count);
+        for (size_t i = 0; i < triangle_count; i++) {
+            const glm::vec3& a = vertices[indices[i * 3]].position;
+            const glm::vec3& b = vertices[indices[i * 3 + 1]].position;
+            const glm::vec3& c = vertices[indices[i * 3 + 2]].position;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            areas[i] = glm::length(normal) / 2.f;
+            normals[i] = normal;
+            centroids[i] = (a + b + c) / 3.f;
+            mesh_centroid += centroids[i] * areas[i];
+            mesh_area += areas[i];
+        }
+        if (mesh_area > 0.f) {
+            mesh_centroid /= mesh_area;
+        }
+
+        // clusters whose surface points away from the center of the mesh are most likely to
+        // be in front of the rest of it
+        struct cluster {
+            size_t first_triangle, triangle_count;
+            float sort_key;
+        };
+        std::vector<cluster> clusters;
+        for (size_t i = 0; i < cluster_starts.size(); i++) {
+            cluster& current = clusters.emplace_back();
+            current.first_triangle = cluster_starts[i];
+            size_t end = i + 1 < cluster_starts.size() ? cluster_starts[i + 1] : triangle_count;
+            current.triangle_count = end - current.first_triangle;
+
+            glm::vec3 centroid = glm::vec3(0.f), normal = glm::vec3(0.f);
+            float area = 0.f;
+            for (size_t j = current.first_triangle; j < end; j++) {
+                centroid += centroids[j] * areas[j];
+                normal += normals[j];
+                area += areas[j];
+            }
+            current.sort_key = 0.f;
+            if (area > 0.f && glm::length(normal) > 0.f) {
+                centroid /= area;
+                current.sort_key = glm::dot(centroid - mesh_centroid, glm::normalize(normal));
+            }
+        }
+        std::stable_sort(clusters.begin(), clusters.end(), [](const cluster& a, const cluster& b) {
+            return a.sort_key > b.sort_key;
+        });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (const auto& current : clusters) {
+            auto begin = indices.begin() + current.first_triangle * 3;
+            result.insert(result.end(), begin, begin + current.triangle_count * 3);
+        }
+        indices = std::move(result);
+    }
+
+    void mesh_optimizer::optimize_vertex_fetch(std::vector<vertex>& vertices,
+                                               std::vector<uint32_t>& indices) {
+        static constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> remap(vertices.size(), unused);
+        std::vector<vertex> result;
+        result.reserve(vertices.size());
+        for (uint32_t& index : indices) {
+            if (remap[index] == unused) {
+                remap[index] = (uint32_t)result.size();
+                result.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        for (size_t i = 0; i < vertices.size(); i++) {
+            if (remap[i] == unused) {
+                result.push_back(vertices[i]);
+            }
+        }
+        vertices = std::move(result);
+    }
+    // sum of squared distances to a set of planes, weighted by triangle area. stored as the
+    // upper half of a symmetric 4x4 matrix
+    struct quadric {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+        double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+        double a22 = 0.0, a23 = 0.0;
+        double a33 = 0.0;
+        double weight = 0.0;
+
+        static quadric from_plane(const glm::dvec3& normal, double distance, double weight) {
+            quadric q;
+            q.a00 = normal.x * normal.x * weight;
+            q.a01 = normal.x * normal.y * weight;
+            q.a02 = normal.x * normal.z * weight;
+            q.a03 = normal.x * distance * weight;
+            q.a11 = normal.y * normal.y * weight;
+            q.a12 = normal.y * normal.z * weight;
+            q.a13 = normal.y * distance * weight;
+            q.a22 = normal.z * normal.z * weight;
+            q.a23 = normal.z * distance * weight;
+            q.a33 = distance * distance * weight;
+            q.weight = weight;
+            return q;
+        }
+        quadric& operator+=(const quadric& other) {
+            this->a00 += other.a00;
+            this->a01 += other.a01;
+            this->a02 += other.a02;
+            this->a03 += other.a03;
+            this->a11 += other.a11;
+            this->a12 += other.a12;
+            this->a13 += other.a13;
+            this->a22 += other.a22;
+            this->a23 += other.a23;
+            this->a33 += other.a33;
+            this->weight += other.weight;
+            return *this;
+        }
+        // mean squared distance of the point to the planes
+        double evaluate(const glm::dvec3& p) const {
+            if (this->weight <= 0.0) {
+                return 0.0;
+            }
+            double error = this->a00 * p.x * p.x + this->a11 * p.y * p.y +
+                           this->a22 * p.z * p.z + this->a33 +
+                           2.0 * (this->a01 * p.x * p.y + this->a02 * p.x * p.z +
+                                  this->a12 * p.y * p.z + this->a03 * p.x + this->a13 * p.y +
+                                  this->a23 * p.z);
+            return std::max(error, 0.0) / this->weight;
+        }
+    };
+
+    std::vector<uint32_t> mesh_optimizer::simplify(const std::vector<uint32_t>& indices,
+                                                   const std::vector<vertex>& vertices,
+                                                   size_t target_index_count,
+                                                   float target_error, float* result_error) {
+        std::vector<uint32_t> result = indices;
+        if (result_error) {
+            *result_error = 0.f;
+        }
+        auto bounds = bounding_volume::from_vertices(vertices, indices.data(), indices.size());
+        if (bounds.empty() || bounds.radius <= 0.f) {
+            return result;
+        }
+
+        // vertices that share a position are copies along a seam, with different normals or
+        // uvs. the mesh is simplified as if they were welded: every copy of a position moves
+        // with it, so that seams stay closed. only positions on border edges are locked
+        std::vector<uint32_t> position_ids(vertices.size());
+        std::vector<std::vector<uint32_t>> copies(vertices.size());
+        std::map<std::array<float, 3>, uint32_t> positions;
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const glm::vec3& position = vertices[i].position;
+            auto it = positions.insert({ { position.x, position.y, position.z }, (uint32_t)i });
+            position_ids[i] = it.first->second;
+            copies[position_ids[i]].push_back((uint32_t)i);
+        }
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> edge_counts;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (size_t j = 0; j < 3; j++) {
+                uint32_t a = position_ids[indices[i + j]];
+                uint32_t b = position_ids[indices[i + (j + 1) % 3]];
+                edge_counts[{ std::min(a, b), std::max(a, b) }]++;
+            }
+        }
+        std::vector<bool> locked(vertices.size(), false);
+        for (const auto& [edge, count] : edge_counts) {
+            if (count == 1) {
+                locked[edge.first] = locked[edge.second] = true;
+            }
+        }
+
+        // quadrics, adjacency and collapses are all per position
+        std::vector<quadric> quadrics(vertices.size());
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            glm::dvec3 a = vertices[indices[i]].position;
+            glm::dvec3 b = vertices[indices[i + 1]].position;
+            glm::dvec3 c = vertices[indices[i + 2]].position;
+            glm::dvec3 normal = glm::cross(b - a, c - a);
+            double area = glm::length(normal);
+            if (area <= 0.0) {
+                continue;
+            }
+            normal /= area;
+            auto plane = quadric::from_plane(normal, -glm::dot(normal, a), area);
+            for (size_t j = 0; j < 3; j++) {
+                quadrics[position_ids[indices[i + j]]] += plane;
+            }
+        }
+
+        // the copy of a position that a copy of another position collapses into. a copy that
+        // shares a triangle with a copy of the destination joins it, so that the triangles on
+        // either side of a seam keep their own attributes. other copies join the copy with the
+        // closest attributes
+        auto find_target = [&](uint32_t from, uint32_t to, const uint32_t* triangles,
+                               size_t triangle_count, const std::vector<uint32_t>& mesh) {
+            for (size_t i = 0; i < triangle_count; i++) {
+                const uint32_t* triangle = &mesh[triangles[i] * 3];
+                if (triangle[0] != from && triangle[1] != from && triangle[2] != from) {
+                    continue;
+                }
+                for (size_t k = 0; k < 3; k++) {
+                    if (position_ids[triangle[k]] == position_ids[to]) {
+                        return triangle[k];
+                    }
+                }
+            }
+            uint32_t closest = to;
+            float closest_distance = std::numeric_limits<float>::max();
+            for (uint32_t copy : copies[position_ids[to]]) {
+                float distance = glm::length(vertices[copy].normal - vertices[from].normal) +
+                                 glm::length(vertices[copy].uv - vertices[from].uv);
+                if (distance < closest_distance) {
+                    closest = copy;
+                    closest_distance = distance;
+                }
+            }
+            return closest;
+        };
+
+        // collapse the cheapest edges in passes, without touching any triangle twice per pass.
+        // errors are compared squared, relative to the bounding sphere
+        double max_error = (double)target_error * bounds.radius;
+        max_error *= max_error;
+        double worst_error = 0.0;
+        struct collapse {
+            uint32_t from, to;
+            double error;
+        };
+        std::vector<collapse> collapses;
+        std::vector<uint32_t> remap(vertices.size());
+        std::vector<bool> touched(vertices.size());
+        std::vector<size_t> adjacency_offsets(vertices.size() + 1);
+        std::vector<uint32_t> adjacency;
+        while (result.size() > target_index_count) {
+            size_t triangle_count = result.size() / 3;
+            size_t target_triangle_count = target_index_count / 3;
+
+            std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+            for (uint32_t index : result) {
+                adjacency_offsets[position_ids[index] + 1]++;
+            }
+            for (size_t i = 0; i < vertices.size(); i++) {
+                adjacency_offsets[i + 1] += adjacency_offsets[i];
+            }
+            adjacency.resize(result.size());
+            std::vector<size_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++) {
+                adjacency[fill[position_ids[result[i]]]++] = (uint32_t)(i / 3);
+            }
+
+            collapses.clear();
+            for (size_t i = 0; i < result.size(); i += 3) {
+                for (size_t j = 0; j < 3; j++) {
+                    uint32_t a = position_ids[result[i + j]];
+                    uint32_t b = position_ids[result[i + (j + 1) % 3]];
+                    for (auto [from, to] : { std::make_pair(a, b), std::make_pair(b, a) }) {
+                        if (locked[from]) {
+                            continue;
+                        }
+                        quadric combined = quadrics[from];
+                        combined += quadrics[to];
+                        double error = combined.evaluate(vertices[to].position);
+                        if (error <= max_error) {
+                            collapses.push_back({ from, to, error });
+                        }
+                    }
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(),
+                      [](const collapse& a, const collapse& b) { return a.error < b.error; });
+
+            for (size_t i = 0; i < vertices.size(); i++) {
+                remap[i] = (uint32_t)i;
+            }
+            std::fill(touched.begin(), touched.end(), false);
+            size_t removed = 0;
+            for (const auto& current : collapses) {
+                if (triangle_count - removed <= target_triangle_count) {
+                    break;
+                }
+                if (touched[current.from] || touched[current.to]) {
+                    continue;
+                }
+
+                // reject collapses that would flip a triangle over
+                const glm::vec3& destination = vertices[current.to].position;
+                const uint32_t* triangles = &adjacency[adjacency_offsets[current.from]];
+                size_t adjacent_count =
+                    adjacency_offsets[current.from + 1] - adjacency_offsets[current.from];
+                bool flips = false;
+                size_t collapsed_triangles = 0;
+                for (size_t j = 0; j < adjacent_count && !flips; j++) {
+                    const uint32_t* triangle = &result[triangles[j] * 3];
+                    uint32_t corner_positions[3];
+                    for (size_t k = 0; k < 3; k++) {
+                        corner_positions[k] = position_ids[triangle[k]];
+                    }
+                    if (corner_positions[0] == current.to || corner_positions[1] == current.to ||
+                        corner_positions[2] == current.to) {
+                        collapsed_triangles++;
+                        continue;
+                    }
+                    glm::vec3 corners[3], moved[3];
+                    for (size_t k = 0; k < 3; k++) {
+                        corners[k] = vertices[triangle[k]].position;
+                        moved[k] = corner_positions[k] == current.from ? destination : corners[k];
+                    }
+                    glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                    glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                    flips = glm::dot(before, after) <= 0.f;
+                }
+                if (flips) {
+                    continue;
+                }
+
+                for (uint32_t copy : copies[current.from]) {
+                    remap[copy] = find_target(copy, current.to, triangles, adjacent_count, result);
+                }
+                quadrics[current.to] += quadrics[current.from];
+                for (size_t j = 0; j < adjacent_count; j++) {
+                    const uint32_t* triangle = &result[triangles[j] * 3];
+                    for (size_t k = 0; k < 3; k++) {
+                        touched[position_ids[triangle[k]]] = true;
+                    }
+                }
+                removed += collapsed_triangles;
+                worst_error = std::max(worst_error, current.error);
+            }
+            if (removed == 0) {
+                break;
+            }
+
+            // drop the triangles that collapsed into lines. copies of the same position may
+            // still differ by index, so this compares positions
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+                uint32_t position_a = position_ids[a], position_b = position_ids[b],
+                         position_c = position_ids[c];
+                if (position_a == position_b || position_b == position_c ||
+                    position_c == position_a) {
+                    continue;
+                }
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+            result.resize(write);
+        }
+
+        if (result_error) {
+            *result_error = (float)(glm::sqrt(worst_error) / bounds.radius);
+        }
+        return result;
+    }
+} // namespace vkrollercoaster
\ No newline at end of file
@@ -0,0 +1,60 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#pragma once
+#include "model.h"
+namespace vkrollercoaster {
+    struct vertex_cache_statistics {
+        // average cache misses per triangle. 0.5 is ideal for a regular grid, and 3 is the worst
+        float acmr = 0.f;
+        // cache misses per referenced vertex. 1 means every vertex is transformed exactly once
+        float atvr = 0.f;
+        size_t triangle_count = 0, vertex_count = 0, misses = 0;
+    };
+    // reorders the triangles and vertices of a single mesh for the gpu. indices are relative to
+    // the start of the passed vertices, and are rewritten in place
+    class mesh_optimizer {
+    public:
+        mesh_optimizer() = delete;
+
+        // simulates a fifo post-transform cache of the given size
+        static vertex_cache_statistics analyze_vertex_cache(const std::vector<uint32_t>& indices,
+                                                            size_t vertex_count,
+                                                            size_t cache_size = 16);
+        // reorders triangles so that vertices are reused while they are still in the
+        // post-transform cache, using tom forsyth's linear-speed algorithm
+        static void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count);
+        // splits the triangle order into clusters wherever the cache starts over, and draws
+        // clusters facing away from the center of the mesh first, so that they occlude the rest.
+        // run it after optimize_vertex_cache, as it keeps the order within clusters
+        static void optimize_overdraw(std::vector<uint32_t>& indices,
+                                      const std::vector<vertex>& vertices);
+        // reorders vertices into the order they are first used, so that vertex fetches are
+        // mostly sequential. vertices that are never used are moved to the end
+        static void optimize_vertex_fetch(std::vector<vertex>& vertices,
+                                          std::vector<uint32_t>& indices);
+        // collapses edges until at most target_index_count indices are left, or until every
+        // collapse would move the surface by more than target_error, relative to the size of
+        // the mesh. the result references the same vertices. copies of a vertex along normal or
+        // uv seams are moved together, and vertices on borders never move, so that meshes and
+        // their simplified versions line up. if result_error is not null, the largest error of
+        // any collapse is written to it
+        static std::vector<uint32_t> simplify(const std::vector<uint32_t>& indices,
+                                              const std::vector<vertex>& vertices,
+                                              size_t target_index_count, float target_error,
+                                              float* result_error = nullptr);
+    };
+} // namespace vkrollercoaster
\ No newline at end of file
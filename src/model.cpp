@@ -19,7 +19,11 @@
 #include <assimp/postprocess.h>
 #include <assimp/DefaultLogger.hpp>
 #include <assimp/LogStream.hpp>
+#include <assimp/DefaultIOSystem.h>
 #include "model.h"
+#include "asset_manager.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
 #include "util.h"
 namespace vkrollercoaster {
     template <glm::length_t L, typename T>
@@ -42,6 +46,151 @@ namespace vkrollercoaster {
 
         return result;
     }
+    bounding_volume bounding_volume::from_vertices(const std::vector<vertex>& vertices,
+                                                   const uint32_t* indices, size_t index_count) {
+        bounding_volume volume;
+        for (size_t i = 0; i < index_count; i++) {
+            const glm::vec3& position = vertices[indices[i]].position;
+            volume.min = glm::min(volume.min, position);
+            volume.max = glm::max(volume.max, position);
+        }
+        if (volume.empty()) {
+            return volume;
+        }
+        volume.center = (volume.min + volume.max) / 2.f;
+        float radius_squared = 0.f;
+        for (size_t i = 0; i < index_count; i++) {
+            glm::vec3 offset = vertices[indices[i]].position - volume.center;
+            radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+        }
+        volume.radius = glm::sqrt(radius_squared);
+        return volume;
+    }
+    void bounding_volume::merge(const bounding_volume& other) {
+        if (other.empty()) {
+            return;
+        }
+        if (this->empty()) {
+            *this = other;
+            return;
+        }
+        this->min = glm::min(this->min, other.min);
+        this->max = glm::max(this->max, other.max);
+
+        // keep the sphere centered on the box, and large enough for both spheres
+        glm::vec3 center = (this->min + this->max) / 2.f;
+        float radius = glm::distance(center, this->center) + this->radius;
+        radius = std::max(radius, glm::distance(center, other.center) + other.radius);
+        this->center = center;
+        this->radius = radius;
+    }
+    template <typename mesh_t>
+    static void create_index_buffers(const std::vector<uint32_t>& indices,
+                                     const std::vector<mesh_t>& meshes,
+                                     model_buffer_data& buffers) {
+        buffers.lod_count = 1;
+        for (const auto& _mesh : meshes) {
+            buffers.lod_count = std::max(buffers.lod_count, _mesh.lods.size() + 1);
+        }
+
+        // we put together buffers to save time in
+        // renderer::render, thus decreasing render times
+        std::map<size_t, std::vector<uint32_t>> index_map;
+        buffers.index_ranges.clear();
+        buffers.mesh_ranges.assign(meshes.size(), std::vector<index_range>(buffers.lod_count));
+        for (size_t lod = 0; lod < buffers.lod_count; lod++) {
+            for (size_t i = 0; i < meshes.size(); i++) {
+                const auto& _mesh = meshes[i];
+                // meshes with fewer levels keep drawing their coarsest one
+                index_range range = { _mesh.index_offset, _mesh.index_count };
+                if (lod > 0 && !_mesh.lods.empty()) {
+                    range = _mesh.lods[std::min(lod, _mesh.lods.size()) - 1];
+                }
+                auto begin = indices.begin() + range.offset;
+                auto end = begin + range.count;
+
+                auto& material_indices = index_map[_mesh.material_index];
+                auto& ranges = buffers.index_ranges[_mesh.material_index];
+                if (ranges.size() <= lod) {
+                    ranges.resize(lod + 1, { material_indices.size(), 0 });
+                }
+                ranges[lod].count += range.count;
+                buffers.mesh_ranges[i][lod] = { material_indices.size(), range.count };
+                material_indices.insert(material_indices.end(), begin, end);
+            }
+        }
+        buffers.indices.clear();
+        for (const auto& [material_index, material_indices] : index_map) {
+            buffers.indices[material_index] = ref<index_buffer>::create(material_indices);
+        }
+    }
+    // the box that packed positions are quantized within. flat axes get a unit extent, so that
+    // nothing is divided by zero
+    static void get_quantization_box(const bounding_volume& bounds, glm::vec3& origin,
+                                     glm::vec3& extent) {
+        if (bounds.empty()) {
+            origin = glm::vec3(0.f);
+            extent = glm::vec3(1.f);
+            return;
+        }
+        origin = bounds.min;
+        extent = bounds.max - bounds.min;
+        for (glm::length_t i = 0; i < 3; i++) {
+            if (extent[i] <= 0.f) {
+                extent[i] = 1.f;
+            }
+        }
+    }
+    static glm::mat4 get_position_transform(const bounding_volume& bounds, vertex_format format) {
+        if (format != vertex_format::packed) {
+            return glm::mat4(1.f);
+        }
+        glm::vec3 origin, extent;
+        get_quantization_box(bounds, origin, extent);
+        return glm::translate(glm::mat4(1.f), origin) * glm::scale(glm::mat4(1.f), extent);
+    }
+    // maps a unit vector onto the octahedron, unfolded into the [-1, 1] square
+    static glm::vec2 octahedral_encode(const glm::vec3& direction) {
+        float length = glm::abs(direction.x) + glm::abs(direction.y) + glm::abs(direction.z);
+        if (length <= 0.f) {
+            return glm::vec2(0.f);
+        }
+        glm::vec3 projected = direction / length;
+        glm::vec2 encoded = glm::vec2(projected.x, projected.y);
+        if (projected.z < 0.f) {
+            // fold the lower half over the diagonals
+            glm::vec2 folded = 1.f - glm::abs(glm::vec2(projected.y, projected.x));
+            encoded.x = projected.x >= 0.f ? folded.x : -folded.x;
+            encoded.y = projected.y >= 0.f ? folded.y : -folded.y;
+        }
+        return encoded;
+    }
+    static ref<vertex_buffer> create_vertex_buffer(const std::vector<vertex>& vertices,
+                                                   const bounding_volume& bounds,
+                                                   vertex_format format) {
+        if (format == vertex_format::standard) {
+            return ref<vertex_buffer>::create(vertices);
+        }
+        glm::vec3 origin, extent;
+        get_quantization_box(bounds, origin, extent);
+        std::vector<packed_vertex> packed(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const vertex& source = vertices[i];
+            packed_vertex& destination = packed[i];
+
+            // vertices that no mesh references may lie outside of the bounds
+            glm::vec3 position = glm::clamp((source.position - origin) / extent, 0.f, 1.f);
+            for (glm::length_t j = 0; j < 3; j++) {
+                destination.position[j] = (uint16_t)glm::round(position[j] * 65535.f);
+            }
+            destination.position[3] = 0;
+
+            destination.normal = glm::packSnorm2x16(octahedral_encode(source.normal));
+            destination.tangent = glm::packSnorm2x16(octahedral_encode(source.tangent));
+            destination.uv = glm::packHalf2x16(source.uv);
+        }
+        return ref<vertex_buffer>::create(packed);
+    }
     struct error_logstream : public Assimp::LogStream {
         virtual void write(const char* message) override {
             throw std::runtime_error("assimp: " + std::string(message));
@@ -59,40 +208,205 @@ namespace vkrollercoaster {
         logger->attachStream(new error_logstream, Assimp::Logger::Err);
         logger->attachStream(new warning_logstream, Assimp::Logger::Warn);
     }
-    model_source::model_source(const fs::path& path) {
+    model_source::model_source(const fs::path& path, bool load,
+                               const model_import_options& options) {
         initialize_logger();
         this->m_path = path;
+        this->m_import_options = options;
         if (!this->m_path.is_absolute()) {
             this->m_path = fs::absolute(this->m_path);
         }
-        this->reload();
+        if (load) {
+            this->reload();
+        }
+    }
+    model_source::~model_source() {
+        if (!this->m_asset_key.empty()) {
+            asset_manager::remove_model_source(this->m_asset_key);
+        }
     }
     static constexpr uint32_t import_flags =
         aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_GenUVCoords |
         aiProcess_OptimizeMeshes | aiProcess_JoinIdenticalVertices |
         aiProcess_ValidateDataStructure | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+    // reordering for the vertex cache and vertex fetch are always done. reordering for overdraw
+    // costs a little cache efficiency, in exchange for less shading of occluded triangles
+    static constexpr bool optimize_overdraw = true;
+    static void optimize_meshes(model_source::loaded_data& data, const fs::path& path) {
+        vertex_cache_statistics before, after;
+        for (const auto& mesh_data : data.meshes) {
+            auto vertex_begin = data.vertices.begin() + mesh_data.vertex_offset;
+            auto index_begin = data.indices.begin() + mesh_data.index_offset;
+            std::vector<vertex> vertices(vertex_begin, vertex_begin + mesh_data.vertex_count);
+            std::vector<uint32_t> indices(index_begin, index_begin + mesh_data.index_count);
+
+            auto mesh_before = mesh_optimizer::analyze_vertex_cache(indices, vertices.size());
+            mesh_optimizer::optimize_vertex_cache(indices, vertices.size());
+            if (optimize_overdraw) {
+                mesh_optimizer::optimize_overdraw(indices, vertices);
+            }
+            mesh_optimizer::optimize_vertex_fetch(vertices, indices);
+            auto mesh_after = mesh_optimizer::analyze_vertex_cache(indices, vertices.size());
+
+            // vertex and index counts are unchanged, so the mesh's ranges still apply
+            std::copy(vertices.begin(), vertices.end(), vertex_begin);
+            std::copy(indices.begin(), indices.end(), index_begin);
+            before.triangle_count += mesh_before.triangle_count;
+            before.vertex_count += mesh_before.vertex_count;
+            before.misses += mesh_before.misses;
+            after.misses += mesh_after.misses;
+        }
+        if (before.triangle_count == 0) {
+            return;
+        }
+        float triangle_count = (float)before.triangle_count;
+        float vertex_count = (float)before.vertex_count;
+        spdlog::info("optimized {}: acmr {:.3f} -> {:.3f}, atvr {:.3f} -> {:.3f}", path.string(),
+                     before.misses / triangle_count, after.misses / triangle_count,
+                     before.misses / vertex_count, after.misses / vertex_count);
+    }
+    // levels of detail generated for every imported mesh, including the full mesh. each level
+    // aims for half the triangles of the last, and may move the surface by up to lod_error of
+    // the mesh's radius, doubling with each level. 1 disables simplification
+    static constexpr size_t max_lod_count = 4;
+    static constexpr float lod_error = 0.01f;
+    static void generate_lods(model_source::loaded_data& data, const fs::path& path) {
+        std::vector<size_t> triangle_counts(max_lod_count, 0);
+        size_t lod_count = 1;
+        for (auto& mesh_data : data.meshes) {
+            auto vertex_begin = data.vertices.begin() + mesh_data.vertex_offset;
+            auto index_begin = data.indices.begin() + mesh_data.index_offset;
+            std::vector<vertex> vertices(vertex_begin, vertex_begin + mesh_data.vertex_count);
+            std::vector<uint32_t> indices(index_begin, index_begin + mesh_data.index_count);
+
+            triangle_counts[0] += indices.size() / 3;
+            for (size_t lod = 1; lod < max_lod_count; lod++) {
+                size_t target_index_count = indices.size() / 6 * 3;
+                float target_error = lod_error * (float)(1 << (lod - 1));
+                auto simplified =
+                    mesh_optimizer::simplify(indices, vertices, target_index_count, target_error);
+
+                // stop once simplifying stops paying off
+                if (simplified.empty() || simplified.size() > indices.size() * 9 / 10) {
+                    break;
+                }
+                mesh_optimizer::optimize_vertex_cache(simplified, vertices.size());
+                mesh_data.lods.push_back({ data.indices.size(), simplified.size() });
+                triangle_counts[lod] += simplified.size() / 3;
+                util::append_vector(data.indices, simplified);
+                indices = std::move(simplified);
+            }
+
+            // meshes that ran out of levels are drawn at their coarsest beyond them
+            for (size_t lod = mesh_data.lods.size() + 1; lod < max_lod_count; lod++) {
+                triangle_counts[lod] += indices.size() / 3;
+            }
+            lod_count = std::max(lod_count, mesh_data.lods.size() + 1);
+        }
+        if (lod_count < 2) {
+            return;
+        }
+        std::stringstream counts;
+        for (size_t lod = 0; lod < lod_count; lod++) {
+            counts << (lod > 0 ? " -> " : "") << triangle_counts[lod];
+        }
+        spdlog::info("generated {} levels of detail for {}: {} triangles", lod_count,
+                     path.string(), counts.str());
+    }
+    // records every file assimp opens while importing, such as the buffers of a gltf file
+    class recording_io_system : public Assimp::DefaultIOSystem {
+    public:
+        recording_io_system(std::set<std::string>& files) : m_files(files) {}
+        virtual Assimp::IOStream* Open(const char* file, const char* mode) override {
+            Assimp::IOStream* stream = Assimp::DefaultIOSystem::Open(file, mode);
+            if (stream) {
+                this->m_files.insert(fs::absolute(file).string());
+            }
+            return stream;
+        }
+
+    private:
+        std::set<std::string>& m_files;
+    };
     void model_source::reload() {
-        this->m_importer = std::make_unique<Assimp::Importer>();
-        this->m_vertices.clear();
-        this->m_indices.clear();
-        this->m_meshes.clear();
-        this->m_materials.clear();
-        this->m_scene = this->m_importer->ReadFile(this->m_path.string(), import_flags);
-        if (!this->m_scene || this->m_scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-            !this->m_scene->mRootNode) {
-            throw std::runtime_error("could not load model: " +
-                                     std::string(this->m_importer->GetErrorString()));
+        loaded_data data;
+        this->load(data);
+        this->apply(data);
+    }
+    void model_source::load(loaded_data& data) const {
+        // the path is part of the key, as texture paths are resolved relative to it
+        uint64_t key = util::hash_data(this->m_path.string());
+        key = util::hash_data(&import_flags, sizeof(uint32_t), key);
+        key = util::hash_data(&optimize_overdraw, sizeof(bool), key);
+        key = util::hash_data(&max_lod_count, sizeof(size_t), key);
+        key = util::hash_data(&lod_error, sizeof(float), key);
+        key = util::hash_data(&this->m_import_options.generate_lods, sizeof(bool), key);
+        key = util::hash_file(this->m_path, key);
+        std::string cache_name = this->m_path.stem().string();
+        if (!mesh_cache::read(cache_name, key, data.vertices, data.indices, data.meshes,
+                              data.materials, data.bounds)) {
+            data = loaded_data();
+            std::set<std::string> dependencies;
+            this->import(data, dependencies);
+            mesh_cache::write(cache_name, key, dependencies, data.vertices, data.indices,
+                              data.meshes, data.materials, data.bounds);
+        }
+
+        // decode texture maps here as well, so that only uploading them is left for apply
+        for (const auto& desc : data.materials) {
+            for (const fs::path* path :
+                 { &desc.albedo_texture, &desc.specular_texture, &desc.normal_map }) {
+                if (path->empty() || data.textures.find(*path) != data.textures.end()) {
+                    continue;
+                }
+                image_data decoded;
+                if (image::load_image(*path, decoded)) {
+                    data.textures[*path] = std::move(decoded);
+                }
+            }
         }
-        std::vector<ref<material>> materials;
-        this->process_materials();
-        this->process_node(this->m_scene->mRootNode, nullptr);
+    }
+    void model_source::apply(loaded_data& data) {
+        this->m_vertices = std::move(data.vertices);
+        this->m_indices = std::move(data.indices);
+        this->m_meshes = std::move(data.meshes);
+        this->m_bounds = data.bounds;
+        this->m_importer = std::move(data.importer);
+        this->m_scene = data.scene;
+        this->m_materials.clear();
+        this->create_materials(data);
+
+        // vertex buffers are recreated as models ask for them again
+        this->m_buffers.clear();
+        create_index_buffers(this->m_indices, this->m_meshes, this->m_index_data);
 
         for (model* _model : this->m_created_models) {
             _model->acquire_mesh_data();
-            _model->invalidate_buffers();
         }
     }
-    void model_source::process_node(aiNode* node, const void* parent_transform) {
+    void model_source::import(loaded_data& data, std::set<std::string>& dependencies) const {
+        data.importer = std::make_unique<Assimp::Importer>();
+        auto io_handler = std::make_unique<recording_io_system>(dependencies);
+        data.importer->SetIOHandler(io_handler.get());
+        data.scene = data.importer->ReadFile(this->m_path.string(), import_flags);
+
+        // the recording handler references dependencies, so it can't outlive this call. resetting
+        // the handler doesn't free it, so it is freed with io_handler
+        data.importer->SetIOHandler(nullptr);
+        if (!data.scene || data.scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+            !data.scene->mRootNode) {
+            throw std::runtime_error("could not load model: " +
+                                     std::string(data.importer->GetErrorString()));
+        }
+        this->process_materials(data);
+        this->process_node(data, data.scene->mRootNode, nullptr);
+        optimize_meshes(data, this->m_path);
+        if (this->m_import_options.generate_lods) {
+            generate_lods(data, this->m_path);
+        }
+    }
+    void model_source::process_node(loaded_data& data, aiNode* node,
+                                    const void* parent_transform) const {
         aiMatrix4x4 accumulated;
         if (parent_transform) {
             accumulated = *(const aiMatrix4x4*)parent_transform;
@@ -100,16 +414,17 @@ namespace vkrollercoaster {
         aiMatrix4x4 transform = accumulated * node->mTransformation;
 
         for (size_t i = 0; i < node->mNumMeshes; i++) {
-            aiMesh* mesh_ = this->m_scene->mMeshes[node->mMeshes[i]];
-            this->process_mesh(mesh_, node, &transform);
+            aiMesh* mesh_ = data.scene->mMeshes[node->mMeshes[i]];
+            this->process_mesh(data, mesh_, node, &transform);
         }
 
         for (size_t i = 0; i < node->mNumChildren; i++) {
             aiNode* child = node->mChildren[i];
-            this->process_node(child, &transform);
+            this->process_node(data, child, &transform);
         }
     }
-    void model_source::process_mesh(aiMesh* mesh_, aiNode* node, const void* node_transform) {
+    void model_source::process_mesh(loaded_data& data, aiMesh* mesh_, aiNode* node,
+                                    const void* node_transform) const {
         std::vector<vertex> vertices;
         std::vector<uint32_t> indices;
 
@@ -118,6 +433,8 @@ namespace vkrollercoaster {
         normal_transform.Transpose();
         normal_transform.Inverse();
 
+        vertices.reserve(mesh_->mNumVertices);
+        indices.reserve(mesh_->mNumFaces * 3);
         for (size_t i = 0; i < mesh_->mNumVertices; i++) {
             vertex v;
 
@@ -148,104 +465,149 @@ namespace vkrollercoaster {
                 indices.push_back(face.mIndices[j]);
             }
         }
-        size_t mesh_index = this->m_meshes.size();
-        mesh& mesh_data = this->m_meshes.emplace_back();
-        mesh_data.vertex_offset = this->m_vertices.size();
-        mesh_data.index_offset = this->m_indices.size();
+        size_t mesh_index = data.meshes.size();
+        mesh& mesh_data = data.meshes.emplace_back();
+        mesh_data.vertex_offset = data.vertices.size();
+        mesh_data.index_offset = data.indices.size();
         mesh_data.assimp_mesh = mesh_;
         mesh_data.node = node;
         mesh_data.vertex_count = vertices.size();
         mesh_data.index_count = indices.size();
         mesh_data.material_index = mesh_->mMaterialIndex;
-        util::append_vector(this->m_vertices, vertices);
-        util::append_vector(this->m_indices, indices);
+        mesh_data.bounds =
+            bounding_volume::from_vertices(vertices, indices.data(), indices.size());
+        data.bounds.merge(mesh_data.bounds);
+        util::append_vector(data.vertices, vertices);
+        util::append_vector(data.indices, indices);
+    }
+    void model_source::process_materials(loaded_data& data) const {
+        for (size_t i = 0; i < data.scene->mNumMaterials; i++) {
+            material_description& desc = data.materials.emplace_back();
+            aiMaterial* ai_material = data.scene->mMaterials[i];
+            aiString ai_string;
+
+            // name
+            if (ai_material->Get(AI_MATKEY_NAME, ai_string) == aiReturn_SUCCESS) {
+                desc.name = ai_string.C_Str();
+            }
+
+            // texture maps
+            if (ai_material->GetTexture(aiTextureType_DIFFUSE, 0, &ai_string) == aiReturn_SUCCESS) {
+                desc.albedo_texture = this->get_resource_path(ai_string);
+            }
+            if (ai_material->GetTexture(aiTextureType_SPECULAR, 0, &ai_string) ==
+                aiReturn_SUCCESS) {
+                desc.specular_texture = this->get_resource_path(ai_string);
+            }
+            if (ai_material->GetTexture(aiTextureType_NORMALS, 0, &ai_string) == aiReturn_SUCCESS) {
+                desc.normal_map = this->get_resource_path(ai_string);
+            }
+
+            // opacity
+            if (ai_material->Get(AI_MATKEY_OPACITY, desc.opacity) != aiReturn_SUCCESS) {
+                desc.opacity = 1.f;
+            }
+
+            // shininess
+            if (ai_material->Get(AI_MATKEY_SHININESS, desc.shininess) != aiReturn_SUCCESS) {
+                desc.shininess = 80.f;
+            }
+
+            // roughness, for image-based lighting. assimp has no common roughness key, so it is
+            // approximated from the blinn-phong exponent
+            desc.roughness = glm::sqrt(2.f / (desc.shininess + 2.f));
+
+            // albedo and specular colors
+            desc.albedo_color = glm::vec3(1.f);
+            desc.specular_color = glm::vec3(1.f);
+            aiColor3D ai_color;
+            if (ai_material->Get(AI_MATKEY_COLOR_DIFFUSE, ai_color) == aiReturn_SUCCESS) {
+                desc.albedo_color = convert<3>(ai_color);
+            }
+            if (ai_material->Get(AI_MATKEY_COLOR_SPECULAR, ai_color) == aiReturn_SUCCESS) {
+                desc.albedo_color = convert<3>(ai_color);
+            }
+        }
     }
-    void model_source::process_materials() {
+    void model_source::create_materials(const loaded_data& data) {
         // todo: change when skinning
         const std::string shader_name = "default_static";
         ref<shader> material_shader = shader_library::get(shader_name);
 
-        for (size_t i = 0; i < this->m_scene->mNumMaterials; i++) {
-            auto _material = ref<material>::create(material_shader);
-            aiMaterial* ai_material = this->m_scene->mMaterials[i];
-            aiString ai_string;
+        // textures that could not be decoded are missing from the loaded data
+        auto get_texture = [&](const fs::path& path) -> ref<texture> {
+            auto it = data.textures.find(path);
+            if (it == data.textures.end()) {
+                return nullptr;
+            }
+            return texture::from_file(path, it->second);
+        };
 
-            // name
-            if (ai_material->Get(AI_MATKEY_NAME, ai_string) == aiReturn_SUCCESS) {
-                _material->set_name(ai_string.C_Str());
+        for (const auto& desc : data.materials) {
+            auto _material = ref<material>::create(material_shader);
+            if (!desc.name.empty()) {
+                _material->set_name(desc.name);
             }
 
             // albedo map
-            if (ai_material->GetTexture(aiTextureType_DIFFUSE, 0, &ai_string) == aiReturn_SUCCESS) {
-                auto path = this->get_resource_path(ai_string);
-                auto img = image2d::from_file(path);
-                if (img) {
-                    auto tex = ref<texture>::create(img);
+            if (!desc.albedo_texture.empty()) {
+                auto tex = get_texture(desc.albedo_texture);
+                if (tex) {
                     _material->set_texture("albedo_texture", tex);
                 } else {
-                    spdlog::warn("albedo map \"{0}\" does not exist!", path.string());
+                    spdlog::warn("albedo map \"{0}\" does not exist!",
+                                 desc.albedo_texture.string());
                 }
             }
 
             // specular map
-            if (ai_material->GetTexture(aiTextureType_SPECULAR, 0, &ai_string) ==
-                aiReturn_SUCCESS) {
-                auto path = this->get_resource_path(ai_string);
-                auto img = image2d::from_file(path);
-                if (img) {
-                    auto tex = ref<texture>::create(img);
+            if (!desc.specular_texture.empty()) {
+                auto tex = get_texture(desc.specular_texture);
+                if (tex) {
                     _material->set_texture("specular_texture", tex);
                 } else {
-                    spdlog::warn("specular map \"{0}\" does not exist!", path.string());
+                    spdlog::warn("specular map \"{0}\" does not exist!",
+                                 desc.specular_texture.string());
                 }
             }
 
             // normal map
             bool normal_map_created = false;
-            if (ai_material->GetTexture(aiTextureType_NORMALS, 0, &ai_string) == aiReturn_SUCCESS) {
-                auto path = this->get_resource_path(ai_string);
-                auto img = image2d::from_file(path);
-                if (img) {
-                    auto tex = ref<texture>::create(img);
+            if (!desc.normal_map.empty()) {
+                auto tex = get_texture(desc.normal_map);
+                if (tex) {
                     _material->set_texture("normal_map", tex);
                     normal_map_created = true;
                 } else {
-                    spdlog::warn("normal map \"{0}\" does not exist!", path.string());
+                    spdlog::warn("normal map \"{0}\" does not exist!", desc.normal_map.string());
                 }
             }
             _material->set_data("use_normal_map", normal_map_created);
 
-            // opacity
-            float opacity;
-            if (ai_material->Get(AI_MATKEY_OPACITY, opacity) != aiReturn_SUCCESS) {
-                opacity = 1.f;
-            }
-            _material->set_data("opacity", opacity);
-
-            // shininess
-            float shininess;
-            if (ai_material->Get(AI_MATKEY_SHININESS, shininess) != aiReturn_SUCCESS) {
-                shininess = 80.f;
-            }
-            _material->set_data("shininess", shininess);
-
-            // albedo and specular colors
-            glm::vec3 albedo_color = glm::vec3(1.f);
-            glm::vec3 specular_color = glm::vec3(1.f);
-            aiColor3D ai_color;
-            if (ai_material->Get(AI_MATKEY_COLOR_DIFFUSE, ai_color) == aiReturn_SUCCESS) {
-                albedo_color = convert<3>(ai_color);
-            }
-            if (ai_material->Get(AI_MATKEY_COLOR_SPECULAR, ai_color) == aiReturn_SUCCESS) {
-                albedo_color = convert<3>(ai_color);
-            }
-            _material->set_data("albedo_color", albedo_color);
-            _material->set_data("specular_color", specular_color);
+            _material->set_data("opacity", desc.opacity);
+            _material->set_data("shininess", desc.shininess);
+            _material->set_data("roughness", desc.roughness);
+            _material->set_data("albedo_color", desc.albedo_color);
+            _material->set_data("specular_color", desc.specular_color);
 
             this->m_materials.push_back(_material);
         }
     }
-    fs::path model_source::get_resource_path(const aiString& ai_path) {
+    const model_buffer_data& model_source::get_buffers(vertex_format format) {
+        auto it = this->m_buffers.find(format);
+        if (it != this->m_buffers.end()) {
+            return it->second;
+        }
+
+        // nothing has loaded yet if there are no vertices, so the buffers are left empty
+        auto& buffers = this->m_buffers[format];
+        if (!this->m_vertices.empty()) {
+            buffers = this->m_index_data;
+            buffers.vertices = create_vertex_buffer(this->m_vertices, this->m_bounds, format);
+        }
+        return buffers;
+    }
+    fs::path model_source::get_resource_path(const aiString& ai_path) const {
         fs::path path = ai_path.C_Str();
         if (path.is_relative()) {
             path = this->m_path.parent_path() / path;
@@ -253,20 +615,16 @@ namespace vkrollercoaster {
         return path;
     }
 
-    model::model(ref<model_source> source) {
+    model::model(ref<model_source> source, vertex_format format) {
         this->m_source = source;
         this->m_source->m_created_models.insert(this);
+        this->m_format = format;
 
         this->set_input_layout();
         this->acquire_mesh_data();
-        this->invalidate_buffers();
     }
 
-    model::model(const model_data& data) {
-        this->set_input_layout();
-
-        this->set_data(data);
-    }
+    model::model(const model_data& data) { this->set_data(data); }
 
     model::~model() {
         if (this->m_source) {
@@ -283,12 +641,42 @@ namespace vkrollercoaster {
         this->m_meshes = data.meshes;
         this->m_vertices = data.vertices;
         this->m_indices = data.indices;
+        this->m_format = data.format;
 
+        this->set_input_layout();
+        this->calculate_bounds();
         this->invalidate_buffers();
     }
 
+    void model::set_vertex_format(vertex_format format) {
+        if (format == this->m_format) {
+            return;
+        }
+        this->m_format = format;
+        this->set_input_layout();
+        if (this->m_source) {
+            this->acquire_mesh_data();
+        } else {
+            this->invalidate_buffers();
+        }
+    }
+
+    std::string model::get_shader_variant() {
+        return this->m_format == vertex_format::packed ? "packed" : std::string();
+    }
+
     void model::set_input_layout() {
         // todo: use different vertex structure if animated
+        if (this->m_format == vertex_format::packed) {
+            this->m_input_layout.stride = sizeof(packed_vertex);
+            this->m_input_layout.attributes = {
+                { vertex_attribute_type::UNORM16_VEC4, offsetof(packed_vertex, position) },
+                { vertex_attribute_type::SNORM16_VEC2, offsetof(packed_vertex, normal) },
+                { vertex_attribute_type::HALF_VEC2, offsetof(packed_vertex, uv) },
+                { vertex_attribute_type::SNORM16_VEC2, offsetof(packed_vertex, tangent) },
+            };
+            return;
+        }
         this->m_input_layout.stride = sizeof(vertex);
         this->m_input_layout.attributes = {
             { vertex_attribute_type::VEC3, offsetof(vertex, position) },
@@ -304,9 +692,8 @@ namespace vkrollercoaster {
             return;
         }
 
-        this->m_vertices = this->m_source->m_vertices;
-        this->m_indices = this->m_source->m_indices;
         this->m_materials = this->m_source->m_materials;
+        this->m_buffers = this->m_source->get_buffers(this->m_format);
 
         this->m_meshes.clear();
         for (const auto& _mesh : this->m_source->m_meshes) {
@@ -315,30 +702,29 @@ namespace vkrollercoaster {
             to_insert.index_offset = _mesh.index_offset;
             to_insert.index_count = _mesh.index_count;
             to_insert.material_index = _mesh.material_index;
+            to_insert.bounds = _mesh.bounds;
+            to_insert.lods = _mesh.lods;
 
             this->m_meshes.push_back(to_insert);
         }
+        this->m_bounds = this->m_source->m_bounds;
+        this->m_position_transform = get_position_transform(this->m_bounds, this->m_format);
     }
 
-    void model::invalidate_buffers() {
-        // we put together buffers to save time in
-        // renderer::render, thus decreasing render times
-
-        // vertices
-        this->m_buffers.vertices = ref<vertex_buffer>::create(this->m_vertices);
-
-        // indices
-        std::map<size_t, std::vector<uint32_t>> index_map;
-        for (const auto& _mesh : this->m_meshes) {
-            auto begin = this->m_indices.begin() + _mesh.index_offset;
-            auto end = begin + _mesh.index_count;
-
-            auto& indices = index_map[_mesh.material_index];
-            indices.insert(indices.begin(), begin, end);
-        }
-        this->m_buffers.indices.clear();
-        for (const auto& [material_index, indices] : index_map) {
-            this->m_buffers.indices[material_index] = ref<index_buffer>::create(indices);
+    void model::calculate_bounds() {
+        this->m_bounds = bounding_volume();
+        for (auto& _mesh : this->m_meshes) {
+            const uint32_t* indices = this->m_indices.data() + _mesh.index_offset;
+            _mesh.bounds = bounding_volume::from_vertices(this->m_vertices, indices,
+                                                          _mesh.index_count);
+            this->m_bounds.merge(_mesh.bounds);
         }
     }
+
+    void model::invalidate_buffers() {
+        this->m_buffers.vertices =
+            create_vertex_buffer(this->m_vertices, this->m_bounds, this->m_format);
+        create_index_buffers(this->m_indices, this->m_meshes, this->m_buffers);
+        this->m_position_transform = get_position_transform(this->m_bounds, this->m_format);
+    }
 } // namespace vkrollercoaster
\ No newline at end of file
@@ -27,44 +27,144 @@ namespace vkrollercoaster {
         glm::vec2 uv;
         glm::vec3 tangent;
     };
+    // a compact alternative to vertex, at 20 bytes rather than 44. positions are 16-bit fixed
+    // point within the model's bounds, normals and tangents are octahedral-encoded as 16-bit
+    // snorm pairs, and uvs are half floats
+    struct packed_vertex {
+        uint16_t position[4]; // the last component is padding
+        uint32_t normal, tangent, uv;
+    };
+    enum class vertex_format { standard, packed };
+    // an axis-aligned bounding box, along with a sphere enclosing its contents
+    struct bounding_volume {
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+        glm::vec3 center = glm::vec3(0.f);
+        float radius = 0.f;
+
+        bool empty() const { return this->min.x > this->max.x; }
+
+        // builds a box around the indexed vertices, and the tightest sphere centered on it
+        static bounding_volume from_vertices(const std::vector<vertex>& vertices,
+                                             const uint32_t* indices, size_t index_count);
+        // grows this volume to enclose another
+        void merge(const bounding_volume& other);
+    };
+    // a span of an index array
+    struct index_range {
+        size_t offset, count;
+    };
+    // everything needed to create a material for a model, so that materials can be created
+    // without the importer. texture paths are empty if the material has no such map
+    struct material_description {
+        std::string name;
+        fs::path albedo_texture, specular_texture, normal_map;
+        glm::vec3 albedo_color, specular_color;
+        float opacity, shininess, roughness;
+    };
+    // gpu buffers of a model. index buffers are keyed by material index, and hold every level
+    // of detail one after another
+    struct model_buffer_data {
+        ref<vertex_buffer> vertices;
+        std::map<size_t, ref<index_buffer>> indices;
+        // the range of each index buffer to draw at each level of detail, starting with the
+        // full mesh
+        std::map<size_t, std::vector<index_range>> index_ranges;
+        // the range of each mesh's material's index buffer that holds the mesh, at each level of
+        // detail. within a level, meshes of the same material are stored in order
+        std::vector<std::vector<index_range>> mesh_ranges;
+        size_t lod_count = 1;
+    };
     class model;
 
-    // a "model source" represents a file on disk
+    // settings that change what is produced when importing a model. they are part of the model's
+    // mesh cache key
+    struct model_import_options {
+        // simplify every mesh into coarser levels of detail. models that are never far away, or
+        // too simple to reduce, can skip it
+        bool generate_lods = true;
+    };
+
+    // a "model source" represents a file on disk. use asset_manager::load_model_source, so that
+    // every model loaded from the same file shares one import and one set of gpu buffers
     class model_source : public ref_counted {
     public:
         struct mesh {
             size_t vertex_offset, vertex_count, index_offset, index_count, material_index;
+            bounding_volume bounds;
+            // simplified versions of the mesh, from finest to coarsest
+            std::vector<index_range> lods;
+            // nullptr if the model was loaded from the mesh cache
             aiNode* node;
             aiMesh* assimp_mesh;
         };
-        model_source(const fs::path& path);
+        // everything read from disk when loading, before any gpu resources are created
+        struct loaded_data {
+            std::vector<vertex> vertices;
+            std::vector<uint32_t> indices;
+            std::vector<mesh> meshes;
+            std::vector<material_description> materials;
+            // decoded texture maps, keyed by path
+            std::map<fs::path, image_data> textures;
+            bounding_volume bounds;
+            std::unique_ptr<Assimp::Importer> importer;
+            const aiScene* scene = nullptr;
+        };
+
+        // if load is false, the model source stays empty until loaded data is applied to it
+        model_source(const fs::path& path, bool load = true,
+                     const model_import_options& options = model_import_options());
+        ~model_source();
         model_source(const model_source&) = delete;
         model_source& operator=(const model_source&) = delete;
         void reload();
 
+        // reads and processes the file. this only reads the path of the model source, so it is
+        // safe to call on any thread while the model source is in use
+        void load(loaded_data& data) const;
+        // swaps loaded data in, and creates its gpu resources on the main thread
+        void apply(loaded_data& data);
+
         const std::vector<vertex>& get_vertices() { return this->m_vertices; }
+        // the indices of every mesh at every level of detail
         const std::vector<uint32_t>& get_indices() { return this->m_indices; }
         const std::vector<mesh>& get_meshes() { return this->m_meshes; }
         const std::vector<ref<material>>& get_materials() { return this->m_materials; }
+        const bounding_volume& get_bounds() { return this->m_bounds; }
+        // buffers holding the vertices in the given format, created on first use. index buffers
+        // are shared between formats
+        const model_buffer_data& get_buffers(vertex_format format = vertex_format::standard);
         const fs::path& get_path() { return this->m_path; }
+        const model_import_options& get_import_options() { return this->m_import_options; }
 
     private:
-        void process_node(aiNode* node, const void* parent_transform);
-        void process_mesh(aiMesh* mesh_, aiNode* node, const void* node_transform);
-        void process_materials();
-        fs::path get_resource_path(const aiString& ai_path);
+        // imports the file with assimp, and adds every file it read to dependencies
+        void import(loaded_data& data, std::set<std::string>& dependencies) const;
+        void process_node(loaded_data& data, aiNode* node, const void* parent_transform) const;
+        void process_mesh(loaded_data& data, aiMesh* mesh_, aiNode* node,
+                          const void* node_transform) const;
+        void process_materials(loaded_data& data) const;
+        void create_materials(const loaded_data& data);
+        fs::path get_resource_path(const aiString& ai_path) const;
 
         std::vector<vertex> m_vertices;
         std::vector<uint32_t> m_indices;
         std::vector<mesh> m_meshes;
         std::vector<ref<material>> m_materials;
+        bounding_volume m_bounds;
+        std::map<vertex_format, model_buffer_data> m_buffers;
+        // index buffers and ranges, shared between formats. the vertex buffer is unused
+        model_buffer_data m_index_data;
 
         fs::path m_path;
-        const aiScene* m_scene;
+        model_import_options m_import_options;
+        std::string m_asset_key;
+        const aiScene* m_scene = nullptr;
         std::unique_ptr<Assimp::Importer> m_importer;
 
         std::set<model*> m_created_models;
         friend class model;
+        friend class asset_manager;
     };
 
     // a mesh to be rendered
@@ -73,45 +173,73 @@ namespace vkrollercoaster {
         struct mesh {
             size_t index_offset, index_count;
             size_t material_index;
+            bounding_volume bounds;
+            // simplified versions of the mesh, from finest to coarsest
+            std::vector<index_range> lods;
+
+            // the indices to draw at the given level of detail. past its coarsest level, a mesh
+            // stays at that level
+            index_range get_lod(size_t lod) const {
+                if (lod == 0 || this->lods.empty()) {
+                    return { this->index_offset, this->index_count };
+                }
+                return this->lods[std::min(lod, this->lods.size()) - 1];
+            }
         };
         struct model_data {
             std::vector<ref<material>> materials;
             std::vector<mesh> meshes;
             std::vector<vertex> vertices;
             std::vector<uint32_t> indices;
+            vertex_format format = vertex_format::standard;
         };
-        struct buffer_data {
-            ref<vertex_buffer> vertices;
-            std::map<size_t, ref<index_buffer>> indices;
-        };
+        using buffer_data = model_buffer_data;
 
-        model(ref<model_source> source);
+        model(ref<model_source> source, vertex_format format = vertex_format::standard);
         model(const model_data& data);
         ~model();
         model(const model&) = delete;
         model& operator=(const model&) = delete;
 
         void set_data(const model_data& data);
+        void set_vertex_format(vertex_format format);
 
         ref<model_source> get_source() { return this->m_source; }
-        const std::vector<vertex>& get_vertices() { return this->m_vertices; }
-        const std::vector<uint32_t>& get_indices() { return this->m_indices; }
+        // models created from a source share its vertex data, rather than copying it
+        const std::vector<vertex>& get_vertices() {
+            return this->m_source ? this->m_source->m_vertices : this->m_vertices;
+        }
+        const std::vector<uint32_t>& get_indices() {
+            return this->m_source ? this->m_source->m_indices : this->m_indices;
+        }
         const std::vector<mesh>& get_meshes() { return this->m_meshes; }
         const std::vector<ref<material>>& get_materials() { return this->m_materials; }
         const vertex_input_data& get_input_layout() { return this->m_input_layout; }
         const buffer_data& get_buffers() { return this->m_buffers; }
+        // 1 if the model has no simplified versions
+        size_t get_lod_count() { return this->m_buffers.lod_count; }
+        const bounding_volume& get_bounds() { return this->m_bounds; }
+        vertex_format get_vertex_format() { return this->m_format; }
+        // maps vertex positions into model space. identity unless positions are quantized
+        const glm::mat4& get_position_transform() { return this->m_position_transform; }
+        // the material shader variant that decodes this model's vertex format
+        std::string get_shader_variant();
 
     private:
         void set_input_layout();
         void acquire_mesh_data();
+        void calculate_bounds();
         void invalidate_buffers();
 
         std::vector<vertex> m_vertices;
         std::vector<uint32_t> m_indices;
         std::vector<mesh> m_meshes;
         std::vector<ref<material>> m_materials;
+        bounding_volume m_bounds;
         buffer_data m_buffers;
         vertex_input_data m_input_layout;
+        vertex_format m_format = vertex_format::standard;
+        glm::mat4 m_position_transform = glm::mat4(1.f);
 
         ref<model_source> m_source;
         friend class model_source;
@@ -35,6 +35,10 @@
 #include <limits>
 #include <algorithm>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
 #include <chrono>
 #include <iterator>
 #include <vulkan/vulkan.h>
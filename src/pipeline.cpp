@@ -23,6 +23,33 @@
 #include "material.h"
 #include "swapchain.h"
 namespace vkrollercoaster {
+    bool pipeline_spec::operator==(const pipeline_spec& other) const {
+        return (this->enable_depth_testing == other.enable_depth_testing) &&
+               (this->enable_blending == other.enable_blending) &&
+               (this->enable_culling == other.enable_culling) &&
+               (this->polygon_mode == other.polygon_mode) &&
+               (this->front_face == other.front_face) &&
+               (this->input_layout == other.input_layout) &&
+               (this->instance_input_layout == other.instance_input_layout);
+    }
+    static void hash_input_layout(size_t& seed, const vertex_input_data& input_layout) {
+        util::hash_combine(seed, input_layout.stride);
+        for (const auto& attribute : input_layout.attributes) {
+            util::hash_combine(seed, (uint32_t)attribute.type);
+            util::hash_combine(seed, attribute.offset);
+        }
+    }
+    size_t pipeline_spec::hash::operator()(const pipeline_spec& spec) const {
+        size_t seed = 0;
+        util::hash_combine(seed, spec.enable_depth_testing);
+        util::hash_combine(seed, spec.enable_blending);
+        util::hash_combine(seed, spec.enable_culling);
+        util::hash_combine(seed, (uint32_t)spec.polygon_mode);
+        util::hash_combine(seed, (uint32_t)spec.front_face);
+        hash_input_layout(seed, spec.input_layout);
+        hash_input_layout(seed, spec.instance_input_layout);
+        return seed;
+    }
     pipeline::pipeline(ref<render_target> target, ref<shader> _shader, const pipeline_spec& spec) {
         this->m_material = nullptr;
         this->m_render_target = target;
@@ -62,14 +89,54 @@ namespace vkrollercoaster {
     void pipeline::bind(ref<command_buffer> cmdbuffer) {
         size_t set_index = 0;
         if (this->m_render_target->get_render_target_type() == render_target_type::swapchain) {
-            ref<swapchain> swap_chain = this->m_render_target.as<swapchain>();
+            // no ref is taken here, as binding may happen on worker threads
+            auto swap_chain = (swapchain*)this->m_render_target.raw();
             set_index = swap_chain->get_current_image();
         }
         VkCommandBuffer vk_cmdbuffer = cmdbuffer->get();
         vkCmdBindPipeline(vk_cmdbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_pipeline);
+        if (!this->m_descriptor_sets.empty()) {
+            this->m_descriptor_sets_bound = true;
+        }
         for (const auto& [set, data] : this->m_descriptor_sets) {
+            std::vector<uint32_t> dynamic_offsets;
+            this->get_dynamic_offsets(set, dynamic_offsets);
             vkCmdBindDescriptorSets(vk_cmdbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_layout,
-                                    set, 1, &data.sets[set_index], 0, nullptr);
+                                    set, 1, &data.sets[set_index], dynamic_offsets.size(),
+                                    dynamic_offsets.data());
+        }
+    }
+    void pipeline::prepare_for_recording() {
+        // fetching the offsets brings each uniform buffer's current copy up to date. after
+        // that, binding only reads shared state
+        std::vector<uint32_t> dynamic_offsets;
+        for (const auto& [set, data] : this->m_descriptor_sets) {
+            this->get_dynamic_offsets(set, dynamic_offsets);
+        }
+    }
+    void pipeline::get_dynamic_offsets(uint32_t set, std::vector<uint32_t>& offsets) {
+        // uniform buffers are bound with dynamic offsets pointing at the current frame's copy
+        offsets.clear();
+        auto dynamic_bindings = this->m_dynamic_bindings.find(set);
+        if (dynamic_bindings == this->m_dynamic_bindings.end()) {
+            return;
+        }
+        auto bound_buffers = this->m_bound_buffers.find(set);
+        for (uint32_t binding : dynamic_bindings->second) {
+            uint32_t offset = 0;
+            if (bound_buffers != this->m_bound_buffers.end()) {
+                auto it = bound_buffers->second.find(binding);
+                if (it != bound_buffers->second.end() && it->second.type == buffer_type::ubo) {
+                    auto ubo = (uniform_buffer*)it->second.object;
+                    offset = ubo->get_dynamic_offset();
+                }
+            }
+            offsets.push_back(offset);
+        }
+    }
+    void pipeline::wait_for_descriptor_sets() {
+        if (this->m_descriptor_sets_bound.exchange(false)) {
+            renderer::wait_for_frames_in_flight();
         }
     }
     void pipeline::reload(bool descriptor_sets) {
@@ -83,6 +150,7 @@ namespace vkrollercoaster {
     }
     void pipeline::create_descriptor_sets() {
         this->m_push_constant_ranges.clear();
+        this->m_dynamic_bindings.clear();
         const auto& reflection_data = this->m_shader->get_reflection_data();
         for (const auto& push_constant : reflection_data.push_constant_buffers) {
             VkPushConstantRange range;
@@ -106,7 +174,11 @@ namespace vkrollercoaster {
                 set_binding.descriptorCount = resource_type.array_size;
                 switch (data.resource_type) {
                 case shader_resource_type::uniformbuffer:
-                    set_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                    if (resource_type.array_size != 1) {
+                        throw std::runtime_error("uniform buffer arrays are not supported!");
+                    }
+                    set_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                    this->m_dynamic_bindings[set].push_back(binding);
                     break;
                 case shader_resource_type::storagebuffer:
                     set_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -114,6 +186,9 @@ namespace vkrollercoaster {
                 case shader_resource_type::sampledimage:
                     set_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
                     break;
+                case shader_resource_type::storageimage:
+                    set_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                    break;
                 default:
                     throw std::runtime_error("invalid resource type!");
                 }
@@ -152,60 +227,73 @@ namespace vkrollercoaster {
             }
         }
     }
+    static VkFormat get_attribute_format(vertex_attribute_type type) {
+        switch (type) {
+        case vertex_attribute_type::FLOAT:
+            return VK_FORMAT_R32_SFLOAT;
+        case vertex_attribute_type::INT:
+            return VK_FORMAT_R32_SINT;
+        case vertex_attribute_type::VEC2:
+            return VK_FORMAT_R32G32_SFLOAT;
+        case vertex_attribute_type::IVEC2:
+            return VK_FORMAT_R32G32_SINT;
+        case vertex_attribute_type::VEC3:
+            return VK_FORMAT_R32G32B32_SFLOAT;
+        case vertex_attribute_type::IVEC3:
+            return VK_FORMAT_R32G32B32_SINT;
+        case vertex_attribute_type::VEC4:
+            return VK_FORMAT_R32G32B32A32_SFLOAT;
+        case vertex_attribute_type::IVEC4:
+            return VK_FORMAT_R32G32B32A32_SINT;
+        case vertex_attribute_type::BOOLEAN:
+            return VK_FORMAT_R8_UINT;
+        case vertex_attribute_type::UNORM16_VEC4:
+            return VK_FORMAT_R16G16B16A16_UNORM;
+        case vertex_attribute_type::SNORM16_VEC2:
+            return VK_FORMAT_R16G16_SNORM;
+        case vertex_attribute_type::HALF_VEC2:
+            return VK_FORMAT_R16G16_SFLOAT;
+        default:
+            throw std::runtime_error("invalid vertex attribute type!");
+        }
+    }
+    static void add_vertex_input_binding(
+        const vertex_input_data& input_layout, uint32_t binding, VkVertexInputRate input_rate,
+        std::vector<VkVertexInputBindingDescription>& bindings,
+        std::vector<VkVertexInputAttributeDescription>& attributes) {
+        if (input_layout.stride != 0) {
+            auto& binding_desc = bindings.emplace_back();
+            util::zero(binding_desc);
+            binding_desc.binding = binding;
+            binding_desc.stride = input_layout.stride;
+            binding_desc.inputRate = input_rate;
+        }
+        // locations continue on from the previous binding's attributes
+        for (const auto& attribute : input_layout.attributes) {
+            uint32_t location = attributes.size();
+            auto& attribute_desc = attributes.emplace_back();
+            util::zero(attribute_desc);
+            attribute_desc.binding = binding;
+            attribute_desc.location = location;
+            attribute_desc.offset = attribute.offset;
+            attribute_desc.format = get_attribute_format(attribute.type);
+        }
+    }
     void pipeline::create_pipeline() {
         VkDevice device = renderer::get_device();
         VkExtent2D extent = this->m_render_target->get_extent();
         VkPipelineVertexInputStateCreateInfo vertex_input_info;
         util::zero(vertex_input_info);
         vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        std::vector<VkVertexInputBindingDescription> bindings;
         std::vector<VkVertexInputAttributeDescription> attributes;
-        VkVertexInputBindingDescription binding;
-        util::zero(binding);
-        binding.binding = 0;
-        binding.stride = this->m_spec.input_layout.stride;
-        binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        if (binding.stride != 0) {
-            vertex_input_info.vertexBindingDescriptionCount = 1;
-            vertex_input_info.pVertexBindingDescriptions = &binding;
-        }
-        for (uint32_t i = 0; i < this->m_spec.input_layout.attributes.size(); i++) {
-            const auto& attribute = this->m_spec.input_layout.attributes[i];
-            auto& attribute_desc = attributes.emplace_back();
-            util::zero(attribute_desc);
-            attribute_desc.binding = 0;
-            attribute_desc.location = i;
-            attribute_desc.offset = attribute.offset;
-            switch (attribute.type) {
-            case vertex_attribute_type::FLOAT:
-                attribute_desc.format = VK_FORMAT_R32_SFLOAT;
-                break;
-            case vertex_attribute_type::INT:
-                attribute_desc.format = VK_FORMAT_R32_SINT;
-                break;
-            case vertex_attribute_type::VEC2:
-                attribute_desc.format = VK_FORMAT_R32G32_SFLOAT;
-                break;
-            case vertex_attribute_type::IVEC2:
-                attribute_desc.format = VK_FORMAT_R32G32_SINT;
-                break;
-            case vertex_attribute_type::VEC3:
-                attribute_desc.format = VK_FORMAT_R32G32B32_SFLOAT;
-                break;
-            case vertex_attribute_type::IVEC3:
-                attribute_desc.format = VK_FORMAT_R32G32B32_SINT;
-                break;
-            case vertex_attribute_type::VEC4:
-                attribute_desc.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-                break;
-            case vertex_attribute_type::IVEC4:
-                attribute_desc.format = VK_FORMAT_R32G32B32A32_SINT;
-                break;
-            case vertex_attribute_type::BOOLEAN:
-                attribute_desc.format = VK_FORMAT_R8_UINT;
-                break;
-            default:
-                throw std::runtime_error("invalid vertex attribute type!");
-            }
+        add_vertex_input_binding(this->m_spec.input_layout, 0, VK_VERTEX_INPUT_RATE_VERTEX,
+                                 bindings, attributes);
+        add_vertex_input_binding(this->m_spec.instance_input_layout, 1,
+                                 VK_VERTEX_INPUT_RATE_INSTANCE, bindings, attributes);
+        if (!bindings.empty()) {
+            vertex_input_info.vertexBindingDescriptionCount = bindings.size();
+            vertex_input_info.pVertexBindingDescriptions = bindings.data();
         }
         if (!attributes.empty()) {
             vertex_input_info.vertexAttributeDescriptionCount = attributes.size();
@@ -341,8 +429,8 @@ namespace vkrollercoaster {
         create_info.subpass = 0;
         create_info.basePipelineHandle = nullptr;
         create_info.basePipelineIndex = -1;
-        if (vkCreateGraphicsPipelines(device, nullptr, 1, &create_info, nullptr,
-                                      &this->m_pipeline) != VK_SUCCESS) {
+        if (vkCreateGraphicsPipelines(device, renderer::get_pipeline_cache(), 1, &create_info,
+                                      nullptr, &this->m_pipeline) != VK_SUCCESS) {
             throw std::runtime_error("could not create pipeline!");
         }
     }
@@ -358,6 +446,8 @@ namespace vkrollercoaster {
             vkFreeDescriptorSets(device, descriptor_pool, set.sets.size(), set.sets.data());
             vkDestroyDescriptorSetLayout(device, set.layout, nullptr);
         }
+        this->m_descriptor_sets.clear();
+        this->m_descriptor_sets_bound = false;
     }
     void pipeline::rebind_objects() {
         for (const auto& [set, bindings] : this->m_bound_buffers) {
@@ -29,14 +29,26 @@ namespace vkrollercoaster {
         VEC4,
         IVEC4,
         BOOLEAN,
+        // normalized to [0, 1] and [-1, 1] from 16-bit integers in the shader
+        UNORM16_VEC4,
+        SNORM16_VEC2,
+        HALF_VEC2,
     };
     struct vertex_attribute {
         vertex_attribute_type type;
         size_t offset;
+        bool operator==(const vertex_attribute& other) const {
+            return (this->type == other.type) && (this->offset == other.offset);
+        }
+        bool operator!=(const vertex_attribute& other) const { return !(*this == other); }
     };
     struct vertex_input_data {
         size_t stride = 0;
         std::vector<vertex_attribute> attributes;
+        bool operator==(const vertex_input_data& other) const {
+            return (this->stride == other.stride) && (this->attributes == other.attributes);
+        }
+        bool operator!=(const vertex_input_data& other) const { return !(*this == other); }
     };
     enum class pipeline_polygon_mode { fill, wireframe };
     enum class pipeline_front_face { clockwise, counter_clockwise };
@@ -48,6 +60,13 @@ namespace vkrollercoaster {
         pipeline_polygon_mode polygon_mode = pipeline_polygon_mode::fill;
         pipeline_front_face front_face = pipeline_front_face::clockwise;
         vertex_input_data input_layout;
+        // per-instance attributes, read from binding 1 and located after input_layout's
+        vertex_input_data instance_input_layout;
+        bool operator==(const pipeline_spec& other) const;
+        bool operator!=(const pipeline_spec& other) const { return !(*this == other); }
+        struct hash {
+            size_t operator()(const pipeline_spec& spec) const;
+        };
     };
     class uniform_buffer;
     class texture;
@@ -63,6 +82,8 @@ namespace vkrollercoaster {
         pipeline(const pipeline&) = delete;
         pipeline& operator=(const pipeline&) = delete;
         void bind(ref<command_buffer> cmdbuffer);
+        // must be called on the main thread each frame before bind is called from other threads
+        void prepare_for_recording();
         void reload(bool descriptor_sets = false);
         ref<shader> get_shader() { return this->m_shader; }
         ref<render_target> get_render_target() { return this->m_render_target; }
@@ -100,6 +121,10 @@ namespace vkrollercoaster {
                 }
             };
         };
+        void get_dynamic_offsets(uint32_t set, std::vector<uint32_t>& offsets);
+        // descriptor sets may not be rewritten while a frame that bound them is executing. this
+        // waits for frames in flight if the sets have been bound since the last wait
+        void wait_for_descriptor_sets();
         void create_descriptor_sets();
         void create_pipeline();
         void destroy_pipeline();
@@ -113,6 +138,9 @@ namespace vkrollercoaster {
         VkPipelineLayout m_layout;
         VkPipeline m_pipeline;
         std::map<uint32_t, descriptor_set> m_descriptor_sets;
+        // set when bound, which may happen on worker threads
+        std::atomic<bool> m_descriptor_sets_bound = false;
+        std::map<uint32_t, std::vector<uint32_t>> m_dynamic_bindings;
         std::vector<VkPushConstantRange> m_push_constant_ranges;
         std::unordered_map<texture_binding_desc, texture*, texture_binding_desc::hash>
             m_bound_textures;
@@ -16,11 +16,35 @@
 
 #include "pch.h"
 #define EXPOSE_RENDERER_INTERNALS
+#define EXPOSE_BUFFER_UTILS
+#define EXPOSE_IMAGE_UTILS
 #include "renderer.h"
 #include "util.h"
 #include "components.h"
 #include "allocator.h"
+#include "upload_queue.h"
+#include "track_mesh.h"
+#include "worker_pool.h"
+#include "asset_manager.h"
 namespace vkrollercoaster {
+    struct instance_buffer {
+        VkBuffer buffer = nullptr;
+        VmaAllocation allocation = nullptr;
+        instance_data* mapped = nullptr;
+        size_t capacity = 0;
+    };
+    struct frame_instance_data {
+        instance_buffer current;
+        size_t used = 0;
+        std::vector<instance_buffer> retired;
+    };
+
+    struct secondary_command_buffers {
+        VkCommandPool pool = nullptr;
+        std::vector<ref<command_buffer>> buffers;
+        size_t used = 0;
+    };
+
     static struct {
         // extensions and layers
         std::set<std::string> instance_extensions, device_extensions, layer_names;
@@ -34,19 +58,52 @@ namespace vkrollercoaster {
         VkQueue compute_queue = nullptr;
         VkDescriptorPool descriptor_pool = nullptr;
         VkCommandPool graphics_command_pool = nullptr;
+        VkPipelineCache pipeline_cache = nullptr;
+        bool pipeline_cache_loaded = false;
         std::array<sync_objects, renderer::max_frame_count> frame_sync_objects;
         size_t current_frame = 0;
+        uint64_t frame_number = 0;
+
+        // each frame slot records into its own command pool. render command buffers (and
+        // everything their submitted calls reference) are kept alive until the slot is reused
+        // and its fence has been waited on, at which point the pool is reset and the command
+        // buffer is recycled
+        std::array<VkCommandPool, renderer::max_frame_count> frame_command_pools;
+        std::array<ref<command_buffer>, renderer::max_frame_count> frame_command_buffers;
+
+        // secondary command buffers, recycled the same way. command pools can only be used by
+        // one thread at a time, so every frame slot has a pool per worker thread
+        std::array<std::vector<secondary_command_buffers>, renderer::max_frame_count>
+            frame_secondary_buffers;
+
+        // per-instance transforms for batched draws. a buffer that is outgrown mid-frame may
+        // still be read by that frame's earlier draws, so it is retired until the slot is reused
+        std::unique_ptr<allocator> instance_allocator;
+        std::array<frame_instance_data, renderer::max_frame_count> frame_instances;
         uint32_t vulkan_version = 0;
 
         // core graphics objects
         ref<texture> white_texture;
+        // sampled as the environment while no skybox is loaded
+        ref<texture> black_cube;
         ref<uniform_buffer> camera_buffer;
 
         // current skybox
         ref<skybox> _skybox;
 
-        // temp
-        ref<model> track_model;
+        // main camera frustum for culling, as inward-facing planes
+        std::array<glm::vec4, 6> frustum_planes;
+        bool frustum_valid = false;
+
+        // main camera position, and the projection's vertical scale, for level of detail
+        glm::vec3 camera_position = glm::vec3(0.f);
+        float projection_scale = 1.f;
+
+        // statistics of the frame being recorded, and of the last one
+        render_stats current_stats, last_stats;
+
+        // track geometry, extruded along the track nodes
+        ref<track_mesh> _track_mesh;
 
         // ref counting
         uint32_t ref_count = 0;
@@ -375,6 +432,130 @@ namespace vkrollercoaster {
                                 &renderer_data.graphics_command_pool) != VK_SUCCESS) {
             throw std::runtime_error("could not create command pool!");
         }
+
+        // one pool per frame slot for render command buffers
+        for (auto& pool : renderer_data.frame_command_pools) {
+            if (vkCreateCommandPool(renderer_data.device, &create_info, nullptr, &pool) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("could not create command pool!");
+            }
+        }
+
+        // and one per thread in each frame slot for secondary command buffers
+        size_t thread_count = worker_pool::get_thread_count();
+        for (auto& thread_buffers : renderer_data.frame_secondary_buffers) {
+            thread_buffers.resize(thread_count);
+            for (auto& secondary_buffers : thread_buffers) {
+                if (vkCreateCommandPool(renderer_data.device, &create_info, nullptr,
+                                        &secondary_buffers.pool) != VK_SUCCESS) {
+                    throw std::runtime_error("could not create command pool!");
+                }
+            }
+        }
+    }
+
+    // header written in front of the driver's cache data, so that a cache from a different
+    // device or driver version is never handed to the driver
+    struct pipeline_cache_header {
+        uint32_t magic;
+        uint32_t vendor_id, device_id, driver_version;
+        uint8_t cache_uuid[VK_UUID_SIZE];
+        uint64_t data_size;
+    };
+    static constexpr uint32_t pipeline_cache_magic = 0x43504b56; // "VKPC"
+
+    static fs::path get_pipeline_cache_path() {
+        return util::get_cache_directory() / "pipeline_cache.bin";
+    }
+
+    static void fill_pipeline_cache_header(pipeline_cache_header& header) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(renderer_data.physical_device, &properties);
+        util::zero(header);
+        header.magic = pipeline_cache_magic;
+        header.vendor_id = properties.vendorID;
+        header.device_id = properties.deviceID;
+        header.driver_version = properties.driverVersion;
+        memcpy(header.cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    }
+
+    static void read_pipeline_cache(std::vector<uint8_t>& data) {
+        fs::path path = get_pipeline_cache_path();
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            spdlog::info("no pipeline cache found - pipelines will be compiled from scratch");
+            return;
+        }
+        pipeline_cache_header expected, header;
+        fill_pipeline_cache_header(expected);
+        file.read((char*)&header, sizeof(pipeline_cache_header));
+        if (!file || header.magic != expected.magic || header.vendor_id != expected.vendor_id ||
+            header.device_id != expected.device_id ||
+            header.driver_version != expected.driver_version ||
+            memcmp(header.cache_uuid, expected.cache_uuid, VK_UUID_SIZE) != 0) {
+            spdlog::warn("pipeline cache {0} is stale or corrupt - discarding", path.string());
+            return;
+        }
+
+        // the size comes from disk, so make sure the file actually holds that much data
+        std::error_code error;
+        uintmax_t file_size = fs::file_size(path, error);
+        if (error || header.data_size > file_size - sizeof(pipeline_cache_header)) {
+            spdlog::warn("pipeline cache {0} is truncated - discarding", path.string());
+            return;
+        }
+        data.resize(header.data_size);
+        file.read((char*)data.data(), data.size());
+        if (!file) {
+            spdlog::warn("pipeline cache {0} is truncated - discarding", path.string());
+            data.clear();
+            return;
+        }
+        spdlog::info("loaded pipeline cache ({0} bytes)", data.size());
+    }
+
+    static void create_pipeline_cache() {
+        std::vector<uint8_t> data;
+        read_pipeline_cache(data);
+        VkPipelineCacheCreateInfo create_info;
+        util::zero(create_info);
+        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        if (!data.empty()) {
+            create_info.initialDataSize = data.size();
+            create_info.pInitialData = data.data();
+        }
+        renderer_data.pipeline_cache_loaded = !data.empty();
+        if (vkCreatePipelineCache(renderer_data.device, &create_info, nullptr,
+                                  &renderer_data.pipeline_cache) != VK_SUCCESS) {
+            throw std::runtime_error("could not create pipeline cache!");
+        }
+    }
+
+    static void write_pipeline_cache() {
+        size_t data_size = 0;
+        if (vkGetPipelineCacheData(renderer_data.device, renderer_data.pipeline_cache, &data_size,
+                                   nullptr) != VK_SUCCESS) {
+            spdlog::warn("could not retrieve pipeline cache data");
+            return;
+        }
+        std::vector<uint8_t> data(data_size);
+        if (vkGetPipelineCacheData(renderer_data.device, renderer_data.pipeline_cache, &data_size,
+                                   data.data()) != VK_SUCCESS) {
+            spdlog::warn("could not retrieve pipeline cache data");
+            return;
+        }
+        pipeline_cache_header header;
+        fill_pipeline_cache_header(header);
+        header.data_size = data_size;
+        fs::path path = get_pipeline_cache_path();
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            spdlog::warn("could not write pipeline cache to {0}", path.string());
+            return;
+        }
+        file.write((char*)&header, sizeof(pipeline_cache_header));
+        file.write((char*)data.data(), data_size);
+        spdlog::info("wrote pipeline cache ({0} bytes)", data_size);
     }
 
     static void create_sync_objects() {
@@ -397,6 +578,41 @@ namespace vkrollercoaster {
         }
     }
 
+    static void free_instance_buffer(const instance_buffer& buffer) {
+        renderer_data.instance_allocator->unmap(buffer.allocation);
+        renderer_data.instance_allocator->free(buffer.buffer, buffer.allocation);
+    }
+
+    static void release_retired_instance_buffers(frame_instance_data& frame_data) {
+        for (const auto& buffer : frame_data.retired) {
+            free_instance_buffer(buffer);
+        }
+        frame_data.retired.clear();
+        frame_data.used = 0;
+    }
+
+    // returns the index of the first of count instances reserved in the current frame's buffer
+    static size_t reserve_instances(size_t count) {
+        auto& frame_data = renderer_data.frame_instances[renderer_data.current_frame];
+        if (frame_data.used + count > frame_data.current.capacity) {
+            if (frame_data.current.buffer) {
+                frame_data.retired.push_back(frame_data.current);
+            }
+            instance_buffer& buffer = frame_data.current;
+            buffer.capacity = std::max(std::max(buffer.capacity * 2, count), (size_t)256);
+            create_buffer(*renderer_data.instance_allocator,
+                          buffer.capacity * sizeof(instance_data),
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+                          buffer.buffer, buffer.allocation);
+            void* mapped = renderer_data.instance_allocator->map(buffer.allocation);
+            buffer.mapped = (instance_data*)mapped;
+            frame_data.used = 0;
+        }
+        size_t first_instance = frame_data.used;
+        frame_data.used += count;
+        return first_instance;
+    }
+
     struct camera_buffer_data {
         glm::mat4 projection = glm::mat4(1.f);
         glm::mat4 view = glm::mat4(1.f);
@@ -418,8 +634,12 @@ namespace vkrollercoaster {
         create_logical_device();
         create_descriptor_pool();
         create_graphics_command_pool();
+        create_pipeline_cache();
         create_sync_objects();
         allocator::init();
+        upload_queue::init();
+        renderer_data.instance_allocator = std::make_unique<allocator>();
+        renderer_data.instance_allocator->set_source("instance buffer");
 
         // create white texture
         image_data white_data;
@@ -429,6 +649,30 @@ namespace vkrollercoaster {
         white_data.width = white_data.height = 1;
         renderer_data.white_texture = ref<texture>::create(ref<image2d>::create(white_data));
 
+        // create black environment cube
+        {
+            auto black_cube = ref<image_cube>::create(
+                VK_FORMAT_R8G8B8A8_UNORM, 1, 1,
+                VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT);
+            VkClearColorValue black;
+            util::zero(black);
+            VkImageSubresourceRange range;
+            util::zero(range);
+            range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            range.levelCount = 1;
+            range.layerCount = image_cube::cube_face_count;
+
+            auto cmdbuffer = create_single_time_command_buffer();
+            cmdbuffer->begin();
+            vkCmdClearColorImage(cmdbuffer->get(), black_cube->get_image(),
+                                 black_cube->get_layout(), &black, 1, &range);
+            cmdbuffer->end();
+            cmdbuffer->submit();
+            cmdbuffer->wait();
+            renderer_data.black_cube = ref<texture>::create(black_cube);
+        }
+
         // create global camera buffer
         renderer_data.camera_buffer = ref<uniform_buffer>::create(0, 0, sizeof(camera_buffer_data));
     }
@@ -442,6 +686,15 @@ namespace vkrollercoaster {
             vkDestroySemaphore(renderer_data.device, frame_data.image_available_semaphore, nullptr);
         }
         vkDestroyCommandPool(renderer_data.device, renderer_data.graphics_command_pool, nullptr);
+        for (VkCommandPool pool : renderer_data.frame_command_pools) {
+            vkDestroyCommandPool(renderer_data.device, pool, nullptr);
+        }
+        for (const auto& thread_buffers : renderer_data.frame_secondary_buffers) {
+            for (const auto& secondary_buffers : thread_buffers) {
+                vkDestroyCommandPool(renderer_data.device, secondary_buffers.pool, nullptr);
+            }
+        }
+        vkDestroyPipelineCache(renderer_data.device, renderer_data.pipeline_cache, nullptr);
         vkDestroyDescriptorPool(renderer_data.device, renderer_data.descriptor_pool, nullptr);
         vkDestroyDevice(renderer_data.device, nullptr);
         if (renderer_data.debug_messenger != nullptr) {
@@ -460,15 +713,37 @@ namespace vkrollercoaster {
     }
 
     void renderer::shutdown() {
+        vkDeviceWaitIdle(renderer_data.device);
+        for (auto& cmdbuffer : renderer_data.frame_command_buffers) {
+            cmdbuffer.reset();
+        }
+        for (auto& thread_buffers : renderer_data.frame_secondary_buffers) {
+            for (auto& secondary_buffers : thread_buffers) {
+                secondary_buffers.buffers.clear();
+            }
+        }
+
         renderer_data._skybox.reset();
         renderer_data.camera_buffer.reset();
         renderer_data.white_texture.reset();
-        if (renderer_data.track_model) {
-            renderer_data.track_model.reset();
+        renderer_data.black_cube.reset();
+        if (renderer_data._track_mesh) {
+            renderer_data._track_mesh.reset();
         }
 
+        for (auto& frame_data : renderer_data.frame_instances) {
+            release_retired_instance_buffers(frame_data);
+            if (frame_data.current.buffer) {
+                free_instance_buffer(frame_data.current);
+                frame_data.current = instance_buffer();
+            }
+        }
+        renderer_data.instance_allocator.reset();
+
+        upload_queue::shutdown();
         allocator::shutdown();
         vkDeviceWaitIdle(renderer_data.device);
+        write_pipeline_cache();
 
         renderer_data.should_shutdown = true;
         if (renderer_data.ref_count == 0) {
@@ -477,7 +752,47 @@ namespace vkrollercoaster {
     }
 
     void renderer::new_frame() {
-        renderer_data.current_frame = (renderer_data.current_frame + 1) % max_frame_count;
+        size_t current_frame = (renderer_data.current_frame + 1) % max_frame_count;
+        renderer_data.current_frame = current_frame;
+        renderer_data.frame_number++;
+
+        // wait for the frame that last used this slot, and recycle its command buffer
+        const auto& frame_sync_objects = renderer_data.frame_sync_objects[current_frame];
+        vkWaitForFences(renderer_data.device, 1, &frame_sync_objects.fence, true,
+                        std::numeric_limits<uint64_t>::max());
+        auto& cmdbuffer = renderer_data.frame_command_buffers[current_frame];
+        if (cmdbuffer) {
+            VkCommandPool pool = renderer_data.frame_command_pools[current_frame];
+            vkResetCommandPool(renderer_data.device, pool, 0);
+            cmdbuffer->recycle();
+        }
+        for (auto& secondary_buffers : renderer_data.frame_secondary_buffers[current_frame]) {
+            if (secondary_buffers.used == 0) {
+                continue;
+            }
+            vkResetCommandPool(renderer_data.device, secondary_buffers.pool, 0);
+            for (auto& secondary_buffer : secondary_buffers.buffers) {
+                secondary_buffer->recycle();
+            }
+            secondary_buffers.used = 0;
+        }
+        release_retired_instance_buffers(renderer_data.frame_instances[current_frame]);
+
+        renderer_data.last_stats = renderer_data.current_stats;
+        renderer_data.current_stats = render_stats();
+    }
+
+    void renderer::wait_for_frames_in_flight() {
+        // the current slot's fence was waited on in new_frame, and is only reset once its
+        // swapchain image is acquired
+        std::vector<VkFence> fences;
+        for (size_t i = 0; i < max_frame_count; i++) {
+            if (i != renderer_data.current_frame) {
+                fences.push_back(renderer_data.frame_sync_objects[i].fence);
+            }
+        }
+        vkWaitForFences(renderer_data.device, fences.size(), fences.data(), true,
+                        std::numeric_limits<uint64_t>::max());
     }
 
     void renderer::add_ref() { renderer_data.ref_count++; }
@@ -488,71 +803,202 @@ namespace vkrollercoaster {
         }
     }
 
-    static void render_model(ref<command_buffer> cmdbuffer, const transform_component& transform,
-                             ref<model> _model, internal_cmdbuffer_data* internal_data) {
-        auto target = cmdbuffer->get_current_render_target();
-        if (!target) {
-            throw std::runtime_error("cannot render outside of a render pass!");
-        }
-        // calculate transformation matrices
-        struct {
-            glm::mat4 model, normal;
-        } push_constant_data;
-        push_constant_data.normal = glm::toMat4(glm::quat(transform.rotation));
-        push_constant_data.model = glm::translate(glm::mat4(1.f), transform.translation) *
-                                   push_constant_data.normal *
-                                   glm::scale(glm::mat4(1.f), transform.scale);
+    // a draw resolved on the main thread, which can be recorded on any thread. the objects it
+    // points to are kept alive by the submitted calls of the primary command buffer
+    struct draw_command {
+        pipeline* _pipeline;
+        vertex_buffer* vbo;
+        index_buffer* ibo;
+        VkViewport viewport;
+        VkRect2D scissor;
+        uint32_t first_index, index_count;
+        uint32_t first_instance, instance_count;
+    };
 
+    static void prepare_draws(ref<render_target> target, const instance_batch& batch,
+                              uint32_t first_instance, internal_cmdbuffer_data* internal_data,
+                              std::vector<draw_command>& draws) {
+        ref<model> _model = batch._model;
+        uint32_t instance_count = (uint32_t)batch.instances.size();
         const auto& buffer_data = _model->get_buffers();
         const auto& materials = _model->get_materials();
         for (const auto& [material_index, ibo] : buffer_data.indices) {
-            // create pipeline
+            std::vector<index_range> ranges;
+            if (batch.ranges.empty()) {
+                ranges.push_back(buffer_data.index_ranges.at(material_index)[batch.lod]);
+            } else {
+                auto it = batch.ranges.find(material_index);
+                if (it == batch.ranges.end()) {
+                    continue;
+                }
+                ranges = it->second;
+            }
+
+            // get pipeline
             ref<pipeline> _pipeline;
             {
                 pipeline_spec spec;
 
                 spec.input_layout = _model->get_input_layout();
+                spec.instance_input_layout.stride = sizeof(instance_data);
+                for (size_t i = 0; i < 8; i++) {
+                    spec.instance_input_layout.attributes.push_back(
+                        { vertex_attribute_type::VEC4, i * sizeof(glm::vec4) });
+                }
                 spec.enable_blending = true;
                 spec.enable_depth_testing = true;
 
                 ref<material> _material = materials[material_index];
-                _pipeline = _material->create_pipeline(target, spec);
+                _pipeline = _material->get_pipeline(target, spec, _model->get_shader_variant());
+            }
+            _pipeline->prepare_for_recording();
+
+            draw_command draw;
+            draw._pipeline = _pipeline.raw();
+            draw.vbo = buffer_data.vertices.raw();
+            draw.ibo = ibo.raw();
+            draw.first_instance = first_instance;
+            draw.instance_count = instance_count;
+
+            // flip the viewport, so that +y is up
+            draw.scissor = _pipeline->get_scissor();
+            draw.viewport = _pipeline->get_viewport();
+            draw.viewport.y = (float)target->get_extent().height - draw.viewport.y;
+            draw.viewport.height *= -1.f;
+
+            for (const auto& range : ranges) {
+                draw.first_index = (uint32_t)range.offset;
+                draw.index_count = (uint32_t)range.count;
+                draws.push_back(draw);
+                renderer_data.current_stats.draw_calls++;
+                renderer_data.current_stats.triangles += draw.index_count / 3 * instance_count;
             }
-
-            // set scissor
-            VkRect2D scissor = _pipeline->get_scissor();
-            vkCmdSetScissor(cmdbuffer->get(), 0, 1, &scissor);
-
-            // set viewport
-            VkViewport viewport = _pipeline->get_viewport();
-            viewport.y = (float)target->get_extent().height - viewport.y;
-            viewport.height *= -1.f;
-            vkCmdSetViewport(cmdbuffer->get(), 0, 1, &viewport);
-
-            // bind pipeline
-            _pipeline->bind(cmdbuffer);
-
-            // set vertex data
-            buffer_data.vertices->bind(cmdbuffer);
-            ibo->bind(cmdbuffer);
-
-            // push constants
-            vkCmdPushConstants(cmdbuffer->get(), _pipeline->get_layout(),
-                               VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_constant_data),
-                               &push_constant_data);
-
-            // render
-            vkCmdDrawIndexed(cmdbuffer->get(), ibo->get_index_count(), 1, 0, 0, 0);
 
             submitted_render_call submitted_call;
             submitted_call._pipeline = _pipeline;
             submitted_call.vbo = buffer_data.vertices;
             submitted_call.ibo = ibo;
+            submitted_call._material = materials[material_index];
             submitted_call._skybox = renderer_data._skybox;
             internal_data->submitted_calls.push_back(submitted_call);
         }
     }
 
+    // only touches the passed command buffer, so it is safe to call from worker threads
+    static void record_draws(const ref<command_buffer>& cmdbuffer, VkBuffer instance_buffer,
+                             const draw_command* draws, size_t draw_count) {
+        VkCommandBuffer vk_cmdbuffer = cmdbuffer->get();
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(vk_cmdbuffer, 1, 1, &instance_buffer, &offset);
+
+        for (size_t i = 0; i < draw_count; i++) {
+            const auto& draw = draws[i];
+            vkCmdSetScissor(vk_cmdbuffer, 0, 1, &draw.scissor);
+            vkCmdSetViewport(vk_cmdbuffer, 0, 1, &draw.viewport);
+            draw._pipeline->bind(cmdbuffer);
+            draw.vbo->bind(cmdbuffer);
+            draw.ibo->bind(cmdbuffer);
+            vkCmdDrawIndexed(vk_cmdbuffer, draw.index_count, draw.instance_count, draw.first_index,
+                             0, draw.first_instance);
+        }
+    }
+
+    static bool is_visible(const glm::vec3& center, float radius) {
+        if (!renderer_data.frustum_valid) {
+            return true;
+        }
+
+        // test the bounding sphere in world space against each plane
+        for (const auto& plane : renderer_data.frustum_planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // each level of detail is drawn below half the screen size of the last, starting at
+    // lod_screen_size of the screen's height. the level only changes once the size is
+    // lod_hysteresis past a threshold, so that models don't flicker between two levels
+    static constexpr float lod_screen_size = 0.5f;
+    static constexpr float lod_hysteresis = 0.1f;
+    static size_t get_lod_for_size(float screen_size, size_t lod_count) {
+        if (screen_size <= 0.f) {
+            return lod_count - 1;
+        }
+        float level = glm::floor(glm::log2(lod_screen_size / screen_size)) + 1.f;
+        return (size_t)glm::clamp(level, 0.f, (float)(lod_count - 1));
+    }
+    static void select_lod(ref<model> _model, const glm::vec3& center, float radius,
+                           size_t& lod) {
+        size_t lod_count = _model->get_lod_count();
+        if (lod_count < 2 || !renderer_data.frustum_valid) {
+            lod = 0;
+            return;
+        }
+
+        // projected diameter of the bounding sphere, relative to the screen's height
+        float distance = glm::distance(center, renderer_data.camera_position);
+        float screen_size = std::numeric_limits<float>::max();
+        if (distance > radius) {
+            screen_size = radius * renderer_data.projection_scale / distance;
+        }
+        size_t finest = get_lod_for_size(screen_size * (1.f + lod_hysteresis), lod_count);
+        size_t coarsest = get_lod_for_size(screen_size * (1.f - lod_hysteresis), lod_count);
+        lod = std::clamp(lod, finest, coarsest);
+    }
+
+    static void queue_instance(ref<command_buffer> cmdbuffer, ref<model> _model,
+                               const transform_component& transform,
+                               internal_cmdbuffer_data* internal_data, size_t& lod) {
+        if (!cmdbuffer->get_current_render_target()) {
+            throw std::runtime_error("cannot render outside of a render pass!");
+        }
+
+        // models whose source is still loading have nothing to draw yet
+        if (!_model->get_buffers().vertices) {
+            return;
+        }
+
+        // calculate transformation matrices
+        instance_data instance;
+        instance.normal = glm::toMat4(glm::quat(transform.rotation));
+        instance.model = glm::translate(glm::mat4(1.f), transform.translation) * instance.normal *
+                         glm::scale(glm::mat4(1.f), transform.scale);
+
+        // bounding sphere in world space
+        const auto& bounds = _model->get_bounds();
+        glm::vec3 center = instance.model * glm::vec4(bounds.center, 1.f);
+        glm::vec3 scale = glm::abs(transform.scale);
+        float radius = bounds.radius * std::max(std::max(scale.x, scale.y), scale.z);
+        if (!bounds.empty() && !is_visible(center, radius)) {
+            renderer_data.current_stats.culled_instances++;
+            return;
+        }
+        renderer_data.current_stats.submitted_instances++;
+        if (bounds.empty()) {
+            lod = 0;
+        } else {
+            select_lod(_model, center, radius, lod);
+        }
+
+        // packed positions are dequantized by the model matrix, after culling against the
+        // unquantized bounds
+        instance.model *= _model->get_position_transform();
+
+        // models that share a vertex buffer were created from the same source in the same
+        // format, and so share index buffers and materials too. they can be drawn in one batch
+        // per level of detail
+        auto batch_key = std::make_pair((void*)_model->get_buffers().vertices.raw(), lod);
+        auto it = internal_data->batch_indices.find(batch_key);
+        if (it == internal_data->batch_indices.end()) {
+            size_t index = internal_data->batches.size();
+            internal_data->batches.push_back({ _model, lod });
+            it = internal_data->batch_indices.insert({ batch_key, index }).first;
+        }
+        internal_data->batches[it->second].instances.push_back(instance);
+    }
+
     void renderer::render_entity(ref<command_buffer> cmdbuffer, entity to_render) {
         if (!to_render.has_component<transform_component>() ||
             !to_render.has_component<model_component>()) {
@@ -560,64 +1006,154 @@ namespace vkrollercoaster {
                 "the given entity does not have necessary components for rendering!");
         }
 
-        ref<model> _model = to_render.get_component<model_component>().data;
+        auto& component = to_render.get_component<model_component>();
         const auto& transform = to_render.get_component<transform_component>();
 
-        render_model(cmdbuffer, transform, _model, cmdbuffer->m_internal_data);
+        queue_instance(cmdbuffer, component.data, transform, cmdbuffer->m_internal_data,
+                       component.lod);
     }
 
     void renderer::render_track(ref<command_buffer> cmdbuffer, entity track) {
-        if (!renderer_data.track_model) {
-            auto source = ref<model_source>::create("assets/models/track.gltf");
-            renderer_data.track_model = ref<model>::create(source);
+        if (!renderer_data._track_mesh) {
+            auto tile = asset_manager::load_model_source("assets/models/track.gltf");
+            if (!tile) {
+                throw std::runtime_error("could not load the track tile model!");
+            }
+            renderer_data._track_mesh = ref<track_mesh>::create(tile);
         }
 
-        entity current_track = track;
-        std::unordered_set<entity> rendererd_entities;
-        while (rendererd_entities.find(current_track) == rendererd_entities.end()) {
-            if (!current_track.has_component<transform_component>() ||
-                !current_track.has_component<track_segment_component>()) {
-                throw std::runtime_error("this track node does not have the necessary components!");
-            }
-            const auto& entity_transform = current_track.get_component<transform_component>();
-            const auto& track_data = current_track.get_component<track_segment_component>();
+        // the whole track is a single model in world space, split into chunks that are culled
+        // and given a level of detail on their own
+        renderer_data._track_mesh->update(track);
+        ref<model> track_model = renderer_data._track_mesh->get_model();
+        if (!track_model) {
+            return;
+        }
+        if (!cmdbuffer->get_current_render_target()) {
+            throw std::runtime_error("cannot render outside of a render pass!");
+        }
 
-            transform_component transform;
-            transform.translation = entity_transform.translation;
-            if (track_data.next) {
-                glm::vec3 next_translation =
-                    track_data.next.get_component<transform_component>().translation;
-                glm::vec3 direction = glm::normalize(next_translation - transform.translation);
+        // every chunk's meshes are stored in order within each level of detail, so neighboring
+        // chunks at the same level are drawn as one range
+        instance_batch batch;
+        batch._model = track_model;
+        batch.lod = 0;
+        const auto& meshes = track_model->get_meshes();
+        const auto& mesh_ranges = track_model->get_buffers().mesh_ranges;
+        for (auto& _chunk : renderer_data._track_mesh->get_chunks()) {
+            if (!_chunk.bounds.empty() && !is_visible(_chunk.bounds.center, _chunk.bounds.radius)) {
+                renderer_data.current_stats.culled_instances++;
+                continue;
+            }
+            renderer_data.current_stats.submitted_instances++;
+            select_lod(track_model, _chunk.bounds.center, _chunk.bounds.radius, _chunk.lod);
+
+            for (size_t i = _chunk.first_mesh; i < _chunk.first_mesh + _chunk.mesh_count; i++) {
+                index_range range = mesh_ranges[i][_chunk.lod];
+                auto& ranges = batch.ranges[meshes[i].material_index];
+                if (!ranges.empty() && ranges.back().offset + ranges.back().count == range.offset) {
+                    ranges.back().count += range.count;
+                } else {
+                    ranges.push_back(range);
+                }
+            }
+        }
+        if (batch.ranges.empty()) {
+            return;
+        }
 
-                glm::vec3 rotation = glm::vec3(0.f);
+        instance_data instance;
+        instance.normal = glm::mat4(1.f);
+        instance.model = track_model->get_position_transform();
+        batch.instances.push_back(instance);
+        cmdbuffer->m_internal_data->batches.push_back(std::move(batch));
+    }
 
-                rotation.x = -glm::asin(direction.y);
-                float adjacent = glm::cos(rotation.x);
-                rotation.y = glm::atan(direction.x / adjacent, direction.z / adjacent);
+    void renderer::draw_batches(ref<command_buffer> cmdbuffer) {
+        auto internal_data = cmdbuffer->m_internal_data;
+        if (internal_data->batches.empty()) {
+            return;
+        }
+        auto target = cmdbuffer->get_current_render_target();
+        if (!target) {
+            throw std::runtime_error("cannot render outside of a render pass!");
+        }
 
-                transform.rotation = rotation;
-            } else {
-                transform.rotation = entity_transform.rotation;
-            }
-            transform.scale = entity_transform.scale;
+        // copy every queued transform into the frame's instance buffer at once, and resolve
+        // pipelines on this thread
+        size_t instance_count = 0;
+        for (const auto& batch : internal_data->batches) {
+            instance_count += batch.instances.size();
+        }
+        size_t first_instance = reserve_instances(instance_count);
+        const auto& buffer = renderer_data.frame_instances[renderer_data.current_frame].current;
+        std::vector<draw_command> draws;
+        for (const auto& batch : internal_data->batches) {
+            size_t count = batch.instances.size();
+            memcpy(buffer.mapped + first_instance, batch.instances.data(),
+                   count * sizeof(instance_data));
+            prepare_draws(target, batch, first_instance, internal_data, draws);
+            first_instance += count;
+        }
+        internal_data->batches.clear();
+        internal_data->batch_indices.clear();
 
-            // todo: build model or something
+        if (!cmdbuffer->has_secondary_contents()) {
+            record_draws(cmdbuffer, buffer.buffer, draws.data(), draws.size());
+            return;
+        }
 
-            render_model(cmdbuffer, transform, renderer_data.track_model,
-                         cmdbuffer->m_internal_data);
-            rendererd_entities.insert(current_track);
+        // split the draws into contiguous chunks, each recorded into a secondary command buffer
+        // by its own thread. small draw lists are not worth waking every thread for
+        static constexpr size_t min_draws_per_thread = 16;
+        size_t chunk_count = (draws.size() + min_draws_per_thread - 1) / min_draws_per_thread;
+        chunk_count = std::min(chunk_count, worker_pool::get_thread_count());
+        std::vector<ref<command_buffer>> secondary_buffers;
+        for (size_t i = 0; i < chunk_count; i++) {
+            auto secondary_buffer = create_secondary_command_buffer(i);
+            secondary_buffer->begin(target);
+            secondary_buffers.push_back(secondary_buffer);
+        }
 
-            current_track = track_data.next;
-            if (!current_track) {
-                break;
+        VkBuffer instance_buffer = buffer.buffer;
+        worker_pool::dispatch([&](size_t thread_index) {
+            if (thread_index >= chunk_count) {
+                return;
             }
+            size_t begin = draws.size() * thread_index / chunk_count;
+            size_t end = draws.size() * (thread_index + 1) / chunk_count;
+            record_draws(secondary_buffers[thread_index], instance_buffer, draws.data() + begin,
+                         end - begin);
+        });
+
+        for (auto& secondary_buffer : secondary_buffers) {
+            secondary_buffer->end();
         }
+        cmdbuffer->execute(secondary_buffers);
     }
 
     ref<command_buffer> renderer::create_render_command_buffer() {
-        auto instance = new command_buffer(renderer_data.graphics_command_pool,
-                                           renderer_data.graphics_queue, false, true);
-        return ref<command_buffer>(instance);
+        size_t current_frame = renderer_data.current_frame;
+        auto& cmdbuffer = renderer_data.frame_command_buffers[current_frame];
+        if (!cmdbuffer) {
+            auto instance = new command_buffer(renderer_data.frame_command_pools[current_frame],
+                                               renderer_data.graphics_queue, false, true);
+            cmdbuffer = ref<command_buffer>(instance);
+        } else if (cmdbuffer->m_recorded || cmdbuffer->m_recording) {
+            throw std::runtime_error("a render command buffer was already created this frame!");
+        }
+        return cmdbuffer;
+    }
+
+    ref<command_buffer> renderer::create_secondary_command_buffer(size_t thread_index) {
+        auto& thread_buffers = renderer_data.frame_secondary_buffers[renderer_data.current_frame];
+        auto& secondary_buffers = thread_buffers[thread_index];
+        if (secondary_buffers.used == secondary_buffers.buffers.size()) {
+            auto instance = new command_buffer(secondary_buffers.pool, renderer_data.graphics_queue,
+                                               false, false, true);
+            secondary_buffers.buffers.push_back(ref<command_buffer>(instance));
+        }
+        return secondary_buffers.buffers[secondary_buffers.used++];
     }
 
     ref<command_buffer> renderer::create_single_time_command_buffer() {
@@ -633,7 +1169,10 @@ namespace vkrollercoaster {
     VkQueue renderer::get_graphics_queue() { return renderer_data.graphics_queue; }
     VkQueue renderer::get_compute_queue() { return renderer_data.compute_queue; }
     VkDescriptorPool renderer::get_descriptor_pool() { return renderer_data.descriptor_pool; }
+    VkPipelineCache renderer::get_pipeline_cache() { return renderer_data.pipeline_cache; }
+    bool renderer::is_pipeline_cache_loaded() { return renderer_data.pipeline_cache_loaded; }
     ref<texture> renderer::get_white_texture() { return renderer_data.white_texture; }
+    ref<texture> renderer::get_black_cube() { return renderer_data.black_cube; }
 
     ref<uniform_buffer> renderer::get_camera_buffer() { return renderer_data.camera_buffer; }
     void renderer::update_camera_buffer(ref<scene> _scene, ref<window> _window) {
@@ -645,6 +1184,31 @@ namespace vkrollercoaster {
 
             const auto& transform = main_camera.get_component<transform_component>();
             data.position = transform.translation;
+
+            // gribb/hartmann plane extraction. depth is in [0, 1], so the near plane is the
+            // third row on its own
+            glm::mat4 view_projection = data.projection * data.view;
+            glm::vec4 rows[4];
+            for (glm::length_t i = 0; i < 4; i++) {
+                rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i],
+                                    view_projection[2][i], view_projection[3][i]);
+            }
+            auto& planes = renderer_data.frustum_planes;
+            planes[0] = rows[3] + rows[0]; // left
+            planes[1] = rows[3] - rows[0]; // right
+            planes[2] = rows[3] + rows[1]; // bottom
+            planes[3] = rows[3] - rows[1]; // top
+            planes[4] = rows[2];           // near
+            planes[5] = rows[3] - rows[2]; // far
+            for (auto& plane : planes) {
+                plane /= glm::length(glm::vec3(plane));
+            }
+            renderer_data.frustum_valid = true;
+
+            renderer_data.camera_position = transform.translation;
+            renderer_data.projection_scale = data.projection[1][1];
+        } else {
+            renderer_data.frustum_valid = false;
         }
         renderer_data.camera_buffer->set_data(data);
     }
@@ -660,6 +1224,8 @@ namespace vkrollercoaster {
                            camera_data.up);
     }
 
+    const render_stats& renderer::get_render_stats() { return renderer_data.last_stats; }
+
     ref<skybox> renderer::get_skybox() { return renderer_data._skybox; }
     bool renderer::load_skybox(const fs::path& path) {
         if (!fs::exists(path)) {
@@ -668,6 +1234,7 @@ namespace vkrollercoaster {
 
         auto img = ref<image_cube>::create(path);
         renderer_data._skybox = ref<skybox>::create(img);
+        material::update_environments();
 
         return true;
     }
@@ -701,6 +1268,19 @@ namespace vkrollercoaster {
                 break;
             }
         }
+
+        // prefer a transfer-only family for uploads, so that copies can overlap rendering
+        for (uint32_t i = 0; i < queue_families.size(); i++) {
+            VkQueueFlags flags = queue_families[i].queueFlags;
+            if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+                !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                indices.transfer_family = i;
+                break;
+            }
+        }
+        if (!indices.transfer_family.has_value()) {
+            indices.transfer_family = indices.graphics_family;
+        }
         return indices;
     }
 
@@ -709,4 +1289,10 @@ namespace vkrollercoaster {
     }
 
     size_t renderer::get_current_frame() { return renderer_data.current_frame; }
+    uint64_t renderer::get_frame_number() { return renderer_data.frame_number; }
+
+    void renderer::add_submitted_call(ref<command_buffer> cmdbuffer,
+                                      const submitted_render_call& call) {
+        cmdbuffer->m_internal_data->submitted_calls.push_back(call);
+    }
 }; // namespace vkrollercoaster
\ No newline at end of file
@@ -21,11 +21,13 @@
 #include "texture.h"
 #include "buffers.h"
 #include "pipeline.h"
+#include "material.h"
+#include "model.h"
 #include "skybox.h"
 namespace vkrollercoaster {
 #ifdef EXPOSE_RENDERER_INTERNALS
     struct queue_family_indices {
-        std::optional<uint32_t> graphics_family, compute_family;
+        std::optional<uint32_t> graphics_family, compute_family, transfer_family;
         bool complete() const {
             const std::vector<bool> families_found = {
                 this->graphics_family.has_value(),
@@ -39,7 +41,7 @@ namespace vkrollercoaster {
             return true;
         }
         std::set<uint32_t> create_set() const {
-            return { *this->graphics_family, *this->compute_family };
+            return { *this->graphics_family, *this->compute_family, *this->transfer_family };
         }
     };
     struct sync_objects {
@@ -51,12 +53,38 @@ namespace vkrollercoaster {
         ref<pipeline> _pipeline;
         ref<vertex_buffer> vbo;
         ref<index_buffer> ibo;
+        ref<material> _material;
         ref<skybox> _skybox;
     };
+    struct instance_data {
+        glm::mat4 model, normal;
+    };
+    struct instance_batch {
+        ref<model> _model;
+        size_t lod;
+        std::vector<instance_data> instances;
+        // if not empty, the ranges of each material's index buffer to draw, in place of the
+        // whole level of detail
+        std::map<size_t, std::vector<index_range>> ranges;
+    };
     struct internal_cmdbuffer_data {
         std::vector<submitted_render_call> submitted_calls;
+
+        // instances queued by render_entity and render_track, in the order their models were
+        // first queued
+        std::vector<instance_batch> batches;
+        std::map<std::pair<void*, size_t>, size_t> batch_indices;
+
+        // secondary command buffers executed by this one
+        std::vector<ref<command_buffer>> executed_buffers;
     };
 #endif
+    struct render_stats {
+        uint32_t submitted_instances = 0;
+        uint32_t culled_instances = 0;
+        uint32_t draw_calls = 0;
+        uint32_t triangles = 0;
+    };
     class renderer {
     public:
         renderer() = delete;
@@ -68,14 +96,27 @@ namespace vkrollercoaster {
         static void init(uint32_t vulkan_version = VK_API_VERSION_1_0);
         static void shutdown();
         static void new_frame();
+        // waits until the gpu is done with every frame in flight but the one being recorded.
+        // it must not be called after the current frame's swapchain image has been acquired
+        static void wait_for_frames_in_flight();
 
+        // these queue instances of the entity's model, unless they are outside of the main
+        // camera's view. each instance is drawn at a level of detail picked from its size on
+        // screen. instances that share a model and level are drawn together, one draw per
+        // material, when draw_batches is called. if the current render pass takes secondary
+        // command buffers, the draws are recorded on the worker threads in parallel
         static void render_entity(ref<command_buffer> cmdbuffer, entity to_render);
         static void render_track(ref<command_buffer> cmdbuffer, entity track);
+        static void draw_batches(ref<command_buffer> cmdbuffer);
 
         static void add_ref();
         static void remove_ref();
 
+        // returns the current frame slot's render command buffer, recycled once per frame
         static ref<command_buffer> create_render_command_buffer();
+        // returns a secondary command buffer from the given thread's pool, recycled once per
+        // frame. it must only be recorded on that thread
+        static ref<command_buffer> create_secondary_command_buffer(size_t thread_index = 0);
         static ref<command_buffer> create_single_time_command_buffer();
 
         static uint32_t get_vulkan_version();
@@ -85,12 +126,20 @@ namespace vkrollercoaster {
         static VkQueue get_graphics_queue();
         static VkQueue get_compute_queue();
         static VkDescriptorPool get_descriptor_pool();
+        static VkPipelineCache get_pipeline_cache();
+        // whether pipeline cache data from an earlier launch was handed to the driver
+        static bool is_pipeline_cache_loaded();
         static ref<texture> get_white_texture();
+        // a 1x1 black cube map, for environment bindings while no skybox is loaded
+        static ref<texture> get_black_cube();
 
         static ref<uniform_buffer> get_camera_buffer();
         static void update_camera_buffer(ref<scene> _scene, ref<window> _window);
         static void calculate_camera_matrices(entity camera, float aspect_ratio, glm::mat4& projection, glm::mat4& view);
 
+        // statistics of the last completed frame
+        static const render_stats& get_render_stats();
+
         static ref<skybox> get_skybox();
         static bool load_skybox(const fs::path& path);
 
@@ -101,6 +150,9 @@ namespace vkrollercoaster {
         static queue_family_indices find_queue_families(VkPhysicalDevice device);
         static const sync_objects& get_sync_objects(size_t frame_index);
         static size_t get_current_frame();
+        static uint64_t get_frame_number();
+        static void add_submitted_call(ref<command_buffer> cmdbuffer,
+                                       const submitted_render_call& call);
 
         static constexpr size_t max_frame_count = 2;
 #endif
@@ -19,6 +19,9 @@
 #include "renderer.h"
 #include "util.h"
 #include "pipeline.h"
+#include "shader_cache.h"
+#include "worker_pool.h"
+#include "file_watcher.h"
 #include <shaderc/shaderc.hpp>
 #include <spirv_cross.hpp>
 namespace vkrollercoaster {
@@ -47,24 +50,62 @@ namespace vkrollercoaster {
         return language_map[extension];
     }
     shader::shader(const fs::path& path) : shader(path, determine_language(path)) {}
-    shader::shader(const fs::path& path, shader_language language) {
+    shader::shader(const fs::path& path, shader_language language)
+        : shader(path, language, true) {}
+    shader::shader(const fs::path& path, shader_language language, bool create) {
         this->m_path = path;
         this->m_language = language;
         renderer::add_ref();
-        this->create();
+        if (create) {
+            this->create();
+        }
     }
     shader::~shader() {
         this->destroy();
         renderer::remove_ref();
     }
     void shader::reload() {
+        // frames in flight may still be using the pipelines that are about to be destroyed
+        vkDeviceWaitIdle(renderer::get_device());
+        this->begin_reload();
+        this->create();
+        this->end_reload();
+    }
+    void shader::reload_all(const std::vector<ref<shader>>& shaders) {
+        vkDeviceWaitIdle(renderer::get_device());
+        std::vector<shader*> raw_shaders;
+        for (const auto& _shader : shaders) {
+            _shader->begin_reload();
+            raw_shaders.push_back(_shader.raw());
+        }
+        std::vector<shader_compile_result> results;
+        compile_parallel(raw_shaders, results);
+        for (size_t i = 0; i < shaders.size(); i++) {
+            shaders[i]->apply(results[i]);
+            shaders[i]->end_reload();
+        }
+    }
+    void shader::compile_parallel(const std::vector<shader*>& shaders,
+                                  std::vector<shader_compile_result>& results) {
+        // compilation and reflection only touch the shader being compiled, so every thread just
+        // takes the next shader in line until there are none left
+        results.resize(shaders.size());
+        std::atomic<size_t> next_shader = 0;
+        worker_pool::dispatch([&](size_t thread_index) {
+            size_t index;
+            while ((index = next_shader++) < shaders.size()) {
+                shaders[index]->compile(results[index]);
+            }
+        });
+    }
+    void shader::begin_reload() {
         for (auto _pipeline : this->m_dependents) {
             _pipeline->destroy_pipeline();
             _pipeline->destroy_descriptor_sets();
         }
         this->destroy();
-        this->m_reflection_data.reset();
-        this->create();
+    }
+    void shader::end_reload() {
         for (auto _pipeline : this->m_dependents) {
             _pipeline->create_descriptor_sets();
             _pipeline->rebind_objects();
@@ -72,11 +113,15 @@ namespace vkrollercoaster {
         }
     }
     void shader::create() {
-        std::map<shader_stage, std::vector<uint32_t>> spirv;
-        this->compile(spirv);
+        shader_compile_result result;
+        this->compile(result);
+        this->apply(result);
+    }
+    void shader::apply(shader_compile_result& result) {
+        this->m_reflection_data.assign(std::move(result.reflection_data));
+        this->m_included_files = std::move(result.included_files);
         VkDevice device = renderer::get_device();
-        for (const auto& [stage, data] : spirv) {
-            this->reflect(data, stage);
+        for (const auto& [stage, data] : result.spirv) {
             VkShaderModuleCreateInfo module_create_info;
             util::zero(module_create_info);
             module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -94,6 +139,18 @@ namespace vkrollercoaster {
         }
     }
     class file_includer : public shaderc::CompileOptions::IncluderInterface {
+    public:
+        file_includer(std::set<std::string>* included_files,
+                      std::map<std::string, uint64_t>* include_hashes) {
+            this->m_included_files = included_files;
+            this->m_include_hashes = include_hashes;
+        }
+
+        // whether a file was included again with different contents, in which case the compiled
+        // stages don't agree on what they included
+        bool includes_changed() const { return this->m_includes_changed; }
+
+    private:
         struct included_file_info {
             std::string content, path;
         };
@@ -118,6 +175,15 @@ namespace vkrollercoaster {
             auto file_info = new included_file_info;
             file_info->path = requested_path.string();
             file_info->content = util::read_file(requested_path);
+            this->m_included_files->insert(file_info->path);
+
+            // the cache validates includes against the contents that were compiled, not against
+            // whatever is on disk by the time the entry is written
+            uint64_t hash = util::hash_data(file_info->content);
+            auto [it, inserted] = this->m_include_hashes->insert({ file_info->path, hash });
+            if (!inserted && it->second != hash) {
+                this->m_includes_changed = true;
+            }
 
             // return result
             auto result = new shaderc_include_result;
@@ -133,6 +199,10 @@ namespace vkrollercoaster {
             delete (included_file_info*)data->user_data;
             delete data;
         }
+
+        std::set<std::string>* m_included_files;
+        std::map<std::string, uint64_t>* m_include_hashes;
+        bool m_includes_changed = false;
     };
     static std::map<std::string, shader_stage> stage_map = { { "vertex", shader_stage::vertex },
                                                              { "fragment", shader_stage::fragment },
@@ -143,32 +213,7 @@ namespace vkrollercoaster {
         std::stringstream stream;
         std::string entrypoint = "main";
     };
-    void shader::compile(std::map<shader_stage, std::vector<uint32_t>>& spirv) {
-        // todo: spirv shader cache
-        
-        shaderc::Compiler compiler;
-        shaderc::CompileOptions options;
-
-        shaderc_source_language source_language;
-        switch (this->m_language) {
-        case shader_language::glsl:
-            source_language = shaderc_source_language_glsl;
-            break;
-        case shader_language::hlsl:
-            source_language = shaderc_source_language_hlsl;
-            break;
-        default:
-            throw std::runtime_error("invalid shader language!");
-        }
-
-        options.SetSourceLanguage(source_language);
-        options.SetTargetEnvironment(shaderc_target_env_vulkan, renderer::get_vulkan_version());
-        options.SetWarningsAsErrors();
-        options.SetGenerateDebugInfo();
-
-        std::unique_ptr<file_includer> includer(new file_includer);
-        options.SetIncluder(std::move(includer));
-
+    void shader::compile(shader_compile_result& result) const {
         std::map<shader_stage, intermediate_source_data> sources;
         {
             std::stringstream file_data(util::read_file(this->m_path));
@@ -200,6 +245,50 @@ namespace vkrollercoaster {
                 }
             }
         }
+
+        // everything that affects the compiled output goes into the cache key. included files
+        // can only be found by compiling, so the cache validates those itself
+        uint64_t key = util::hash_data(this->m_path.string());
+        uint32_t vulkan_version = renderer::get_vulkan_version();
+        key = util::hash_data(&vulkan_version, sizeof(uint32_t), key);
+        key = util::hash_data(&this->m_language, sizeof(shader_language), key);
+        key = util::hash_data(std::string("warnings_as_errors;debug_info"), key);
+        for (const auto& [stage, data] : sources) {
+            key = util::hash_data(&stage, sizeof(shader_stage), key);
+            key = util::hash_data(data.entrypoint, key);
+            key = util::hash_data(data.stream.str(), key);
+        }
+        if (shader_cache::read(key, result.spirv, result.reflection_data,
+                               result.included_files)) {
+            return;
+        }
+
+        // shaderc compilers can't be shared between threads
+        static thread_local shaderc::Compiler compiler;
+        shaderc::CompileOptions options;
+
+        shaderc_source_language source_language;
+        switch (this->m_language) {
+        case shader_language::glsl:
+            source_language = shaderc_source_language_glsl;
+            break;
+        case shader_language::hlsl:
+            source_language = shaderc_source_language_hlsl;
+            break;
+        default:
+            throw std::runtime_error("invalid shader language!");
+        }
+
+        options.SetSourceLanguage(source_language);
+        options.SetTargetEnvironment(shaderc_target_env_vulkan, renderer::get_vulkan_version());
+        options.SetWarningsAsErrors();
+        options.SetGenerateDebugInfo();
+
+        std::unique_ptr<file_includer> includer(
+            new file_includer(&result.included_files, &result.include_hashes));
+        const file_includer* includer_ptr = includer.get();
+        options.SetIncluder(std::move(includer));
+
         for (const auto& [stage, data] : sources) {
             auto source = data.stream.str();
             shaderc_shader_kind shaderc_stage;
@@ -225,15 +314,24 @@ namespace vkrollercoaster {
                 throw std::runtime_error("invalid shader stage!");
             }
             std::string path = this->m_path.string();
-            auto result = compiler.CompileGlslToSpv(source, shaderc_stage, path.c_str(), data.entrypoint.c_str(), options);
-            if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+            auto compilation = compiler.CompileGlslToSpv(source, shaderc_stage, path.c_str(),
+                                                         data.entrypoint.c_str(), options);
+            if (compilation.GetCompilationStatus() != shaderc_compilation_status_success) {
                 throw std::runtime_error("could not compile " + stage_name +
-                                         " shader: " + result.GetErrorMessage());
+                                         " shader: " + compilation.GetErrorMessage());
             }
-            spirv[stage] = std::vector<uint32_t>(result.cbegin(), result.cend());
+            result.spirv[stage] = std::vector<uint32_t>(compilation.cbegin(), compilation.cend());
+        }
+
+        for (const auto& [stage, data] : result.spirv) {
+            reflect(data, stage, result.reflection_data);
+        }
+
+        // an include that was saved mid-compile will trigger another reload anyway
+        if (!includer_ptr->includes_changed()) {
+            shader_cache::write(key, result.include_hashes, result.spirv, result.reflection_data);
         }
     }
-    static std::map<spirv_cross::TypeID, size_t> found_types;
     static void parse_base_type(const spirv_cross::SPIRType& type,
                                 const spirv_cross::Compiler& compiler, size_t& size,
                                 shader_base_type& base_type) {
@@ -287,9 +385,11 @@ namespace vkrollercoaster {
             throw std::runtime_error("invalid base type");
         }
     }
+    // types that have already been added to the reflection data of the shader being reflected
+    using found_types_t = std::map<spirv_cross::TypeID, size_t>;
     static size_t get_type(const spirv_cross::Compiler& compiler, spirv_cross::TypeID id,
                            spirv_cross::TypeID parent, uint32_t member_index,
-                           shader_reflection_data* base_data) {
+                           shader_reflection_data* base_data, found_types_t& found_types) {
         if (found_types.find(id) != found_types.end()) {
             return found_types[id];
         }
@@ -319,14 +419,17 @@ namespace vkrollercoaster {
             std::string name = compiler.get_member_name(spirv_type.self, i);
             shader_field field;
             field.offset = compiler.type_struct_member_offset(spirv_type, i);
-            field.type = get_type(compiler, spirv_type.member_types[i], id, i, base_data);
+            field.type =
+                get_type(compiler, spirv_type.member_types[i], id, i, base_data, found_types);
             base_data->types[type_index].fields.insert(std::make_pair(name, field));
         }
         return type_index;
     }
-    void shader::reflect(const std::vector<uint32_t>& spirv, shader_stage stage) {
+    void shader::reflect(const std::vector<uint32_t>& spirv, shader_stage stage,
+                         shader_reflection_data& reflection_data) {
         spirv_cross::Compiler compiler(std::move(spirv));
         auto resources = compiler.get_shader_resources();
+        found_types_t found_types;
         for (const auto& resource : resources.uniform_buffers) {
             uint32_t set = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
             uint32_t binding = compiler.get_decoration(resource.id, spv::DecorationBinding);
@@ -335,8 +438,8 @@ namespace vkrollercoaster {
             resource_desc.resource_type = shader_resource_type::uniformbuffer;
             resource_desc.stage = stage;
             resource_desc.type = get_type(compiler, resource.type_id, spirv_cross::TypeID(), 0,
-                                          &this->m_reflection_data);
-            this->m_reflection_data.resources[set][binding] = resource_desc;
+                                          &reflection_data, found_types);
+            reflection_data.resources[set][binding] = resource_desc;
         }
         for (const auto& resource : resources.storage_buffers) {
             uint32_t set = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
@@ -346,8 +449,8 @@ namespace vkrollercoaster {
             resource_desc.resource_type = shader_resource_type::storagebuffer;
             resource_desc.stage = stage;
             resource_desc.type = get_type(compiler, resource.type_id, spirv_cross::TypeID(), 0,
-                                          &this->m_reflection_data);
-            this->m_reflection_data.resources[set][binding] = resource_desc;
+                                          &reflection_data, found_types);
+            reflection_data.resources[set][binding] = resource_desc;
         }
         for (const auto& resource : resources.sampled_images) {
             uint32_t set = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
@@ -357,8 +460,8 @@ namespace vkrollercoaster {
             resource_desc.resource_type = shader_resource_type::sampledimage;
             resource_desc.stage = stage;
             resource_desc.type = get_type(compiler, resource.type_id, spirv_cross::TypeID(), 0,
-                                          &this->m_reflection_data);
-            this->m_reflection_data.resources[set][binding] = resource_desc;
+                                          &reflection_data, found_types);
+            reflection_data.resources[set][binding] = resource_desc;
         }
         for (const auto& resource : resources.separate_images) {
             // let's just treat this as a sampled image, as we should put both images and samplers
@@ -370,34 +473,44 @@ namespace vkrollercoaster {
             resource_desc.resource_type = shader_resource_type::sampledimage;
             resource_desc.stage = stage;
             resource_desc.type = get_type(compiler, resource.type_id, spirv_cross::TypeID(), 0,
-                                          &this->m_reflection_data);
-            this->m_reflection_data.resources[set][binding] = resource_desc;
+                                          &reflection_data, found_types);
+            reflection_data.resources[set][binding] = resource_desc;
+        }
+        for (const auto& resource : resources.storage_images) {
+            uint32_t set = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+            uint32_t binding = compiler.get_decoration(resource.id, spv::DecorationBinding);
+            shader_resource_data resource_desc;
+            resource_desc.name = resource.name;
+            resource_desc.resource_type = shader_resource_type::storageimage;
+            resource_desc.stage = stage;
+            resource_desc.type = get_type(compiler, resource.type_id, spirv_cross::TypeID(), 0,
+                                          &reflection_data, found_types);
+            reflection_data.resources[set][binding] = resource_desc;
         }
         for (const auto& resource : resources.push_constant_buffers) {
             push_constant_buffer_data desc;
             desc.name = resource.name;
             desc.stage = stage;
             desc.type = get_type(compiler, resource.type_id, spirv_cross::TypeID(), 0,
-                                 &this->m_reflection_data);
-            this->m_reflection_data.push_constant_buffers.push_back(desc);
+                                 &reflection_data, found_types);
+            reflection_data.push_constant_buffers.push_back(desc);
         }
         for (const auto& resource : resources.stage_inputs) {
             shader_stage_io_field desc;
             desc.location = compiler.get_decoration(resource.id, spv::DecorationLocation);
             desc.name = resource.name;
             desc.type = get_type(compiler, resource.type_id, spirv_cross::TypeID(), 0,
-                                 &this->m_reflection_data);
-            this->m_reflection_data.inputs[stage].push_back(desc);
+                                 &reflection_data, found_types);
+            reflection_data.inputs[stage].push_back(desc);
         }
         for (const auto& resource : resources.stage_outputs) {
             shader_stage_io_field desc;
             desc.location = compiler.get_decoration(resource.id, spv::DecorationLocation);
             desc.name = resource.name;
             desc.type = get_type(compiler, resource.type_id, spirv_cross::TypeID(), 0,
-                                 &this->m_reflection_data);
-            this->m_reflection_data.outputs[stage].push_back(desc);
+                                 &reflection_data, found_types);
+            reflection_data.outputs[stage].push_back(desc);
         }
-        found_types.clear();
     }
     void shader::destroy() {
         VkDevice device = renderer::get_device();
@@ -488,35 +601,251 @@ namespace vkrollercoaster {
         }
         return false;
     }
+    bool shader_reflection_data::resolve_field(size_t type, const std::string& path,
+                                               shader_field_handle& handle) const {
+        size_t offset = 0;
+        size_t current_type = type;
+        size_t start = 0;
+        while (true) {
+            size_t separator_pos = path.find('.', start);
+            std::string name;
+            if (separator_pos != std::string::npos) {
+                name = path.substr(start, separator_pos - start);
+            } else {
+                name = path.substr(start);
+            }
+            if (name.empty()) {
+                throw std::runtime_error("invalid field name");
+            }
+            int32_t index = -1;
+            size_t open_bracket = name.find('[');
+            if (open_bracket != std::string::npos) {
+                size_t close_bracket = name.find(']');
+                if (close_bracket <= open_bracket + 1 || close_bracket >= name.length() ||
+                    close_bracket < name.length() - 1) {
+                    throw std::runtime_error("invalid index operator call");
+                }
+                size_t index_start = open_bracket + 1;
+                std::string index_string = name.substr(index_start, close_bracket - index_start);
+                name = name.substr(0, open_bracket);
+                index = atoi(index_string.c_str());
+            }
+            const auto& fields = this->types[current_type].fields;
+            auto it = fields.find(name);
+            if (it == fields.end()) {
+                return false;
+            }
+            const auto& field_type = this->types[it->second.type];
+            if (index != -1 && field_type.array_stride == 0) {
+                throw std::runtime_error("attempted to index into a non-array field");
+            }
+            if (index == -1) {
+                index = 0;
+            }
+            offset += it->second.offset + (index * field_type.array_stride);
+            current_type = it->second.type;
+            if (separator_pos == std::string::npos) {
+                break;
+            }
+            start = separator_pos + 1;
+        }
+        const auto& field_type = this->types[current_type];
+        handle.offset = offset;
+        handle.size = field_type.size;
+        handle.type = current_type;
+        handle.array_stride = field_type.array_stride;
+        handle.array_size = field_type.array_size;
+        handle.source = this;
+        handle.generation = this->generation;
+        return true;
+    }
+    bool shader_reflection_data::is_valid(const shader_field_handle& handle) const {
+        return handle.source == this && handle.generation == this->generation;
+    }
+    void shader_reflection_data::assign(shader_reflection_data&& other) {
+        this->reset();
+        this->resources = std::move(other.resources);
+        this->push_constant_buffers = std::move(other.push_constant_buffers);
+        this->types = std::move(other.types);
+        this->inputs = std::move(other.inputs);
+        this->outputs = std::move(other.outputs);
+        for (auto& type : this->types) {
+            type.base_data = this;
+        }
+    }
     void shader_reflection_data::reset() {
+        this->generation++;
         this->resources.clear();
         this->push_constant_buffers.clear();
         this->types.clear();
         this->inputs.clear();
         this->outputs.clear();
     }
+    struct pending_shader_reload {
+        std::string name;
+        ref<shader> _shader;
+        std::future<shader_compile_result> result;
+        // set if the shader's files changed again while it was compiling
+        bool outdated = false;
+    };
     static struct {
         std::unordered_map<std::string, ref<shader>> library;
         std::unordered_map<void*, shader_library::callbacks_t> callbacks;
+        ref<file_watcher> watcher;
+        std::vector<pending_shader_reload> pending_reloads;
     } library_data;
-    ref<shader> shader_library::add(const std::string& name) {
+    static std::optional<fs::path> find_shader_path(const std::string& name) {
         std::string base_path = "assets/shaders/" + name;
-        std::optional<fs::path> shader_path;
-
         for (const auto& [extension, language] : language_map) {
             fs::path current_path = base_path + extension;
             if (fs::exists(current_path)) {
-                shader_path = current_path;
-                break;
+                return current_path;
             }
         }
-
+        return std::optional<fs::path>();
+    }
+    ref<shader> shader_library::add(const std::string& name) {
+        std::optional<fs::path> shader_path = find_shader_path(name);
         ref<shader> _shader;
         if (shader_path) {
             _shader = add(name, *shader_path);
         }
         return _shader;
     }
+    void shader_library::add(const std::vector<std::string>& names) {
+        std::vector<std::string> found_names;
+        std::vector<ref<shader>> shaders;
+        std::vector<shader*> raw_shaders;
+        for (const auto& name : names) {
+            if (get(name)) {
+                continue;
+            }
+            std::optional<fs::path> shader_path = find_shader_path(name);
+            if (!shader_path) {
+                continue;
+            }
+            auto _shader = new shader(*shader_path, determine_language(*shader_path), false);
+            found_names.push_back(name);
+            shaders.push_back(ref<shader>(_shader));
+            raw_shaders.push_back(_shader);
+        }
+
+        std::vector<shader_compile_result> results;
+        shader::compile_parallel(raw_shaders, results);
+        for (size_t i = 0; i < shaders.size(); i++) {
+            shaders[i]->apply(results[i]);
+            add(found_names[i], shaders[i]);
+        }
+    }
+    static bool depends_on(ref<shader> _shader, const std::set<std::string>& changed) {
+        if (changed.find(file_watcher::normalize(_shader->get_path())) != changed.end()) {
+            return true;
+        }
+        for (const auto& path : _shader->get_included_files()) {
+            if (changed.find(file_watcher::normalize(path)) != changed.end()) {
+                return true;
+            }
+        }
+        return false;
+    }
+    void shader_library::update() {
+        if (!library_data.watcher) {
+            return;
+        }
+
+        // start recompiling every shader that depends on a changed file
+        std::set<std::string> changed;
+        library_data.watcher->poll(changed);
+        auto& pending_reloads = library_data.pending_reloads;
+        if (!changed.empty()) {
+            for (const auto& [name, _shader] : library_data.library) {
+                if (!depends_on(_shader, changed)) {
+                    continue;
+                }
+                auto it = std::find_if(pending_reloads.begin(), pending_reloads.end(),
+                                       [&](const pending_shader_reload& reload) {
+                                           return reload.name == name;
+                                       });
+                if (it != pending_reloads.end()) {
+                    it->outdated = true;
+                } else {
+                    start_reload(name, _shader);
+                }
+            }
+        }
+
+        // collect finished compilations. a shader that fails to compile keeps running the last
+        // version that did
+        std::vector<pending_shader_reload> finished, restarted;
+        std::vector<shader_compile_result> results;
+        for (size_t i = 0; i < pending_reloads.size();) {
+            auto& reload = pending_reloads[i];
+            if (reload.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                i++;
+                continue;
+            }
+            if (reload.outdated) {
+                // the result is already stale, so there's no point in applying it
+                reload.result.wait();
+                restarted.push_back(std::move(reload));
+            } else {
+                try {
+                    results.push_back(reload.result.get());
+                    finished.push_back(std::move(reload));
+                } catch (const std::exception& exc) {
+                    spdlog::error("could not reload shader {0}: {1}", reload.name, exc.what());
+                }
+            }
+            pending_reloads.erase(pending_reloads.begin() + i);
+        }
+
+        // swap the new shaders in all at once. frames in flight may still be using the
+        // pipelines that are about to be rebuilt
+        if (!finished.empty()) {
+            vkDeviceWaitIdle(renderer::get_device());
+            for (size_t i = 0; i < finished.size(); i++) {
+                auto& _shader = finished[i]._shader;
+                _shader->begin_reload();
+                _shader->apply(results[i]);
+                _shader->end_reload();
+                watch_files(_shader);
+                spdlog::info("reloaded shader {0}", finished[i].name);
+            }
+        }
+        for (const auto& reload : restarted) {
+            start_reload(reload.name, reload._shader);
+        }
+    }
+    void shader_library::watch_files(ref<shader> _shader) {
+        if (!library_data.watcher) {
+            library_data.watcher = ref<file_watcher>::create();
+        }
+        library_data.watcher->watch(_shader->get_path());
+        for (const auto& path : _shader->get_included_files()) {
+            library_data.watcher->watch(path);
+        }
+    }
+    void shader_library::start_reload(const std::string& name, ref<shader> _shader) {
+        // the shader is kept alive by the pending reload, and compiling only reads its path and
+        // language, so it is safe to compile on another thread while it's in use
+        shader* raw_shader = _shader.raw();
+        pending_shader_reload reload;
+        reload.name = name;
+        reload._shader = _shader;
+        reload.result = std::async(std::launch::async, [raw_shader]() {
+            shader_compile_result result;
+            raw_shader->compile(result);
+            return result;
+        });
+        library_data.pending_reloads.push_back(std::move(reload));
+    }
+    void shader_library::reload_all() {
+        std::vector<ref<shader>> shaders;
+        for (const auto& [name, _shader] : library_data.library) {
+            shaders.push_back(_shader);
+        }
+        shader::reload_all(shaders);
+    }
     bool shader_library::add(const std::string& name, ref<shader> _shader) {
         if (library_data.library.find(name) != library_data.library.end()) {
             return false;
@@ -526,6 +855,7 @@ namespace vkrollercoaster {
         }
 
         library_data.library.insert(std::make_pair(name, _shader));
+        watch_files(_shader);
         for (const auto& [id, callbacks] : library_data.callbacks) {
             callbacks.on_added(name);
         }
@@ -539,6 +869,12 @@ namespace vkrollercoaster {
 
         ref<shader> _shader = library_data.library[name];
         library_data.library.erase(name);
+        auto& pending_reloads = library_data.pending_reloads;
+        pending_reloads.erase(std::remove_if(pending_reloads.begin(), pending_reloads.end(),
+                                             [&](const pending_shader_reload& reload) {
+                                                 return reload.name == name;
+                                             }),
+                              pending_reloads.end());
         for (const auto& [id, callbacks] : library_data.callbacks) {
             callbacks.on_removed(name, _shader);
         }
@@ -559,6 +895,8 @@ namespace vkrollercoaster {
         }
     }
     void shader_library::clear() {
+        library_data.pending_reloads.clear();
+        library_data.watcher.reset();
         auto shaders = library_data.library;
         library_data.library.clear();
 
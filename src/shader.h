@@ -18,7 +18,7 @@
 namespace vkrollercoaster {
     enum class shader_stage { vertex, fragment, geometry, compute };
     enum class shader_language { glsl, hlsl };
-    enum class shader_resource_type { uniformbuffer, storagebuffer, sampledimage };
+    enum class shader_resource_type { uniformbuffer, storagebuffer, sampledimage, storageimage };
     struct shader_field {
         size_t offset, type;
     };
@@ -49,6 +49,18 @@ namespace vkrollercoaster {
         shader_base_type base_type;
         shader_reflection_data* base_data;
     };
+    // a field path resolved once into its location within a buffer, so that hot paths don't have
+    // to parse paths on every access. handles are invalidated when their shader is reloaded
+    struct shader_field_handle {
+        size_t offset = 0, size = 0, type = 0;
+        size_t array_stride = 0, array_size = 0;
+        const shader_reflection_data* source = nullptr;
+        uint64_t generation = 0;
+        // offset of the given element, if the field is an array
+        size_t element_offset(size_t index) const {
+            return this->offset + (index * this->array_stride);
+        }
+    };
     struct shader_resource_data {
         std::string name;
         shader_resource_type resource_type;
@@ -62,12 +74,30 @@ namespace vkrollercoaster {
     };
     struct shader_reflection_data {
         bool find_resource(const std::string& name, uint32_t& set, uint32_t& binding) const;
+        // resolves a path such as "spotlights[1].attenuation._linear", relative to the start of
+        // the given type. returns false if the path does not exist
+        bool resolve_field(size_t type, const std::string& path, shader_field_handle& handle) const;
+        bool is_valid(const shader_field_handle& handle) const;
         void reset();
+        // replaces the contents with reflection data that was generated elsewhere
+        void assign(shader_reflection_data&& other);
+        // incremented on every reset, which invalidates field handles
+        uint64_t generation = 0;
         std::map<uint32_t, std::map<uint32_t, shader_resource_data>> resources;
         std::vector<push_constant_buffer_data> push_constant_buffers;
         std::vector<shader_type> types;
         std::map<shader_stage, std::vector<shader_stage_io_field>> inputs, outputs;
     };
+    // everything compiling a shader produces. it is kept apart from the shader itself until it
+    // is applied, so that shaders can be recompiled while they are in use
+    struct shader_compile_result {
+        std::map<shader_stage, std::vector<uint32_t>> spirv;
+        shader_reflection_data reflection_data;
+        std::set<std::string> included_files;
+        // hashes of the included files' contents, as they were handed to the compiler. empty
+        // if the shader was read from the cache
+        std::map<std::string, uint64_t> include_hashes;
+    };
     class pipeline;
     class shader : public ref_counted {
     public:
@@ -78,22 +108,38 @@ namespace vkrollercoaster {
         shader(const shader&) = delete;
         shader& operator=(const shader&) = delete;
         void reload();
+        // reloads every passed shader at once, compiling them in parallel
+        static void reload_all(const std::vector<ref<shader>>& shaders);
         shader_reflection_data& get_reflection_data() { return this->m_reflection_data; }
+        const fs::path& get_path() { return this->m_path; }
+        // every file included while compiling, including transitive includes
+        const std::set<std::string>& get_included_files() { return this->m_included_files; }
         const std::vector<VkPipelineShaderStageCreateInfo>& get_pipeline_info() {
             return this->m_shader_data;
         }
 
     private:
+        // compiles and reflects each shader on the worker pool
+        static void compile_parallel(const std::vector<shader*>& shaders,
+                                     std::vector<shader_compile_result>& results);
+        shader(const fs::path& source, shader_language language, bool create);
+        void begin_reload();
+        void end_reload();
         void create();
-        void compile(std::map<shader_stage, std::vector<uint32_t>>& spirv);
-        void reflect(const std::vector<uint32_t>& spirv, shader_stage stage);
+        void apply(shader_compile_result& result);
+        // safe to call on any thread, as it only reads this shader's path and language
+        void compile(shader_compile_result& result) const;
+        static void reflect(const std::vector<uint32_t>& spirv, shader_stage stage,
+                            shader_reflection_data& reflection_data);
         void destroy();
         std::vector<VkPipelineShaderStageCreateInfo> m_shader_data;
         shader_language m_language;
         fs::path m_path;
         shader_reflection_data m_reflection_data;
+        std::set<std::string> m_included_files;
         std::unordered_set<pipeline*> m_dependents;
         friend class pipeline;
+        friend class shader_library;
     };
     class shader_library {
     public:
@@ -104,6 +150,8 @@ namespace vkrollercoaster {
 
         static bool add(const std::string& name, ref<shader> _shader);
         static ref<shader> add(const std::string& name);
+        // compiles every shader that is not in the library yet in parallel, and adds them
+        static void add(const std::vector<std::string>& names);
         static ref<shader> add(const std::string& name, const fs::path& path) {
             ref<shader> _shader;
             if (!get(name)) {
@@ -117,6 +165,12 @@ namespace vkrollercoaster {
         static ref<shader> get(const std::string& name);
 
         static void get_names(std::vector<std::string>& names);
+        static void reload_all();
+
+        // watches the files of every shader in the library, and recompiles shaders whose source
+        // or includes changed in the background. finished shaders are swapped in here, so this
+        // must be called at a frame boundary
+        static void update();
         static void clear();
 
         static void add_callbacks(void* identifier, const callbacks_t& callbacks);
@@ -124,5 +178,7 @@ namespace vkrollercoaster {
 
     private:
         shader_library() = default;
+        static void watch_files(ref<shader> _shader);
+        static void start_reload(const std::string& name, ref<shader> _shader);
     };
 } // namespace vkrollercoaster
\ No newline at end of file
@@ -0,0 +1,323 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "pch.h"
+#include "shader_cache.h"
+#include "util.h"
+namespace vkrollercoaster {
+    struct shader_cache_header {
+        uint32_t magic, version;
+        uint64_t key;
+    };
+    static constexpr uint32_t shader_cache_magic = 0x43534b56; // "VKSC"
+    // bump whenever the layout of an entry or of shader_reflection_data changes
+    static constexpr uint32_t shader_cache_version = 1;
+
+    class cache_writer {
+    public:
+        cache_writer(std::ofstream& stream) : m_stream(stream) {}
+        template <typename T> void write(const T& value) {
+            static_assert(std::is_trivially_copyable_v<T>, "must pass a trivially copyable type!");
+            this->m_stream.write((const char*)&value, sizeof(T));
+        }
+        void write(const std::string& value) {
+            this->write<uint64_t>(value.length());
+            this->m_stream.write(value.data(), value.length());
+        }
+        void write(const shader_type& type) {
+            this->write(type.name);
+            this->write<uint64_t>(type.size);
+            this->write<uint64_t>(type.array_stride);
+            this->write<uint64_t>(type.array_size);
+            this->write<uint64_t>(type.columns);
+            this->write(type.base_type);
+            this->write<uint64_t>(type.fields.size());
+            for (const auto& [name, field] : type.fields) {
+                this->write(name);
+                this->write<uint64_t>(field.offset);
+                this->write<uint64_t>(field.type);
+            }
+        }
+        void write(const std::map<shader_stage, std::vector<shader_stage_io_field>>& fields) {
+            this->write<uint64_t>(fields.size());
+            for (const auto& [stage, stage_fields] : fields) {
+                this->write(stage);
+                this->write<uint64_t>(stage_fields.size());
+                for (const auto& field : stage_fields) {
+                    this->write<uint64_t>(field.type);
+                    this->write<uint64_t>(field.location);
+                    this->write(field.name);
+                }
+            }
+        }
+
+    private:
+        std::ofstream& m_stream;
+    };
+
+    // lengths read from an entry are checked against what is left of the file, so that a
+    // corrupt entry fails to read rather than allocating whatever it claims to hold
+    class cache_reader {
+    public:
+        cache_reader(std::ifstream& stream) : m_stream(stream) {
+            auto start = stream.tellg();
+            stream.seekg(0, std::ios::end);
+            auto end = stream.tellg();
+            stream.seekg(start);
+            this->m_remaining = start >= 0 && end >= start ? (size_t)(end - start) : 0;
+        }
+        template <typename T> T read() {
+            static_assert(std::is_trivially_copyable_v<T>, "must pass a trivially copyable type!");
+            T value;
+            this->read_array(&value, 1);
+            return value;
+        }
+        template <typename T> void read_array(T* values, size_t count) {
+            static_assert(std::is_trivially_copyable_v<T>, "must pass a trivially copyable type!");
+            size_t size = count * sizeof(T);
+            if (!this->good() || this->m_remaining < size) {
+                this->m_good = false;
+                return;
+            }
+            this->m_stream.read((char*)values, size);
+            this->m_remaining -= size;
+        }
+        template <typename T> void read_vector(std::vector<T>& values) {
+            auto count = this->read<uint64_t>();
+            if (!this->good() || count > this->m_remaining / sizeof(T)) {
+                this->m_good = false;
+                return;
+            }
+            values.resize(count);
+            this->read_array(values.data(), count);
+        }
+        std::string read_string() {
+            std::vector<char> characters;
+            this->read_vector(characters);
+            return std::string(characters.begin(), characters.end());
+        }
+        void read(shader_type& type) {
+            type.name = this->read_string();
+            type.size = this->read<uint64_t>();
+            type.array_stride = this->read<uint64_t>();
+            type.array_size = this->read<uint64_t>();
+            type.columns = this->read<uint64_t>();
+            type.base_type = this->read<shader_base_type>();
+            auto field_count = this->read<uint64_t>();
+            for (uint64_t i = 0; i < field_count && this->good(); i++) {
+                std::string name = this->read_string();
+                shader_field field;
+                field.offset = this->read<uint64_t>();
+                field.type = this->read<uint64_t>();
+                type.fields.insert(std::make_pair(name, field));
+            }
+        }
+        void read(std::map<shader_stage, std::vector<shader_stage_io_field>>& fields) {
+            auto stage_count = this->read<uint64_t>();
+            for (uint64_t i = 0; i < stage_count && this->good(); i++) {
+                auto stage = this->read<shader_stage>();
+                auto field_count = this->read<uint64_t>();
+                auto& stage_fields = fields[stage];
+                for (uint64_t j = 0; j < field_count && this->good(); j++) {
+                    shader_stage_io_field field;
+                    field.type = this->read<uint64_t>();
+                    field.location = this->read<uint64_t>();
+                    field.name = this->read_string();
+                    stage_fields.push_back(field);
+                }
+            }
+        }
+        bool good() { return this->m_good && (bool)this->m_stream; }
+
+    private:
+        std::ifstream& m_stream;
+        size_t m_remaining;
+        bool m_good = true;
+    };
+
+    static fs::path get_entry_path(uint64_t key) {
+        fs::path directory = util::get_cache_directory() / "shaders";
+        if (!fs::exists(directory)) {
+            fs::create_directories(directory);
+        }
+        std::stringstream filename;
+        filename << std::hex << key << ".bin";
+        return directory / filename.str();
+    }
+
+    bool shader_cache::read(uint64_t key, std::map<shader_stage, std::vector<uint32_t>>& spirv,
+                            shader_reflection_data& reflection_data,
+                            std::set<std::string>& included_files) {
+        fs::path path = get_entry_path(key);
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        cache_reader reader(file);
+        auto header = reader.read<shader_cache_header>();
+        if (!reader.good() || header.magic != shader_cache_magic ||
+            header.version != shader_cache_version || header.key != key) {
+            spdlog::warn("shader cache entry {0} is stale or corrupt - discarding", path.string());
+            return false;
+        }
+
+        // make sure none of the included files have changed since the entry was written
+        std::set<std::string> cached_included_files;
+        auto include_count = reader.read<uint64_t>();
+        for (uint64_t i = 0; i < include_count && reader.good(); i++) {
+            std::string include_path = reader.read_string();
+            auto hash = reader.read<uint64_t>();
+            if (!reader.good()) {
+                break;
+            }
+            if (!fs::exists(include_path) ||
+                util::hash_data(util::read_file(include_path)) != hash) {
+                return false;
+            }
+            cached_included_files.insert(include_path);
+        }
+
+        std::map<shader_stage, std::vector<uint32_t>> cached_spirv;
+        auto stage_count = reader.read<uint64_t>();
+        for (uint64_t i = 0; i < stage_count && reader.good(); i++) {
+            auto stage = reader.read<shader_stage>();
+            reader.read_vector(cached_spirv[stage]);
+        }
+
+        shader_reflection_data cached_reflection_data;
+        auto set_count = reader.read<uint64_t>();
+        for (uint64_t i = 0; i < set_count && reader.good(); i++) {
+            auto set = reader.read<uint32_t>();
+            auto binding_count = reader.read<uint64_t>();
+            for (uint64_t j = 0; j < binding_count && reader.good(); j++) {
+                auto binding = reader.read<uint32_t>();
+                shader_resource_data resource;
+                resource.name = reader.read_string();
+                resource.resource_type = reader.read<shader_resource_type>();
+                resource.stage = reader.read<shader_stage>();
+                resource.type = reader.read<uint64_t>();
+                cached_reflection_data.resources[set][binding] = resource;
+            }
+        }
+        auto push_constant_buffer_count = reader.read<uint64_t>();
+        for (uint64_t i = 0; i < push_constant_buffer_count && reader.good(); i++) {
+            push_constant_buffer_data buffer;
+            buffer.name = reader.read_string();
+            buffer.type = reader.read<uint64_t>();
+            buffer.stage = reader.read<shader_stage>();
+            cached_reflection_data.push_constant_buffers.push_back(buffer);
+        }
+        auto type_count = reader.read<uint64_t>();
+        for (uint64_t i = 0; i < type_count && reader.good(); i++) {
+            reader.read(cached_reflection_data.types.emplace_back());
+        }
+        reader.read(cached_reflection_data.inputs);
+        reader.read(cached_reflection_data.outputs);
+        if (!reader.good()) {
+            spdlog::warn("shader cache entry {0} is truncated - discarding", path.string());
+            return false;
+        }
+
+        spirv = std::move(cached_spirv);
+        included_files = std::move(cached_included_files);
+        reflection_data.resources = std::move(cached_reflection_data.resources);
+        reflection_data.push_constant_buffers =
+            std::move(cached_reflection_data.push_constant_buffers);
+        reflection_data.types = std::move(cached_reflection_data.types);
+        reflection_data.inputs = std::move(cached_reflection_data.inputs);
+        reflection_data.outputs = std::move(cached_reflection_data.outputs);
+        for (auto& type : reflection_data.types) {
+            type.base_data = &reflection_data;
+        }
+        return true;
+    }
+
+    void shader_cache::write(uint64_t key, const std::map<std::string, uint64_t>& include_hashes,
+                             const std::map<shader_stage, std::vector<uint32_t>>& spirv,
+                             const shader_reflection_data& reflection_data) {
+        fs::path path = get_entry_path(key);
+        fs::path temporary_path = path;
+        temporary_path += ".tmp";
+        {
+            std::ofstream file(temporary_path, std::ios::binary);
+            if (!file.is_open()) {
+                spdlog::warn("could not write shader cache entry {0}", path.string());
+                return;
+            }
+            cache_writer writer(file);
+
+            shader_cache_header header;
+            util::zero(header);
+            header.magic = shader_cache_magic;
+            header.version = shader_cache_version;
+            header.key = key;
+            writer.write(header);
+
+            writer.write<uint64_t>(include_hashes.size());
+            for (const auto& [include_path, hash] : include_hashes) {
+                writer.write(include_path);
+                writer.write(hash);
+            }
+
+            writer.write<uint64_t>(spirv.size());
+            for (const auto& [stage, data] : spirv) {
+                writer.write(stage);
+                writer.write<uint64_t>(data.size());
+                file.write((const char*)data.data(), data.size() * sizeof(uint32_t));
+            }
+
+            writer.write<uint64_t>(reflection_data.resources.size());
+            for (const auto& [set, resources] : reflection_data.resources) {
+                writer.write(set);
+                writer.write<uint64_t>(resources.size());
+                for (const auto& [binding, resource] : resources) {
+                    writer.write(binding);
+                    writer.write(resource.name);
+                    writer.write(resource.resource_type);
+                    writer.write(resource.stage);
+                    writer.write<uint64_t>(resource.type);
+                }
+            }
+            writer.write<uint64_t>(reflection_data.push_constant_buffers.size());
+            for (const auto& buffer : reflection_data.push_constant_buffers) {
+                writer.write(buffer.name);
+                writer.write<uint64_t>(buffer.type);
+                writer.write(buffer.stage);
+            }
+            writer.write<uint64_t>(reflection_data.types.size());
+            for (const auto& type : reflection_data.types) {
+                writer.write(type);
+            }
+            writer.write(reflection_data.inputs);
+            writer.write(reflection_data.outputs);
+
+            file.flush();
+            if (!file) {
+                spdlog::warn("could not write shader cache entry {0}", path.string());
+                return;
+            }
+        }
+
+        // entries are written to a temporary file first, so that a reader never sees a
+        // partially written entry
+        std::error_code error;
+        fs::rename(temporary_path, path, error);
+        if (error) {
+            spdlog::warn("could not write shader cache entry {0}", path.string());
+            fs::remove(temporary_path, error);
+        }
+    }
+} // namespace vkrollercoaster
\ No newline at end of file
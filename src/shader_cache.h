@@ -0,0 +1,35 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#pragma once
+#include "shader.h"
+namespace vkrollercoaster {
+    // content-addressed on-disk cache of compiled spir-v and its reflection data. entries also
+    // record the files that were included while compiling, and are only used while every one of
+    // them still has the same contents
+    class shader_cache {
+    public:
+        shader_cache() = delete;
+
+        static bool read(uint64_t key, std::map<shader_stage, std::vector<uint32_t>>& spirv,
+                         shader_reflection_data& reflection_data,
+                         std::set<std::string>& included_files);
+        // include_hashes maps each included file to the hash of the contents it was compiled with
+        static void write(uint64_t key, const std::map<std::string, uint64_t>& include_hashes,
+                          const std::map<shader_stage, std::vector<uint32_t>>& spirv,
+                          const shader_reflection_data& reflection_data);
+    };
+} // namespace vkrollercoaster
\ No newline at end of file
@@ -17,9 +17,12 @@
 #include "pch.h"
 #define EXPOSE_IMAGE_UTILS
 #include "skybox.h"
-#include "model.h"
+#include "asset_manager.h"
+#define EXPOSE_RENDERER_INTERNALS
 #include "renderer.h"
 #include "util.h"
+#include "compute_pipeline.h"
+#include "ibl_cache.h"
 #include "menus/menus.h"
 namespace vkrollercoaster {
     static struct {
@@ -28,65 +31,108 @@ namespace vkrollercoaster {
         ref<texture> brdflut;
     } skybox_data;
 
+    // every ibl compute shader is written with 8x8 groups
+    static const glm::uvec3 ibl_group_size = glm::uvec3(8, 8, 1);
+
+    // image-based lighting generation parameters. these are hashed as raw bytes into cache keys,
+    // so every member is 4 bytes wide to avoid padding
+    static const struct {
+        // these must match the image formats the storage images are declared with. half floats
+        // are plenty for lighting, and the lookup table only has two channels
+        VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        VkFormat brdflut_format = VK_FORMAT_R16G16_SFLOAT;
+        uint32_t brdflut_size = 512;
+
+        // see assets/shaders/irradiance_map.hlsl
+        uint32_t irradiance_map_size = 64;
+        float delta_phi = glm::pi<float>() / 90.f;
+        float delta_theta = glm::pi<float>() / 128.f;
+
+        // see assets/shaders/prefiltered_cube.hlsl
+        uint32_t prefiltered_cube_size = 512;
+        uint32_t prefiltered_cube_levels = 6;
+        uint32_t max_sample_count = 256;
+        uint32_t min_sample_count = 32;
+    } ibl_parameters;
+
+    // hashes a shader's source along with everything it includes, so that cached output is
+    // regenerated whenever any of them change
+    static uint64_t hash_shader(ref<shader> _shader, uint64_t seed) {
+        uint64_t hash = util::hash_file(_shader->get_path(), seed);
+        for (const auto& path : _shader->get_included_files()) {
+            hash = util::hash_file(path, hash);
+        }
+        return hash;
+    }
+
     static void generate_brdf_lookup_table() {
-        constexpr uint32_t size = 512;
         ref<shader> _shader = shader_library::get("gen_brdflut");
 
-        // create framebuffer to render to
-        framebuffer_spec fb_spec;
-        fb_spec.width = size;
-        fb_spec.height = size;
-        fb_spec.requested_attachments[attachment_type::color] = VK_FORMAT_R16G16_SFLOAT;
-        auto fb = ref<framebuffer>::create(fb_spec);
-
-        // get color attachment from framebuffer
-        auto attachment = fb->get_attachment(attachment_type::color);
+        // the lookup table doesn't depend on anything but the shader, so it is only ever
+        // generated once
+        uint64_t key = util::hash_data(&ibl_parameters.brdflut_format, sizeof(VkFormat));
+        key = util::hash_data(&ibl_parameters.brdflut_size, sizeof(uint32_t), key);
+        key = hash_shader(_shader, key);
+        if (auto cached = ibl_cache::read_image("brdflut", key)) {
+            skybox_data.brdflut = ref<texture>::create(cached);
+            return;
+        }
 
-        // create pipeline for rendering
-        pipeline_spec _pipeline_spec;
-        auto _pipeline = ref<pipeline>::create(fb, _shader, _pipeline_spec);
+        uint32_t size = ibl_parameters.brdflut_size;
+        auto _pipeline = ref<compute_pipeline>::create(_shader);
+        auto lookup_table = ref<image2d>::create(ibl_parameters.brdflut_format, size, size,
+                                                 VK_IMAGE_USAGE_STORAGE_BIT |
+                                                     VK_IMAGE_USAGE_SAMPLED_BIT |
+                                                     VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                                 VK_IMAGE_ASPECT_COLOR_BIT);
+        _pipeline->bind_storage_image(lookup_table->get_view(), "lookup_table");
 
+        static constexpr VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         {
-            // begin a command buffer
             auto cmdbuffer = renderer::create_single_time_command_buffer();
             cmdbuffer->begin();
-            cmdbuffer->begin_render_pass(fb, glm::vec4(0.f, 0.f, 0.f, 1.f));
-            VkCommandBuffer vkcmdbuffer = cmdbuffer->get();
-
-            // set viewport and scissor
-            vkCmdSetScissor(vkcmdbuffer, 0, 1, &_pipeline->get_scissor());
-            vkCmdSetViewport(vkcmdbuffer, 0, 1, &_pipeline->get_viewport());
 
-            // bind pipeline and draw
             _pipeline->bind(cmdbuffer);
-            vkCmdDraw(vkcmdbuffer, 3, 1, 0, 0);
+            _pipeline->dispatch(cmdbuffer, glm::uvec3(size, size, 1), ibl_group_size);
+            transition_image_layout(lookup_table->get_image(), lookup_table->get_layout(),
+                                    final_layout, lookup_table->get_image_aspect(), 1, cmdbuffer);
 
-            // flush command buffer
-            cmdbuffer->end_render_pass();
             cmdbuffer->end();
             cmdbuffer->submit();
             cmdbuffer->wait();
         }
+        lookup_table->set_layout(final_layout);
+        ibl_cache::write("brdflut", key, lookup_table);
 
-        skybox_data.brdflut = ref<texture>::create(attachment);
+        skybox_data.brdflut = ref<texture>::create(lookup_table);
     }
 
     void skybox::init() {
-        // load the mesh
-        auto source = ref<model_source>::create("assets/models/cube.gltf");
-        auto _model = ref<model>::create(source);
+        // load the mesh. the cube is only ever drawn around the camera, so it has no use for
+        // levels of detail
+        model_import_options options;
+        options.generate_lods = false;
+        auto source = asset_manager::load_model_source("assets/models/cube.gltf", options);
+        if (!source) {
+            throw std::runtime_error("could not load the skybox cube model!");
+        }
 
         // vertices
-        const auto& vertices = _model->get_vertices();
+        const auto& vertices = source->get_vertices();
         std::vector<glm::vec3> positions;
         for (const auto& _vertex : vertices) {
             positions.push_back(_vertex.position);
         }
         skybox_data.vertices = ref<vertex_buffer>::create(positions);
 
-        // indices
-        const auto& indices = _model->get_indices();
-        skybox_data.indices = ref<index_buffer>::create(indices);
+        // indices, at full detail
+        const auto& indices = source->get_indices();
+        std::vector<uint32_t> cube_indices;
+        for (const auto& _mesh : source->get_meshes()) {
+            auto begin = indices.begin() + _mesh.index_offset;
+            cube_indices.insert(cube_indices.end(), begin, begin + _mesh.index_count);
+        }
+        skybox_data.indices = ref<index_buffer>::create(cube_indices);
 
         // generate brdf lookup table
         generate_brdf_lookup_table();
@@ -139,8 +185,7 @@ namespace vkrollercoaster {
         renderer::get_camera_buffer()->bind(this->m_pipeline);
 
         // create pbr textures
-        this->create_irradiance_map();
-        this->create_prefiltered_cube();
+        this->create_pbr_textures();
     }
 
     void skybox::render(ref<command_buffer> cmdbuffer, bool bind_pipeline) {
@@ -168,231 +213,205 @@ namespace vkrollercoaster {
 
         // draw
         vkCmdDrawIndexed(vkcmdbuffer, skybox_data.indices->get_index_count(), 1, 0, 0, 0);
+
+        // keep this skybox alive until the gpu is done with it
+        submitted_render_call submitted_call;
+        submitted_call._pipeline = this->m_pipeline;
+        submitted_call.vbo = skybox_data.vertices;
+        submitted_call.ibo = skybox_data.indices;
+        submitted_call._skybox = this;
+        renderer::add_submitted_call(cmdbuffer, submitted_call);
     }
 
     float skybox::get_gamma() {
-        size_t offset = this->find_ubo_offset("gamma");
+        size_t offset = this->find_ubo_offset(this->m_gamma_field, "gamma");
         float gamma;
         this->m_uniform_buffer->get_data(gamma, offset);
         return gamma;
     }
 
     void skybox::set_gamma(float gamma) {
-        size_t offset = this->find_ubo_offset("gamma");
+        size_t offset = this->find_ubo_offset(this->m_gamma_field, "gamma");
         this->m_uniform_buffer->set_data(gamma, offset);
     }
 
     float skybox::get_exposure() {
-        size_t offset = this->find_ubo_offset("exposure");
+        size_t offset = this->find_ubo_offset(this->m_exposure_field, "exposure");
         float exposure;
         this->m_uniform_buffer->get_data(exposure, offset);
         return exposure;
     }
 
     void skybox::set_exposure(float exposure) {
-        size_t offset = this->find_ubo_offset("exposure");
+        size_t offset = this->find_ubo_offset(this->m_exposure_field, "exposure");
         this->m_uniform_buffer->set_data(exposure, offset);
     }
 
-    static ref<image_cube> create_cube_map(
-        VkFormat format, uint32_t size, ref<texture> environment_map, ref<shader> _shader,
-        ref<uniform_buffer> input, std::function<void(ref<command_buffer>)> render_callback) {
-
-        // create final irradiance map
-        auto result = ref<image_cube>::create(
-            format, size, size, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-            VK_IMAGE_ASPECT_COLOR_BIT);
-        static constexpr VkImageLayout result_transfer_image_layout =
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        result->transition(result_transfer_image_layout);
-
-        // create framebuffer to render to
-        framebuffer_spec fb_spec;
-        fb_spec.width = size;
-        fb_spec.height = size;
-        fb_spec.requested_attachments[attachment_type::color] = format;
-        auto fb = ref<framebuffer>::create(fb_spec);
-
-        // get color attachment from framebuffer
-        auto attachment = fb->get_attachment(attachment_type::color);
-
-        // create pipeline for rendering
-        pipeline_spec _pipeline_spec;
-        _pipeline_spec.input_layout.stride = sizeof(glm::vec3);
-        _pipeline_spec.input_layout.attributes = { { vertex_attribute_type::VEC3, 0 } };
-        auto _pipeline = ref<pipeline>::create(fb, _shader, _pipeline_spec);
-
-        // bind skybox texture and uniform buffer to pipeline
-        environment_map->bind(_pipeline, "environment_texture");
-        input->bind(_pipeline);
-
-        // mvp matrices (see assets/shaders/base/filter_cube.hlsl)
-        std::vector<glm::mat4> matrices = {
-            // positive x
-            glm::rotate(glm::rotate(glm::mat4(1.f), glm::radians(90.f), glm::vec3(0.f, 1.f, 0.f)),
-                        glm::radians(180.f), glm::vec3(1.f, 0.f, 0.f)),
-
-            // negative x
-            glm::rotate(glm::rotate(glm::mat4(1.f), glm::radians(-90.f), glm::vec3(0.f, 1.f, 0.f)),
-                        glm::radians(180.f), glm::vec3(1.f, 0.f, 0.f)),
-
-            // positive y
-            glm::rotate(glm::mat4(1.f), glm::radians(-90.f), glm::vec3(1.f, 0.f, 0.f)),
-
-            // negative y
-            glm::rotate(glm::mat4(1.f), glm::radians(90.f), glm::vec3(1.f, 0.f, 0.f)),
-
-            // positive z
-            glm::rotate(glm::mat4(1.f), glm::radians(180.f), glm::vec3(1.f, 0.f, 0.f)),
-
-            // negative z
-            glm::rotate(glm::mat4(1.f), glm::radians(180.f), glm::vec3(0.f, 0.f, 1.f)),
-        };
-
-        {
-            VkImage attachment_image = attachment->get_image();
-            VkImage result_image = result->get_image();
-
-            auto cmdbuffer = renderer::create_single_time_command_buffer();
-            cmdbuffer->begin();
-
-            // set scissor
-            VkRect2D scissor = _pipeline->get_scissor();
-            vkCmdSetScissor(cmdbuffer->get(), 0, 1, &scissor);
+    // a view of one mip level of every face, for compute shaders to write to
+    static VkImageView create_storage_view(ref<image_cube> cube, uint32_t mip_level) {
+        VkImageViewCreateInfo create_info;
+        util::zero(create_info);
+
+        create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        create_info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        create_info.image = cube->get_image();
+        create_info.format = cube->get_format();
+        create_info.subresourceRange.aspectMask = cube->get_image_aspect();
+        create_info.subresourceRange.baseMipLevel = mip_level;
+        create_info.subresourceRange.levelCount = 1;
+        create_info.subresourceRange.layerCount = image_cube::cube_face_count;
+
+        VkImageView view;
+        VkDevice device = renderer::get_device();
+        if (vkCreateImageView(device, &create_info, nullptr, &view) != VK_SUCCESS) {
+            throw std::runtime_error("could not create cube storage view!");
+        }
+        return view;
+    }
 
-            // set viewport
-            VkViewport viewport = _pipeline->get_viewport();
-            viewport.y = (float)fb->get_extent().height - viewport.y;
-            viewport.height *= -1.f;
-            vkCmdSetViewport(cmdbuffer->get(), 0, 1, &viewport);
-
-            for (uint32_t face = 0; face < image_cube::cube_face_count; face++) {
-                cmdbuffer->begin_render_pass(fb, glm::vec4(0.f));
-                _pipeline->bind(cmdbuffer);
-
-                glm::mat4 mvp =
-                    glm::perspective(glm::radians(90.f), 1.f, 0.1f, 512.f) * matrices[face];
-                vkCmdPushConstants(cmdbuffer->get(), _pipeline->get_layout(),
-                                   VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &mvp);
-
-                render_callback(cmdbuffer);
-                cmdbuffer->end_render_pass();
-
-                static constexpr VkImageLayout transfer_image_layout =
-                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-                VkImageLayout render_layout = attachment->get_layout();
-                transition_image_layout(attachment_image, render_layout, transfer_image_layout,
-                                        attachment->get_image_aspect(), 1, cmdbuffer);
-
-                VkImageCopy region;
-                util::zero(region);
-
-                region.srcSubresource.aspectMask = attachment->get_image_aspect();
-                region.srcSubresource.baseArrayLayer = 0;
-                region.srcSubresource.mipLevel = 0;
-                region.srcSubresource.layerCount = 1;
-                region.srcOffset = { 0, 0, 0 };
-
-                region.dstSubresource.aspectMask = result->get_image_aspect();
-                region.dstSubresource.baseArrayLayer = face;
-                region.dstSubresource.mipLevel = 0;
-                region.dstSubresource.layerCount = 1;
-                region.dstOffset = { 0, 0, 0 };
-
-                region.extent.width = size;
-                region.extent.height = size;
-                region.extent.depth = 1;
-
-                vkCmdCopyImage(cmdbuffer->get(), attachment_image, transfer_image_layout,
-                               result_image, result->get_layout(), 1, &region);
-                transition_image_layout(attachment_image, transfer_image_layout, render_layout,
-                                        attachment->get_image_aspect(), 1, cmdbuffer);
+    void skybox::create_pbr_textures() {
+        auto irradiance_shader = shader_library::get("irradiance_map");
+        auto prefilter_shader = shader_library::get("prefiltered_cube");
+
+        // cubes generated from a file are cached, keyed by the file's contents
+        ref<image_cube> source = this->m_skybox->get_image().as<image_cube>();
+        bool cacheable = !source->get_path().empty();
+        uint64_t key = 0;
+        if (cacheable) {
+            key = util::hash_file(source->get_path());
+            key = util::hash_data(&ibl_parameters, sizeof(ibl_parameters), key);
+
+            // filtering reads from the source's mip chain, when it has one
+            uint32_t source_mip_levels = source->get_mip_levels();
+            key = util::hash_data(&source_mip_levels, sizeof(uint32_t), key);
+            key = hash_shader(irradiance_shader, key);
+            key = hash_shader(prefilter_shader, key);
+
+            auto irradiance_map = ibl_cache::read_cube("irradiance_map", key);
+            auto prefiltered_cube = ibl_cache::read_cube("prefiltered_cube", key);
+            if (irradiance_map && prefiltered_cube) {
+                this->m_irradiance_map = ref<texture>::create(irradiance_map);
+                this->m_prefiltered_cube = ref<texture>::create(prefiltered_cube);
+                return;
             }
-
-            static constexpr VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            transition_image_layout(result_image, result_transfer_image_layout, final_layout,
-                                    result->get_image_aspect(), image_cube::cube_face_count,
-                                    cmdbuffer);
-
-            cmdbuffer->end();
-            cmdbuffer->submit();
-            cmdbuffer->wait();
-
-            result->set_layout(final_layout);
         }
 
-        return result;
-    }
+        static constexpr VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT |
+                                                   VK_IMAGE_USAGE_SAMPLED_BIT |
+                                                   VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        std::vector<VkImageView> storage_views;
+
+        // irradiance map
+        uint32_t irradiance_map_size = ibl_parameters.irradiance_map_size;
+        auto irradiance_map =
+            ref<image_cube>::create(ibl_parameters.format, irradiance_map_size,
+                                    irradiance_map_size, usage, VK_IMAGE_ASPECT_COLOR_BIT);
+        auto irradiance_pipeline = ref<compute_pipeline>::create(irradiance_shader);
+        storage_views.push_back(create_storage_view(irradiance_map, 0));
+        irradiance_pipeline->bind_texture(this->m_skybox, "environment_texture");
+        irradiance_pipeline->bind_storage_image(storage_views.back(), "irradiance_map");
 
-    void skybox::create_irradiance_map() {
-        auto _shader = shader_library::get("irradiance_map");
-        auto& reflection_data = _shader->get_reflection_data();
-
-        // sampling deltas (see assets/shaders/irradiance_map.hlsl)
         struct {
             float delta_phi, delta_theta;
         } sampling_deltas;
 
-        sampling_deltas.delta_phi = (float)glm::pi<float>() / 90.f;
-        sampling_deltas.delta_theta = (float)glm::pi<float>() / 128.f;
-
-        uint32_t set, binding;
-        if (!reflection_data.find_resource("sampling_deltas", set, binding)) {
-            throw std::runtime_error("could not find sampling deltas buffer");
+        sampling_deltas.delta_phi = ibl_parameters.delta_phi;
+        sampling_deltas.delta_theta = ibl_parameters.delta_theta;
+
+        // prefiltered cube. each level is filtered for a higher roughness than the last, going
+        // from a perfect mirror at level 0 to fully rough at the last level. smaller levels are
+        // only ever read blurred and magnified, so they get away with fewer samples
+        uint32_t prefiltered_cube_size = ibl_parameters.prefiltered_cube_size;
+        uint32_t mip_levels = ibl_parameters.prefiltered_cube_levels;
+        auto prefiltered_cube = ref<image_cube>::create(
+            ibl_parameters.format, prefiltered_cube_size, prefiltered_cube_size, usage,
+            VK_IMAGE_ASPECT_COLOR_BIT, mip_levels);
+        auto prefilter_pipeline = ref<compute_pipeline>::create(prefilter_shader, mip_levels);
+        for (uint32_t level = 0; level < mip_levels; level++) {
+            storage_views.push_back(create_storage_view(prefiltered_cube, level));
+            prefilter_pipeline->bind_texture(this->m_skybox, "environment_texture", level);
+            prefilter_pipeline->bind_storage_image(storage_views.back(), "prefiltered_cube",
+                                                   level);
         }
 
-        auto sampling_deltas_ubo = uniform_buffer::from_shader_data(_shader, set, binding);
-        sampling_deltas_ubo->set_data(sampling_deltas);
-
-        auto render_callback = [this](ref<command_buffer> cmdbuffer) {
-            this->render(cmdbuffer, false);
-        };
-
-        ref<image> irradiance_map =
-            create_cube_map(VK_FORMAT_R32G32B32A32_SFLOAT, 64, this->m_skybox, _shader,
-                            sampling_deltas_ubo, render_callback);
-        this->m_irradiance_map = ref<texture>::create(irradiance_map);
-    }
-
-    void skybox::create_prefiltered_cube() {
-        auto _shader = shader_library::get("prefiltered_cube");
-        auto& reflection_data = _shader->get_reflection_data();
-
         struct {
             float roughness;
             uint32_t sample_count;
         } cube_settings;
 
-        cube_settings.roughness = 0.f; // not dealing with mip levels atm
-        cube_settings.sample_count = 32;
+        // every dispatch writes to a different image or level, so they are all recorded into
+        // one command buffer without barriers in between
+        static constexpr VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        {
+            auto cmdbuffer = renderer::create_single_time_command_buffer();
+            cmdbuffer->begin();
 
-        uint32_t set, binding;
-        if (!reflection_data.find_resource("cube_settings", set, binding)) {
-            throw std::runtime_error("could not find cube settings buffer");
+            irradiance_pipeline->bind(cmdbuffer);
+            irradiance_pipeline->push_constants(cmdbuffer, sampling_deltas);
+            irradiance_pipeline->dispatch(
+                cmdbuffer,
+                glm::uvec3(irradiance_map_size, irradiance_map_size, image_cube::cube_face_count),
+                ibl_group_size);
+
+            for (uint32_t level = 0; level < mip_levels; level++) {
+                uint32_t level_size = std::max(prefiltered_cube_size >> level, 1u);
+                cube_settings.roughness = (float)level / (float)(mip_levels - 1);
+                if (level == 0) {
+                    // every sample of a perfect mirror lands in the same direction
+                    cube_settings.sample_count = 1;
+                } else {
+                    cube_settings.sample_count =
+                        std::max(ibl_parameters.max_sample_count >> (level - 1),
+                                 ibl_parameters.min_sample_count);
+                }
+
+                prefilter_pipeline->bind(cmdbuffer, level);
+                prefilter_pipeline->push_constants(cmdbuffer, cube_settings);
+                prefilter_pipeline->dispatch(
+                    cmdbuffer, glm::uvec3(level_size, level_size, image_cube::cube_face_count),
+                    ibl_group_size);
+            }
+
+            for (ref<image_cube> cube : { irradiance_map, prefiltered_cube }) {
+                transition_image_layout(cube->get_image(), cube->get_layout(), final_layout,
+                                        cube->get_image_aspect(), image_cube::cube_face_count,
+                                        cmdbuffer);
+            }
+
+            cmdbuffer->end();
+            cmdbuffer->submit();
+            cmdbuffer->wait();
         }
 
-        auto cube_settings_ubo = uniform_buffer::from_shader_data(_shader, set, binding);
-        cube_settings_ubo->set_data(cube_settings);
+        VkDevice device = renderer::get_device();
+        for (VkImageView view : storage_views) {
+            vkDestroyImageView(device, view, nullptr);
+        }
 
-        auto render_callback = [this](ref<command_buffer> cmdbuffer) {
-            this->render(cmdbuffer, false);
-        };
+        irradiance_map->set_layout(final_layout);
+        prefiltered_cube->set_layout(final_layout);
+        if (cacheable) {
+            ibl_cache::write("irradiance_map", key, irradiance_map);
+            ibl_cache::write("prefiltered_cube", key, prefiltered_cube);
+        }
 
-        ref<image> prefiltered_cube =
-            create_cube_map(VK_FORMAT_R16G16B16A16_SFLOAT, 512, this->m_skybox, _shader,
-                            cube_settings_ubo, render_callback);
+        this->m_irradiance_map = ref<texture>::create(irradiance_map);
         this->m_prefiltered_cube = ref<texture>::create(prefiltered_cube);
     }
 
-    size_t skybox::find_ubo_offset(const std::string& field_name) {
+    size_t skybox::find_ubo_offset(shader_field_handle& field, const std::string& field_name) {
         ref<shader> _shader = this->m_pipeline->get_shader();
         auto& reflection_data = _shader->get_reflection_data();
+        if (reflection_data.is_valid(field)) {
+            return field.offset;
+        }
 
         uint32_t set = this->m_uniform_buffer->get_set();
         uint32_t binding = this->m_uniform_buffer->get_binding();
         size_t type_index = reflection_data.resources[set][binding].type;
-
-        const auto& type = reflection_data.types[type_index];
-        return type.find_offset(field_name);
+        if (!reflection_data.resolve_field(type_index, field_name, field)) {
+            throw std::runtime_error(field_name + " is not the name of a field");
+        }
+        return field.offset;
     }
 } // namespace vkrollercoaster
\ No newline at end of file
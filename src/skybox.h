@@ -44,14 +44,15 @@ namespace vkrollercoaster {
         void set_exposure(float exposure);
 
     private:
-        void create_irradiance_map();
-        void create_prefiltered_cube();
-        size_t find_ubo_offset(const std::string& field_name);
+        // generates the irradiance map and prefiltered cube with compute shaders
+        void create_pbr_textures();
+        size_t find_ubo_offset(shader_field_handle& field, const std::string& field_name);
 
         // skybox render call objects
         ref<uniform_buffer> m_uniform_buffer;
         ref<pipeline> m_pipeline;
         ref<texture> m_skybox;
+        shader_field_handle m_gamma_field, m_exposure_field;
 
         // pbr textures
         ref<texture> m_irradiance_map;
@@ -78,6 +78,8 @@ namespace vkrollercoaster {
             this->m_window->get_size(&width, &height);
             glfwWaitEvents();
         }
+        // frames in flight may still be using objects that are about to be destroyed
+        vkDeviceWaitIdle(renderer::get_device());
         for (const auto& [_, callbacks] : this->m_dependents) {
             callbacks.destroy();
         }
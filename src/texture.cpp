@@ -21,6 +21,35 @@
 #include "imgui_controller.h"
 #include <backends/imgui_impl_vulkan.h>
 namespace vkrollercoaster {
+    // textures loaded from files, keyed by canonical path and whether they were flipped
+    static std::map<std::pair<std::string, bool>, texture*> texture_registry;
+    static std::pair<std::string, bool> get_registry_key(const fs::path& path, bool flip) {
+        std::error_code error;
+        fs::path canonical_path = fs::weakly_canonical(path, error);
+        return std::make_pair((error ? path : canonical_path).string(), flip);
+    }
+    ref<texture> texture::from_file(const fs::path& path, bool flip) {
+        auto it = texture_registry.find(get_registry_key(path, flip));
+        if (it != texture_registry.end()) {
+            return it->second;
+        }
+        image_data data;
+        if (!image::load_image(path, data, flip)) {
+            return nullptr;
+        }
+        return from_file(path, data, flip);
+    }
+    ref<texture> texture::from_file(const fs::path& path, const image_data& data, bool flip) {
+        registry_key key = get_registry_key(path, flip);
+        auto it = texture_registry.find(key);
+        if (it != texture_registry.end()) {
+            return it->second;
+        }
+        auto tex = ref<texture>::create(ref<image2d>::create(data));
+        tex->m_registry_key = key;
+        texture_registry[key] = tex.raw();
+        return tex;
+    }
     texture::texture(ref<image> _image, bool transition_layout) {
         renderer::add_ref();
         this->m_image = _image;
@@ -36,6 +65,9 @@ namespace vkrollercoaster {
         this->create_sampler();
     }
     texture::~texture() {
+        if (this->m_registry_key) {
+            texture_registry.erase(*this->m_registry_key);
+        }
         for (auto _pipeline : this->m_bound_pipelines) {
             std::vector<pipeline::texture_binding_desc> bindings;
             for (const auto& [binding, tex] : _pipeline->m_bound_textures) {
@@ -94,6 +126,7 @@ namespace vkrollercoaster {
             write.pImageInfo = &image_info;
             writes.push_back(write);
         }
+        _pipeline->wait_for_descriptor_sets();
         VkDevice device = renderer::get_device();
         vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
         if (this->m_bound_pipelines.find(_pipeline.raw()) == this->m_bound_pipelines.end()) {
@@ -154,7 +187,8 @@ namespace vkrollercoaster {
         create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         create_info.mipLodBias = 0.f;
         create_info.minLod = 0.f;
-        create_info.maxLod = 0.f;
+        // let the image view decide how many mip levels there are
+        create_info.maxLod = VK_LOD_CLAMP_NONE;
         VkDevice device = renderer::get_device();
         if (vkCreateSampler(device, &create_info, nullptr, &this->m_sampler) != VK_SUCCESS) {
             throw std::runtime_error("could not create sampler!");
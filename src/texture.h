@@ -20,6 +20,14 @@
 namespace vkrollercoaster {
     class texture : public ref_counted {
     public:
+        // loads a texture from a file, or returns the texture that is already loaded from it.
+        // loaded textures are only held weakly, so they are freed once nothing references them
+        static ref<texture> from_file(const fs::path& path, bool flip = false);
+        // same as above, but with data that was already decoded from the file, for example on
+        // another thread. flip must be what the data was decoded with
+        static ref<texture> from_file(const fs::path& path, const image_data& data,
+                                      bool flip = false);
+
         texture(ref<image> _image, bool transition_layout = true);
         ~texture();
         texture(const texture&) = delete;
@@ -30,13 +38,16 @@ namespace vkrollercoaster {
         ImTextureID get_imgui_id();
 
     private:
+        using registry_key = std::pair<std::string, bool>;
         void create_sampler();
         void update_imgui_texture();
         ref<image> m_image;
         VkSampler m_sampler;
         std::set<pipeline*> m_bound_pipelines;
         ImTextureID m_imgui_id = (ImTextureID)0;
+        std::optional<registry_key> m_registry_key;
         friend class pipeline;
+        friend class compute_pipeline;
         friend class image;
     };
 } // namespace vkrollercoaster
\ No newline at end of file
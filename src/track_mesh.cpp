@@ -0,0 +1,295 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "pch.h"
+#include "track_mesh.h"
+#include "components.h"
+namespace vkrollercoaster {
+    // samples taken along each curve to approximate its length
+    static constexpr size_t arc_length_samples = 64;
+
+    static glm::vec3 evaluate_curve(const std::array<glm::vec3, 4>& curve, float t) {
+        float u = 1.f - t;
+        return u * u * u * curve[0] + 3.f * u * u * t * curve[1] + 3.f * u * t * t * curve[2] +
+               t * t * t * curve[3];
+    }
+
+    static glm::vec3 evaluate_derivative(const std::array<glm::vec3, 4>& curve, float t) {
+        float u = 1.f - t;
+        return 3.f * u * u * (curve[1] - curve[0]) + 6.f * u * t * (curve[2] - curve[1]) +
+               3.f * t * t * (curve[3] - curve[2]);
+    }
+
+    track_mesh::track_mesh(ref<model_source> tile) {
+        this->m_tile = ref<model>::create(tile);
+
+        // the tile runs along the z axis
+        float min_z = std::numeric_limits<float>::max();
+        float max_z = -std::numeric_limits<float>::max();
+        for (const auto& v : this->m_tile->get_vertices()) {
+            min_z = std::min(min_z, v.position.z);
+            max_z = std::max(max_z, v.position.z);
+        }
+        if (max_z <= min_z) {
+            throw std::runtime_error("the track tile has no length!");
+        }
+        this->m_tile_start = min_z;
+        this->m_tile_length = max_z - min_z;
+    }
+
+    void track_mesh::update(entity first_node) {
+        // collect the nodes in order
+        std::vector<entity> nodes;
+        std::unordered_set<entity> visited;
+        entity current_node = first_node;
+        while (current_node && visited.find(current_node) == visited.end()) {
+            if (!current_node.has_component<transform_component>() ||
+                !current_node.has_component<track_segment_component>()) {
+                throw std::runtime_error("this track node does not have the necessary components!");
+            }
+            nodes.push_back(current_node);
+            visited.insert(current_node);
+            current_node = current_node.get_component<track_segment_component>().next;
+        }
+        bool closed = current_node == first_node;
+
+        bool changed = nodes != this->m_nodes;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            entity node = nodes[i];
+            const auto& transform = node.get_component<transform_component>();
+            const auto& track_data = node.get_component<track_segment_component>();
+
+            std::array<glm::vec3, 4> curve;
+            glm::vec3 start = transform.translation;
+            curve[0] = start;
+            if (track_data.next) {
+                glm::vec3 end = track_data.next.get_component<transform_component>().translation;
+                curve[3] = end;
+                if (track_data.automatic_curve) {
+                    // catmull-rom tangents, from the neighboring nodes
+                    glm::vec3 previous = start;
+                    if (i > 0) {
+                        previous = nodes[i - 1].get_component<transform_component>().translation;
+                    } else if (closed) {
+                        previous = nodes.back().get_component<transform_component>().translation;
+                    }
+                    glm::vec3 next = end;
+                    if (track_data.next.has_component<track_segment_component>()) {
+                        const auto& next_data =
+                            track_data.next.get_component<track_segment_component>();
+                        if (next_data.next) {
+                            next = next_data.next.get_component<transform_component>().translation;
+                        }
+                    }
+                    curve[1] = start + (end - previous) / 6.f;
+                    curve[2] = end - (next - start) / 6.f;
+                } else {
+                    curve[1] = start + track_data.control_points[0];
+                    curve[2] = end + track_data.control_points[1];
+                }
+            } else {
+                // the last node of an open track gets a single straight tile along its rotation
+                glm::vec3 forward = glm::quat(transform.rotation) * glm::vec3(0.f, 0.f, 1.f);
+                glm::vec3 end = start + forward * this->m_tile_length * transform.scale.z;
+                curve = { start, glm::mix(start, end, 1.f / 3.f), glm::mix(start, end, 2.f / 3.f),
+                          end };
+            }
+
+            auto it = this->m_segments.find(node);
+            if (it != this->m_segments.end() && it->second.curve == curve &&
+                it->second.scale == transform.scale) {
+                continue;
+            }
+            auto& _segment = this->m_segments[node];
+            _segment.curve = curve;
+            _segment.scale = transform.scale;
+            this->extrude(_segment);
+            changed = true;
+        }
+
+        // forget removed nodes
+        for (auto it = this->m_segments.begin(); it != this->m_segments.end();) {
+            if (visited.find(it->first) == visited.end()) {
+                it = this->m_segments.erase(it);
+                changed = true;
+            } else {
+                it++;
+            }
+        }
+
+        if (changed) {
+            this->m_nodes = nodes;
+            this->rebuild_model();
+        }
+    }
+
+    void track_mesh::extrude(segment& _segment) {
+        _segment.vertices.clear();
+        _segment.indices.clear();
+
+        // cumulative lengths along the curve, for spacing tiles evenly
+        std::array<float, arc_length_samples + 1> lengths;
+        lengths[0] = 0.f;
+        glm::vec3 previous_point = _segment.curve[0];
+        for (size_t i = 1; i <= arc_length_samples; i++) {
+            glm::vec3 point = evaluate_curve(_segment.curve, (float)i / arc_length_samples);
+            lengths[i] = lengths[i - 1] + glm::length(point - previous_point);
+            previous_point = point;
+        }
+        float curve_length = lengths[arc_length_samples];
+        if (curve_length <= std::numeric_limits<float>::epsilon()) {
+            return;
+        }
+        auto find_parameter = [&](float distance) {
+            auto it = std::lower_bound(lengths.begin(), lengths.end(), distance);
+            if (it == lengths.begin()) {
+                return 0.f;
+            }
+            if (it == lengths.end()) {
+                return 1.f;
+            }
+            size_t index = (size_t)(it - lengths.begin());
+            float span = lengths[index] - lengths[index - 1];
+            float fraction = span > 0.f ? (distance - lengths[index - 1]) / span : 0.f;
+            return ((float)(index - 1) + fraction) / arc_length_samples;
+        };
+
+        // stretch a whole number of tiles over the curve
+        float scaled_tile_length = this->m_tile_length * _segment.scale.z;
+        size_t tile_count = std::max((size_t)glm::round(curve_length / scaled_tile_length),
+                                     (size_t)1);
+        float tile_length = curve_length / tile_count;
+
+        const auto& tile_vertices = this->m_tile->get_vertices();
+        const auto& tile_indices = this->m_tile->get_indices();
+        const auto& tile_meshes = this->m_tile->get_meshes();
+        size_t lod_count = this->m_tile->get_lod_count();
+        glm::vec3 last_right = glm::vec3(1.f, 0.f, 0.f);
+        for (size_t tile = 0; tile < tile_count; tile++) {
+            uint32_t vertex_offset = (uint32_t)_segment.vertices.size();
+            for (const auto& tile_vertex : tile_vertices) {
+                float z = tile_vertex.position.z - this->m_tile_start;
+                float t = find_parameter((tile + z / this->m_tile_length) * tile_length);
+
+                // frame along the curve, keeping the track upright
+                glm::vec3 forward = evaluate_derivative(_segment.curve, t);
+                forward = glm::length(forward) > 0.f ? glm::normalize(forward)
+                                                     : glm::vec3(0.f, 0.f, 1.f);
+                glm::vec3 right = glm::cross(glm::vec3(0.f, 1.f, 0.f), forward);
+                if (glm::length(right) < 0.001f) {
+                    right = last_right;
+                } else {
+                    right = glm::normalize(right);
+                    last_right = right;
+                }
+                glm::vec3 up = glm::cross(forward, right);
+                glm::mat3 basis = glm::mat3(right, up, forward);
+
+                vertex v = tile_vertex;
+                v.position = evaluate_curve(_segment.curve, t) +
+                             right * tile_vertex.position.x * _segment.scale.x +
+                             up * tile_vertex.position.y * _segment.scale.y;
+                v.normal = glm::normalize(basis * tile_vertex.normal);
+                v.tangent = glm::normalize(basis * tile_vertex.tangent);
+                _segment.vertices.push_back(v);
+            }
+            for (const auto& tile_mesh : tile_meshes) {
+                auto& levels = _segment.indices[tile_mesh.material_index];
+                levels.resize(lod_count);
+                for (size_t lod = 0; lod < lod_count; lod++) {
+                    index_range range = tile_mesh.get_lod(lod);
+                    for (size_t i = 0; i < range.count; i++) {
+                        levels[lod].push_back(tile_indices[range.offset + i] + vertex_offset);
+                    }
+                }
+            }
+        }
+    }
+
+    void track_mesh::rebuild_model() {
+        model::model_data data;
+        data.materials = this->m_tile->get_materials();
+
+        // every chunk is drawn from the same vertex buffer, so that neighboring chunks at the
+        // same level of detail can be drawn together. packed positions would be quantized within
+        // the bounds of the whole track, which are large enough to make the steps visible, so
+        // the track is kept in the standard format
+        size_t chunk_count = (this->m_nodes.size() + segments_per_chunk - 1) / segments_per_chunk;
+        this->m_chunks.resize(chunk_count);
+        for (size_t chunk_index = 0; chunk_index < chunk_count; chunk_index++) {
+            // one mesh per material, spanning every segment of the chunk, with the tile's levels
+            // of detail
+            size_t first_node = chunk_index * segments_per_chunk;
+            size_t last_node = std::min(first_node + segments_per_chunk, this->m_nodes.size());
+            std::map<size_t, std::vector<std::vector<uint32_t>>> material_indices;
+            for (size_t i = first_node; i < last_node; i++) {
+                const auto& _segment = this->m_segments[this->m_nodes[i]];
+                uint32_t vertex_offset = (uint32_t)data.vertices.size();
+                data.vertices.insert(data.vertices.end(), _segment.vertices.begin(),
+                                     _segment.vertices.end());
+                for (const auto& [material_index, levels] : _segment.indices) {
+                    auto& destination = material_indices[material_index];
+                    destination.resize(std::max(destination.size(), levels.size()));
+                    for (size_t lod = 0; lod < levels.size(); lod++) {
+                        for (uint32_t index : levels[lod]) {
+                            destination[lod].push_back(index + vertex_offset);
+                        }
+                    }
+                }
+            }
+
+            auto& _chunk = this->m_chunks[chunk_index];
+            _chunk.first_mesh = data.meshes.size();
+            for (const auto& [material_index, levels] : material_indices) {
+                model::mesh _mesh;
+                _mesh.material_index = material_index;
+                for (size_t lod = 0; lod < levels.size(); lod++) {
+                    index_range range = { data.indices.size(), levels[lod].size() };
+                    if (lod == 0) {
+                        _mesh.index_offset = range.offset;
+                        _mesh.index_count = range.count;
+                    } else {
+                        _mesh.lods.push_back(range);
+                    }
+                    data.indices.insert(data.indices.end(), levels[lod].begin(),
+                                        levels[lod].end());
+                }
+                data.meshes.push_back(_mesh);
+            }
+            _chunk.mesh_count = data.meshes.size() - _chunk.first_mesh;
+        }
+
+        if (data.vertices.empty()) {
+            this->m_model.reset();
+            this->m_chunks.clear();
+            return;
+        }
+        if (this->m_model) {
+            this->m_model->set_data(data);
+        } else {
+            this->m_model = ref<model>::create(data);
+        }
+
+        // the model calculates the bounds of each mesh
+        const auto& meshes = this->m_model->get_meshes();
+        for (auto& _chunk : this->m_chunks) {
+            _chunk.bounds = bounding_volume();
+            for (size_t i = 0; i < _chunk.mesh_count; i++) {
+                _chunk.bounds.merge(meshes[_chunk.first_mesh + i].bounds);
+            }
+        }
+    }
+} // namespace vkrollercoaster
\ No newline at end of file
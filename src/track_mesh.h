@@ -0,0 +1,73 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#pragma once
+#include "model.h"
+#include "scene.h"
+namespace vkrollercoaster {
+    // extrudes the track tile model along the curves between track nodes, producing one model
+    // for the entire track. the model is split into chunks of consecutive segments, so that
+    // each chunk can be culled and reduced in detail on its own, while every chunk shares the
+    // model's buffers
+    class track_mesh : public ref_counted {
+    public:
+        struct chunk {
+            bounding_volume bounds;
+            // the chunk's meshes in the track's model, one per material
+            size_t first_mesh, mesh_count;
+            // the level of detail the chunk was last drawn at
+            size_t lod = 0;
+        };
+        static constexpr size_t segments_per_chunk = 16;
+
+        track_mesh(ref<model_source> tile);
+        ~track_mesh() = default;
+
+        track_mesh(const track_mesh&) = delete;
+        track_mesh& operator=(const track_mesh&) = delete;
+
+        // walks the track starting at first_node. only segments whose curves changed since the
+        // last update are extruded again, and the model is only rebuilt if anything changed
+        void update(entity first_node);
+
+        // null if the track is empty
+        ref<model> get_model() { return this->m_model; }
+        // in the order of the track's meshes
+        std::vector<chunk>& get_chunks() { return this->m_chunks; }
+
+    private:
+        struct segment {
+            // start point, control points, and end point
+            std::array<glm::vec3, 4> curve;
+            glm::vec3 scale;
+
+            std::vector<vertex> vertices;
+            // keyed by material index, then level of detail
+            std::map<size_t, std::vector<std::vector<uint32_t>>> indices;
+        };
+
+        void extrude(segment& _segment);
+        void rebuild_model();
+
+        ref<model> m_tile;
+        float m_tile_start, m_tile_length;
+
+        std::unordered_map<entity, segment> m_segments;
+        std::vector<entity> m_nodes;
+        ref<model> m_model;
+        std::vector<chunk> m_chunks;
+    };
+} // namespace vkrollercoaster
\ No newline at end of file
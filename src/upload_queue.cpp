@@ -0,0 +1,504 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "pch.h"
+#include "upload_queue.h"
+#define EXPOSE_RENDERER_INTERNALS
+#define EXPOSE_BUFFER_UTILS
+#include "renderer.h"
+#include "buffers.h"
+#include "allocator.h"
+#include "util.h"
+#include <numeric>
+namespace vkrollercoaster {
+    static constexpr size_t staging_ring_size = 64 * 1024 * 1024;
+
+    struct staging_buffer {
+        VkBuffer buffer;
+        VmaAllocation allocation;
+    };
+    struct pending_buffer_copy {
+        VkBuffer source, destination;
+        VkBufferCopy region;
+    };
+    struct pending_image_copy {
+        VkBuffer source;
+        VkImage destination;
+        VkImageAspectFlags aspect;
+        uint32_t mip_levels, layer_count;
+        std::vector<VkBufferImageCopy> regions;
+        VkImageLayout final_layout;
+        bool generate_mips;
+    };
+    struct upload_batch {
+        upload_ticket ticket;
+        VkCommandBuffer transfer_cmdbuffer = nullptr;
+        VkCommandBuffer graphics_cmdbuffer = nullptr;
+        VkSemaphore semaphore = nullptr;
+        VkFence fence = nullptr;
+        uint64_t ring_end;
+        std::vector<staging_buffer> temporary_buffers;
+    };
+
+    static struct {
+        std::unique_ptr<allocator> _allocator;
+        bool dedicated_transfer = false;
+        VkQueue transfer_queue = nullptr;
+        VkCommandPool transfer_command_pool = nullptr;
+        VkCommandPool graphics_command_pool = nullptr;
+
+        // persistently mapped staging memory. head and tail are virtual offsets that only ever
+        // increase - the physical offset is the virtual offset modulo the ring size
+        staging_buffer ring;
+        uint8_t* ring_data = nullptr;
+        uint64_t ring_head = 0;
+        uint64_t ring_tail = 0;
+
+        // uploads that have not been submitted yet
+        std::vector<pending_buffer_copy> buffer_copies;
+        std::vector<pending_image_copy> image_copies;
+        std::vector<staging_buffer> temporary_buffers;
+
+        // submitted batches, oldest first
+        std::list<upload_batch> batches;
+        upload_ticket next_ticket = 1;
+        upload_ticket completed_ticket = 0;
+    } upload_data;
+
+    static VkCommandPool create_command_pool(uint32_t queue_family) {
+        VkCommandPoolCreateInfo create_info;
+        util::zero(create_info);
+        create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        create_info.queueFamilyIndex = queue_family;
+        create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        VkCommandPool command_pool;
+        if (vkCreateCommandPool(renderer::get_device(), &create_info, nullptr, &command_pool) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("could not create upload command pool!");
+        }
+        return command_pool;
+    }
+
+    void upload_queue::init() {
+        upload_data._allocator = std::make_unique<allocator>();
+        upload_data._allocator->set_source("upload queue");
+
+        VkDevice device = renderer::get_device();
+        auto indices = renderer::find_queue_families(renderer::get_physical_device());
+        upload_data.dedicated_transfer = *indices.transfer_family != *indices.graphics_family;
+        vkGetDeviceQueue(device, *indices.transfer_family, 0, &upload_data.transfer_queue);
+        upload_data.graphics_command_pool = create_command_pool(*indices.graphics_family);
+        if (upload_data.dedicated_transfer) {
+            upload_data.transfer_command_pool = create_command_pool(*indices.transfer_family);
+        } else {
+            upload_data.transfer_command_pool = upload_data.graphics_command_pool;
+        }
+
+        create_buffer(*upload_data._allocator, staging_ring_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      VMA_MEMORY_USAGE_CPU_ONLY, upload_data.ring.buffer,
+                      upload_data.ring.allocation);
+        upload_data.ring_data = (uint8_t*)upload_data._allocator->map(upload_data.ring.allocation);
+    }
+
+    static void retire_batch(const upload_batch& batch) {
+        VkDevice device = renderer::get_device();
+        if (batch.transfer_cmdbuffer != batch.graphics_cmdbuffer) {
+            vkFreeCommandBuffers(device, upload_data.transfer_command_pool, 1,
+                                 &batch.transfer_cmdbuffer);
+        }
+        vkFreeCommandBuffers(device, upload_data.graphics_command_pool, 1,
+                             &batch.graphics_cmdbuffer);
+        if (batch.semaphore) {
+            vkDestroySemaphore(device, batch.semaphore, nullptr);
+        }
+        vkDestroyFence(device, batch.fence, nullptr);
+        for (const auto& temporary : batch.temporary_buffers) {
+            upload_data._allocator->free(temporary.buffer, temporary.allocation);
+        }
+        upload_data.ring_tail = batch.ring_end;
+        upload_data.completed_ticket = batch.ticket;
+    }
+
+    // retires finished batches in submission order. batches up to and including wait_ticket are
+    // waited on instead of stopping at the first unfinished one
+    static void retire_batches(upload_ticket wait_ticket = 0) {
+        VkDevice device = renderer::get_device();
+        while (!upload_data.batches.empty()) {
+            const auto& batch = upload_data.batches.front();
+            if (batch.ticket <= wait_ticket) {
+                vkWaitForFences(device, 1, &batch.fence, true,
+                                std::numeric_limits<uint64_t>::max());
+            } else if (vkGetFenceStatus(device, batch.fence) != VK_SUCCESS) {
+                break;
+            }
+            retire_batch(batch);
+            upload_data.batches.pop_front();
+        }
+    }
+
+    void upload_queue::shutdown() {
+        flush();
+        retire_batches(upload_data.next_ticket);
+
+        VkDevice device = renderer::get_device();
+        upload_data._allocator->unmap(upload_data.ring.allocation);
+        upload_data._allocator->free(upload_data.ring.buffer, upload_data.ring.allocation);
+        if (upload_data.dedicated_transfer) {
+            vkDestroyCommandPool(device, upload_data.transfer_command_pool, nullptr);
+        }
+        vkDestroyCommandPool(device, upload_data.graphics_command_pool, nullptr);
+        upload_data._allocator.reset();
+    }
+
+    // returns the buffer and offset that size bytes of staging data can be written to
+    static uint8_t* allocate_staging_memory(size_t size, size_t alignment, VkBuffer& buffer,
+                                            size_t& offset) {
+        if (size > staging_ring_size) {
+            // too big for the ring - use a dedicated buffer for this upload
+            staging_buffer temporary;
+            create_buffer(*upload_data._allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                          VMA_MEMORY_USAGE_CPU_ONLY, temporary.buffer, temporary.allocation);
+            upload_data.temporary_buffers.push_back(temporary);
+            buffer = temporary.buffer;
+            offset = 0;
+            return (uint8_t*)upload_data._allocator->map(temporary.allocation);
+        }
+        while (true) {
+            if (upload_data.ring_head == upload_data.ring_tail) {
+                // nothing is in flight - start over at the beginning of the ring
+                uint64_t remainder = upload_data.ring_head % staging_ring_size;
+                if (remainder > 0) {
+                    upload_data.ring_head += staging_ring_size - remainder;
+                    upload_data.ring_tail = upload_data.ring_head;
+                }
+            }
+            size_t physical = upload_data.ring_head % staging_ring_size;
+            size_t padding = (alignment - physical % alignment) % alignment;
+            if (physical + padding + size > staging_ring_size) {
+                // not enough room before the end of the ring - wrap around to the start
+                padding = staging_ring_size - physical;
+            }
+            uint64_t start = upload_data.ring_head + padding;
+            if (start + size - upload_data.ring_tail <= staging_ring_size) {
+                upload_data.ring_head = start + size;
+                buffer = upload_data.ring.buffer;
+                offset = start % staging_ring_size;
+                return upload_data.ring_data + offset;
+            }
+
+            // the ring is full - make room by waiting on the oldest batch
+            if (upload_data.batches.empty()) {
+                upload_queue::flush();
+            }
+            retire_batches(upload_data.batches.front().ticket);
+        }
+    }
+
+    static void finish_staging_write(VkBuffer buffer) {
+        // temporary buffers are mapped only for the duration of the write
+        for (const auto& temporary : upload_data.temporary_buffers) {
+            if (temporary.buffer == buffer) {
+                upload_data._allocator->unmap(temporary.allocation);
+                break;
+            }
+        }
+    }
+
+    upload_ticket upload_queue::upload_buffer(VkBuffer destination, const void* data, size_t size,
+                                              size_t offset) {
+        pending_buffer_copy copy;
+        util::zero(copy.region);
+        uint8_t* staging_data =
+            allocate_staging_memory(size, 16, copy.source, copy.region.srcOffset);
+        memcpy(staging_data, data, size);
+        finish_staging_write(copy.source);
+
+        copy.destination = destination;
+        copy.region.dstOffset = offset;
+        copy.region.size = size;
+        upload_data.buffer_copies.push_back(copy);
+        return upload_data.next_ticket;
+    }
+
+    upload_ticket upload_queue::upload_image(VkImage destination, VkImageAspectFlags aspect,
+                                             uint32_t mip_levels, uint32_t layer_count,
+                                             const void* data, size_t size, size_t texel_size,
+                                             const std::vector<VkBufferImageCopy>& regions,
+                                             VkImageLayout final_layout, bool generate_mips) {
+        pending_image_copy copy;
+        size_t staging_offset;
+        size_t alignment = std::lcm(texel_size, (size_t)16);
+        uint8_t* staging_data =
+            allocate_staging_memory(size, alignment, copy.source, staging_offset);
+        memcpy(staging_data, data, size);
+        finish_staging_write(copy.source);
+
+        copy.destination = destination;
+        copy.aspect = aspect;
+        copy.mip_levels = mip_levels;
+        copy.layer_count = layer_count;
+        copy.final_layout = final_layout;
+        copy.generate_mips = generate_mips;
+        copy.regions = regions;
+        for (auto& region : copy.regions) {
+            region.bufferOffset += staging_offset;
+        }
+        upload_data.image_copies.push_back(copy);
+        return upload_data.next_ticket;
+    }
+
+    static VkCommandBuffer begin_command_buffer(VkCommandPool command_pool) {
+        VkCommandBufferAllocateInfo alloc_info;
+        util::zero(alloc_info);
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandBufferCount = 1;
+        alloc_info.commandPool = command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        VkCommandBuffer cmdbuffer;
+        if (vkAllocateCommandBuffers(renderer::get_device(), &alloc_info, &cmdbuffer) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("could not allocate upload command buffer!");
+        }
+        VkCommandBufferBeginInfo begin_info;
+        util::zero(begin_info);
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(cmdbuffer, &begin_info) != VK_SUCCESS) {
+            throw std::runtime_error("could not begin recording of upload command buffer!");
+        }
+        return cmdbuffer;
+    }
+
+    static VkImageMemoryBarrier create_image_barrier(const pending_image_copy& copy,
+                                                     VkImageLayout old_layout,
+                                                     VkImageLayout new_layout) {
+        VkImageMemoryBarrier barrier;
+        util::zero(barrier);
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.image = copy.destination;
+        barrier.oldLayout = old_layout;
+        barrier.newLayout = new_layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = copy.aspect;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = copy.mip_levels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = copy.layer_count;
+        return barrier;
+    }
+
+    static void record_transfer_commands(VkCommandBuffer cmdbuffer) {
+        std::vector<VkImageMemoryBarrier> barriers;
+        for (const auto& copy : upload_data.image_copies) {
+            auto& barrier = barriers.emplace_back(create_image_barrier(
+                copy, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        }
+        if (!barriers.empty()) {
+            vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                                 barriers.size(), barriers.data());
+        }
+        for (const auto& copy : upload_data.buffer_copies) {
+            vkCmdCopyBuffer(cmdbuffer, copy.source, copy.destination, 1, &copy.region);
+        }
+        for (const auto& copy : upload_data.image_copies) {
+            vkCmdCopyBufferToImage(cmdbuffer, copy.source, copy.destination,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.regions.size(),
+                                   copy.regions.data());
+        }
+    }
+
+    // blits every mip level from the one before it. the first level must have been copied
+    // already, and the image is left in its final layout
+    static void generate_mip_chain(VkCommandBuffer cmdbuffer, const pending_image_copy& copy) {
+        int32_t width = (int32_t)copy.regions[0].imageExtent.width;
+        int32_t height = (int32_t)copy.regions[0].imageExtent.height;
+        for (uint32_t level = 1; level < copy.mip_levels; level++) {
+            auto barrier = create_image_barrier(copy, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+            barrier.subresourceRange.baseMipLevel = level - 1;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                                 &barrier);
+
+            int32_t next_width = std::max(width / 2, 1);
+            int32_t next_height = std::max(height / 2, 1);
+
+            VkImageBlit blit;
+            util::zero(blit);
+            blit.srcOffsets[1] = { width, height, 1 };
+            blit.srcSubresource.aspectMask = copy.aspect;
+            blit.srcSubresource.mipLevel = level - 1;
+            blit.srcSubresource.baseArrayLayer = 0;
+            blit.srcSubresource.layerCount = copy.layer_count;
+            blit.dstOffsets[1] = { next_width, next_height, 1 };
+            blit.dstSubresource.aspectMask = copy.aspect;
+            blit.dstSubresource.mipLevel = level;
+            blit.dstSubresource.baseArrayLayer = 0;
+            blit.dstSubresource.layerCount = copy.layer_count;
+            vkCmdBlitImage(cmdbuffer, copy.destination, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           copy.destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                           VK_FILTER_LINEAR);
+
+            width = next_width;
+            height = next_height;
+        }
+
+        // every level but the last one was read from, and is now a transfer source
+        std::vector<VkImageMemoryBarrier> barriers;
+        if (copy.mip_levels > 1) {
+            auto& barrier = barriers.emplace_back(create_image_barrier(
+                copy, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, copy.final_layout));
+            barrier.subresourceRange.levelCount = copy.mip_levels - 1;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
+        auto& barrier = barriers.emplace_back(create_image_barrier(
+            copy, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.final_layout));
+        barrier.subresourceRange.baseMipLevel = copy.mip_levels - 1;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+                             barriers.size(), barriers.data());
+    }
+
+    static void record_graphics_commands(VkCommandBuffer cmdbuffer) {
+        // make the copied data visible to everything that reads it afterward, and move images
+        // into the layout they will be used in
+        VkMemoryBarrier memory_barrier;
+        util::zero(memory_barrier);
+        memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memory_barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                       VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT |
+                                       VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        std::vector<VkImageMemoryBarrier> barriers;
+        for (const auto& copy : upload_data.image_copies) {
+            if (copy.generate_mips) {
+                generate_mip_chain(cmdbuffer, copy);
+                continue;
+            }
+            auto& barrier = barriers.emplace_back(create_image_barrier(
+                copy, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.final_layout));
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        }
+        vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memory_barrier, 0,
+                             nullptr, barriers.size(), barriers.data());
+    }
+
+    upload_ticket upload_queue::flush() {
+        if (upload_data.buffer_copies.empty() && upload_data.image_copies.empty()) {
+            retire_batches();
+            return upload_data.next_ticket - 1;
+        }
+
+        VkDevice device = renderer::get_device();
+        upload_batch batch;
+        batch.ticket = upload_data.next_ticket++;
+        batch.ring_end = upload_data.ring_head;
+        batch.temporary_buffers = std::move(upload_data.temporary_buffers);
+        upload_data.temporary_buffers.clear();
+
+        VkFenceCreateInfo fence_create_info;
+        util::zero(fence_create_info);
+        fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device, &fence_create_info, nullptr, &batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("could not create upload fence!");
+        }
+
+        // copies go on the transfer queue. layout transitions into shader-readable layouts are
+        // not supported there, so those are recorded on the graphics queue, which waits on the
+        // copies through a semaphore. later graphics work is ordered after the final barrier
+        batch.transfer_cmdbuffer = begin_command_buffer(upload_data.transfer_command_pool);
+        record_transfer_commands(batch.transfer_cmdbuffer);
+        if (upload_data.dedicated_transfer) {
+            if (vkEndCommandBuffer(batch.transfer_cmdbuffer) != VK_SUCCESS) {
+                throw std::runtime_error("could not end recording of upload command buffer!");
+            }
+
+            VkSemaphoreCreateInfo semaphore_create_info;
+            util::zero(semaphore_create_info);
+            semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &batch.semaphore) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("could not create upload semaphore!");
+            }
+
+            VkSubmitInfo submit_info;
+            util::zero(submit_info);
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &batch.transfer_cmdbuffer;
+            submit_info.signalSemaphoreCount = 1;
+            submit_info.pSignalSemaphores = &batch.semaphore;
+            if (vkQueueSubmit(upload_data.transfer_queue, 1, &submit_info, nullptr) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("could not submit uploads!");
+            }
+
+            batch.graphics_cmdbuffer = begin_command_buffer(upload_data.graphics_command_pool);
+        } else {
+            batch.graphics_cmdbuffer = batch.transfer_cmdbuffer;
+        }
+        record_graphics_commands(batch.graphics_cmdbuffer);
+        if (vkEndCommandBuffer(batch.graphics_cmdbuffer) != VK_SUCCESS) {
+            throw std::runtime_error("could not end recording of upload command buffer!");
+        }
+
+        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSubmitInfo submit_info;
+        util::zero(submit_info);
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &batch.graphics_cmdbuffer;
+        if (batch.semaphore) {
+            submit_info.waitSemaphoreCount = 1;
+            submit_info.pWaitSemaphores = &batch.semaphore;
+            submit_info.pWaitDstStageMask = &wait_stage;
+        }
+        if (vkQueueSubmit(renderer::get_graphics_queue(), 1, &submit_info, batch.fence) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("could not submit uploads!");
+        }
+
+        upload_data.buffer_copies.clear();
+        upload_data.image_copies.clear();
+        upload_data.batches.push_back(std::move(batch));
+        retire_batches();
+        return upload_data.next_ticket - 1;
+    }
+
+    bool upload_queue::is_complete(upload_ticket ticket) {
+        retire_batches();
+        return ticket <= upload_data.completed_ticket;
+    }
+
+    void upload_queue::wait(upload_ticket ticket) {
+        if (ticket >= upload_data.next_ticket) {
+            flush();
+        }
+        retire_batches(ticket);
+    }
+} // namespace vkrollercoaster
\ No newline at end of file
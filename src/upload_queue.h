@@ -0,0 +1,51 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#pragma once
+namespace vkrollercoaster {
+    // identifies the batch an upload was submitted in. tickets only ever increase, so a ticket
+    // is complete once every batch up to and including it has finished on the gpu
+    using upload_ticket = uint64_t;
+
+    class upload_queue {
+    public:
+        upload_queue() = delete;
+
+        static void init();
+        static void shutdown();
+
+        // copies data into a device-local buffer
+        static upload_ticket upload_buffer(VkBuffer destination, const void* data, size_t size,
+                                           size_t offset = 0);
+
+        // copies data into an image that is currently in VK_IMAGE_LAYOUT_UNDEFINED, and then
+        // transitions it to final_layout. buffer offsets in the passed regions are relative to
+        // the start of data. if generate_mips is set, the regions only fill the first mip level,
+        // and every level after it is blitted from the one before it on the gpu
+        static upload_ticket upload_image(VkImage destination, VkImageAspectFlags aspect,
+                                          uint32_t mip_levels, uint32_t layer_count,
+                                          const void* data, size_t size, size_t texel_size,
+                                          const std::vector<VkBufferImageCopy>& regions,
+                                          VkImageLayout final_layout, bool generate_mips = false);
+
+        // submits every queued upload as one batch. the renderer flushes before every graphics
+        // submission, so queued uploads are always visible to later rendering
+        static upload_ticket flush();
+
+        static bool is_complete(upload_ticket ticket);
+        static void wait(upload_ticket ticket);
+    };
+} // namespace vkrollercoaster
\ No newline at end of file
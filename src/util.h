@@ -40,6 +40,13 @@ namespace vkrollercoaster {
             file.close();
             return contents.str();
         }
+        inline fs::path get_cache_directory() {
+            fs::path directory = "cache";
+            if (!fs::exists(directory)) {
+                fs::create_directories(directory);
+            }
+            return directory;
+        }
         template <typename T>
         inline void append_vector(std::vector<T>& destination, const std::vector<T>& source) {
             destination.insert(destination.end(), source.begin(), source.end());
@@ -47,5 +54,34 @@ namespace vkrollercoaster {
         template <typename T> inline T lerp(const T& p0, const T& p1, float t) {
             return (1.f - t) * p0 + t * p1;
         };
+        // fnv-1a. unlike std::hash, the result is stable across runs and builds, so it can be
+        // used to key data stored on disk
+        inline uint64_t hash_data(const void* data, size_t size,
+                                  uint64_t seed = 0xcbf29ce484222325) {
+            uint64_t hash = seed;
+            for (size_t i = 0; i < size; i++) {
+                hash ^= ((const uint8_t*)data)[i];
+                hash *= 0x100000001b3;
+            }
+            return hash;
+        }
+        inline uint64_t hash_data(const std::string& data, uint64_t seed = 0xcbf29ce484222325) {
+            uint64_t size = data.length();
+            return hash_data(data.data(), data.length(), hash_data(&size, sizeof(uint64_t), seed));
+        }
+        // hashes the raw contents of a file, or only its path if it can't be opened
+        inline uint64_t hash_file(const fs::path& path, uint64_t seed = 0xcbf29ce484222325) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open()) {
+                return hash_data(path.string(), seed);
+            }
+            std::vector<char> contents((std::istreambuf_iterator<char>(file)),
+                                       std::istreambuf_iterator<char>());
+            return hash_data(contents.data(), contents.size(), seed);
+        }
+        template <typename T> inline void hash_combine(size_t& seed, const T& value) {
+            std::hash<T> hasher;
+            seed ^= hasher(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
     } // namespace util
 } // namespace vkrollercoaster
\ No newline at end of file
@@ -0,0 +1,128 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "pch.h"
+#include "worker_pool.h"
+namespace vkrollercoaster {
+    static struct {
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable start_condition, finish_condition;
+
+        // the task currently being run, and how many workers are still running it
+        const std::function<void(size_t)>* task = nullptr;
+        uint64_t generation = 0;
+        size_t remaining = 0;
+        std::exception_ptr error;
+
+        bool should_stop = false;
+    } worker_data;
+
+    static void worker_main(size_t thread_index) {
+        uint64_t last_generation = 0;
+        while (true) {
+            const std::function<void(size_t)>* task;
+            {
+                std::unique_lock<std::mutex> lock(worker_data.mutex);
+                worker_data.start_condition.wait(lock, [&]() {
+                    return worker_data.should_stop || worker_data.generation != last_generation;
+                });
+                if (worker_data.should_stop) {
+                    return;
+                }
+                last_generation = worker_data.generation;
+                task = worker_data.task;
+            }
+
+            std::exception_ptr error;
+            try {
+                (*task)(thread_index);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(worker_data.mutex);
+            if (error && !worker_data.error) {
+                worker_data.error = error;
+            }
+            worker_data.remaining--;
+            if (worker_data.remaining == 0) {
+                worker_data.finish_condition.notify_one();
+            }
+        }
+    }
+
+    void worker_pool::init() {
+        // leave a core for the main thread
+        size_t hardware_threads = (size_t)std::thread::hardware_concurrency();
+        size_t worker_count = hardware_threads > 1 ? hardware_threads - 1 : 0;
+
+        worker_data.should_stop = false;
+        for (size_t i = 0; i < worker_count; i++) {
+            worker_data.threads.emplace_back(worker_main, i + 1);
+        }
+        spdlog::info("started {0} worker threads", worker_count);
+    }
+
+    void worker_pool::shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(worker_data.mutex);
+            worker_data.should_stop = true;
+        }
+        worker_data.start_condition.notify_all();
+        for (auto& thread : worker_data.threads) {
+            thread.join();
+        }
+        worker_data.threads.clear();
+    }
+
+    size_t worker_pool::get_thread_count() { return worker_data.threads.size() + 1; }
+
+    void worker_pool::dispatch(const std::function<void(size_t thread_index)>& task) {
+        if (worker_data.threads.empty()) {
+            task(0);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(worker_data.mutex);
+            worker_data.task = &task;
+            worker_data.remaining = worker_data.threads.size();
+            worker_data.error = nullptr;
+            worker_data.generation++;
+        }
+        worker_data.start_condition.notify_all();
+
+        std::exception_ptr error;
+        try {
+            task(0);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(worker_data.mutex);
+            worker_data.finish_condition.wait(lock, []() { return worker_data.remaining == 0; });
+            worker_data.task = nullptr;
+            if (!error) {
+                error = worker_data.error;
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+} // namespace vkrollercoaster
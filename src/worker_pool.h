@@ -0,0 +1,35 @@
+/*
+   Copyright 2021 Nora Beda and contributors
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#pragma once
+namespace vkrollercoaster {
+    // a fixed set of worker threads that run tasks alongside the main thread
+    class worker_pool {
+    public:
+        worker_pool() = delete;
+
+        static void init();
+        static void shutdown();
+
+        // the number of threads tasks are dispatched to, including the calling thread
+        static size_t get_thread_count();
+
+        // runs task once on every thread, passing each its thread index. the calling thread
+        // always runs index 0. blocks until every thread has finished, and rethrows the first
+        // exception thrown by any of them
+        static void dispatch(const std::function<void(size_t thread_index)>& task);
+    };
+} // namespace vkrollercoaster